@@ -0,0 +1,55 @@
+// Time-stamp: <2026-10-17 18:41:37 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// System includes.
+#include <cmath>
+#include <cstdlib>
+
+// Local includes.
+#include "band.h"
+
+bool
+Band::parse (const char *spec, Band & band)
+{
+
+  // The frequencies are separated by colons.
+  char *strtod_end;
+  double low = std::strtod (spec, &strtod_end);
+  if ((strtod_end == spec) || (*strtod_end != ':'))
+    return false;
+  const char *high_start = strtod_end + 1;
+  double high = std::strtod (high_start, &strtod_end);
+  if (strtod_end == high_start)
+    return false;
+  double resolution = 0;
+  if (*strtod_end == ':')
+    {
+      const char *resolution_start = strtod_end + 1;
+      resolution = std::strtod (resolution_start, &strtod_end);
+      if ((strtod_end == resolution_start) || !(resolution > 0))
+	return false;
+    }
+
+  // Make sure we have non-garbage input.
+  if ((*strtod_end != '\0') || !(low >= 0) || !(high > low) ||
+      !std::isfinite (high) || !std::isfinite (resolution))
+    return false;
+  band.low = low;
+  band.high = high;
+  band.resolution = resolution;
+  return true;
+}
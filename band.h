@@ -0,0 +1,65 @@
+// Time-stamp: <2026-10-17 18:40:12 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef BAND_H
+#define BAND_H
+
+// A band of frequencies, in Hz, to find the power spectrum of, rather
+// than of all frequencies from DC to the Nyquist frequency, and the
+// width of the bins to find it in, if asked for.
+class Band
+{
+private:
+
+  // Lowest and highest frequency of the band.
+  double low;
+  double high;
+
+  // Width of the bins asked for, or 0 for the frequency resolution of
+  // the input.
+  double resolution;
+public:
+
+  // No band.
+  Band ():low (0), high (0), resolution (0)
+  {
+  }
+
+  // Parses "<low>:<high>" or "<low>:<high>:<resolution>". Returns false
+  // if spec isn't either, low is negative or not below high, or
+  // resolution isn't positive.
+  static bool parse (const char *spec, Band & band);
+
+  // Returns the lowest frequency of the band.
+  double get_low () const
+  {
+    return low;
+  }
+
+  // Returns the highest frequency of the band.
+  double get_high () const
+  {
+    return high;
+  }
+
+  // Returns the width of the bins asked for, 0 if none was.
+  double get_resolution () const
+  {
+    return resolution;
+  }
+};
+#endif
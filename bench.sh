@@ -0,0 +1,173 @@
+#!/bin/bash
+# Time-stamp: <2026-10-17 15:21:40 awarkentin>
+# Copyright (C) 2004 Andrey Warkentin
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+# Benchmarks pstool on synthetic captures written by siggen, for each
+# input length, number of processes and way of planning, and compares
+# how long each phase took with a stored baseline. Run by 'make bench'.
+# Everything below can be overridden from the environment.
+
+# Where the captures, outputs, results and baseline are kept.
+bench_directory=${BENCH_DIR:-bench}
+
+# Input lengths. Powers of two, a prime, and products of small and
+# large primes, which FFT libraries handle far less well.
+bench_sizes=${BENCH_SIZES:-"65536 1048576 16777216 1048573 1048574 9699690"}
+
+# Numbers of processes.
+bench_ranks=${BENCH_RANKS:-"1 2 4"}
+
+# Ways of planning: estimate (the default), measure (-e, which
+# exports the wisdom), wisdom (-w, importing that wisdom) and cache
+# (--wisdom-dir, measuring only what isn't cached already).
+bench_plans=${BENCH_PLANS:-"estimate measure wisdom cache"}
+
+# Windows the input is weighed by as it's read, each timed on the
+# longest capture on a single process.
+bench_windows=${BENCH_WINDOWS:-"hann kaiser:8.6"}
+
+# How to launch MPI programs, and any other pstool options.
+bench_mpirun=${BENCH_MPIRUN:-"mpirun"}
+bench_options=${BENCH_OPTIONS:-""}
+
+# A phase is a regression if it takes longer than this many times its
+# baseline, and longer than the baseline by at least this many seconds.
+bench_tolerance=${BENCH_TOLERANCE:-1.25}
+bench_slack=${BENCH_SLACK:-0.05}
+
+# Sample rate of the captures, and the tones in them.
+sample_rate=1000000
+tones="-t 50000:1 -t 123456.7:0.01 -t 400000:0.001"
+
+# Power spectra are integrated into this many bins, to keep the outputs
+# small whatever the input length, and must agree across numbers of
+# processes and ways of planning to within this relative error.
+spectrum_bins=4096
+spectrum_tolerance=1e-9
+
+##################################################################
+########## NO USER SERVICABLE PARTS BEYOND THIS POINT ############
+##################################################################
+
+mkdir -p ${bench_directory} || exit 1
+results=${bench_directory}/results.txt
+baseline=${bench_directory}/baseline.txt
+failures=0
+echo "# size ranks plan phase mean_seconds max_seconds" > ${results}
+
+for size in ${bench_sizes}; do
+
+  # Write the capture, unless it's there already. The same seed always
+  # writes the same capture.
+  capture=${bench_directory}/capture-${size}.bin
+  if [ ! -f ${capture} ]; then
+    echo Writing ${size} data points to ${capture}.
+    ./siggen -n ${size} -s ${sample_rate} ${tones} -N 0.1 -S ${size} \
+      -o ${capture} || exit 1
+  fi
+  reference=""
+  for ranks in ${bench_ranks}; do
+    for plan in ${bench_plans}; do
+      wisdom=${bench_directory}/wisdom-${size}-${ranks}
+      case ${plan} in
+        estimate) plan_options="" ;;
+        measure) plan_options="-e ${wisdom}" ;;
+        wisdom) plan_options="-w ${wisdom}" ;;
+        cache) plan_options="--wisdom-dir=${bench_directory}/wisdom" ;;
+        *) echo Unknown way of planning ${plan}.; exit 1 ;;
+      esac
+      spectrum=${bench_directory}/spectrum-${size}-${ranks}-${plan}.csv
+      timings=${bench_directory}/timings-${size}-${ranks}-${plan}.json
+      echo Running ${size} data points on ${ranks} process\(es\), ${plan}.
+      if ! ${bench_mpirun} -np ${ranks} ./pstool -i ${capture} \
+        -s ${sample_rate} -o ${spectrum} --bins=linear:${spectrum_bins} \
+        --timings=${timings} ${plan_options} ${bench_options} > /dev/null; then
+        echo FAILED: pstool exited with an error.
+        failures=$((failures + 1))
+        continue
+      fi
+
+      # Collect the mean and maximum time of each phase.
+      sed -n 's/.*"name": "\([a-z_]*\)".*"max": \([^,]*\), "mean": \([^,]*\),.*/\1 \3 \2/p' \
+        ${timings} | while read phase mean max; do
+        echo ${size} ${ranks} ${plan} ${phase} ${mean} ${max}
+      done >> ${results}
+
+      # Check the power spectrum against the first one of this size.
+      if [ -z "${reference}" ]; then
+        reference=${spectrum}
+      elif ! paste -d , ${reference} ${spectrum} | awk -F , -v \
+        tolerance=${spectrum_tolerance} '
+          /^#/ { next }
+          { d = $2 - $4; if (d < 0) d = -d; if (d > error) error = d;
+            p = ($2 < 0) ? -$2 : $2; if (p > peak) peak = p; rows++ }
+          END { exit !((rows > 0) && (error <= tolerance * peak)) }'; then
+        echo FAILED: power spectrum differs from ${reference}.
+        failures=$((failures + 1))
+      fi
+    done
+  done
+done
+
+# Time windowing the longest capture as it's read. The spectra differ
+# from window to window, so they aren't checked against each other.
+longest=$(for size in ${bench_sizes}; do echo ${size}; done | sort -n | tail -n 1)
+for window in ${bench_windows}; do
+  capture=${bench_directory}/capture-${longest}.bin
+  spectrum=${bench_directory}/spectrum-${longest}-window.csv
+  timings=${bench_directory}/timings-${longest}-window.json
+  echo Running ${longest} data points on 1 process, window ${window}.
+  if ! ${bench_mpirun} -np 1 ./pstool -i ${capture} -s ${sample_rate} \
+    -o ${spectrum} --bins=linear:${spectrum_bins} --window=${window} \
+    --timings=${timings} ${bench_options} > /dev/null; then
+    echo FAILED: pstool exited with an error.
+    failures=$((failures + 1))
+    continue
+  fi
+  sed -n 's/.*"name": "\([a-z_]*\)".*"max": \([^,]*\), "mean": \([^,]*\),.*/\1 \3 \2/p' \
+    ${timings} | while read phase mean max; do
+    echo ${longest} 1 window-${window} ${phase} ${mean} ${max}
+  done >> ${results}
+done
+
+# Keep the results as the baseline if asked to, or if there is none.
+if [ -n "${BENCH_SAVE_BASELINE}" ] || [ ! -f ${baseline} ]; then
+  cp ${results} ${baseline}
+  echo Saved results as the baseline in ${baseline}.
+else
+
+  # Compare the maximum time of each phase with the baseline.
+  awk -v tolerance=${bench_tolerance} -v slack=${bench_slack} '
+    /^#/ { next }
+    FNR == NR { base[$1 " " $2 " " $3 " " $4] = $6; next }
+    {
+      key = $1 " " $2 " " $3 " " $4
+      if (!(key in base)) next
+      if (($6 > base[key] * tolerance) && ($6 > base[key] + slack)) {
+        printf "REGRESSION: %s took %.3f s, %.3f s in the baseline.\n",
+          key, $6, base[key]
+        regressions++
+      }
+    }
+    END { exit regressions > 0 }' ${baseline} ${results} ||
+    failures=$((failures + 1))
+fi
+if [ ${failures} -ne 0 ]; then
+  echo Benchmark failed. See ${results}.
+  exit 1
+fi
+echo Benchmark passed. See ${results}.
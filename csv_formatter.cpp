@@ -0,0 +1,139 @@
+// Time-stamp: <2026-10-17 15:52:40 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// System includes.
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#if __cplusplus >= 201703L
+#   include <charconv>
+#endif
+
+// Local includes.
+#include "thread_pool.h"
+#include "csv_formatter.h"
+
+// Decimals printed for each double. Enough for the 64 bits of a double,
+// ceil (log10 (2^64)).
+#define DECIMALS 20
+
+// Not worth a thread of its own for less than this many rows.
+#define MIN_ROWS_PER_THREAD 65536
+
+// Prints value at p, returning the end of the text. T is float
+// or double.
+template < typename T > static char *
+format_number (char *p, T value)
+{
+#if defined(__cpp_lib_to_chars)
+
+  // Shortest round trip representation, as in "-1.25e+02".
+  char shortest[32];
+  std::to_chars_result result =
+    std::to_chars (shortest, shortest + sizeof (shortest), value,
+		   std::chars_format::scientific);
+  const char *exponent = (const char *) memchr (shortest, 'e',
+						result.ptr - shortest);
+
+  // Infinities and NaNs come out just as printf has them.
+  if (exponent == NULL)
+    {
+      memcpy (p, shortest, result.ptr - shortest);
+      return p + (result.ptr - shortest);
+    }
+
+  // The mantissa, the decimal point if the shortest representation
+  // has no decimals, zeros up to DECIMALS decimals, and the exponent,
+  // which already has at least two digits like printf's.
+  const char *point = (const char *) memchr (shortest, '.',
+					     exponent - shortest);
+  memcpy (p, shortest, exponent - shortest);
+  p += exponent - shortest;
+  int decimals = 0;
+  if (point == NULL)
+    *p++ = '.';
+  else
+    decimals = exponent - point - 1;
+  memset (p, '0', DECIMALS - decimals);
+  p += DECIMALS - decimals;
+  memcpy (p, exponent, result.ptr - exponent);
+  return p + (result.ptr - exponent);
+#else
+  return p + sprintf (p, "%.*e", DECIMALS, (double) value);
+#endif
+}
+
+template < typename T > char *
+CSVFormatter::format_rows (const T * pairs, size_t rows, char *buffer)
+{
+  char *p = buffer;
+  for (size_t ix = 0; ix < rows; ix++)
+    {
+      p = format_number (p, pairs[2 * ix]);
+      *p++ = ',';
+      *p++ = ' ';
+      p = format_number (p, pairs[2 * ix + 1]);
+      *p++ = '\n';
+    }
+  return p;
+}
+
+template < typename T > void
+CSVFormatter::append (const T * pairs, size_t rows, std::string & out)
+{
+
+  // Split the rows between as many threads as are worth it.
+  size_t chunks = rows / MIN_ROWS_PER_THREAD;
+  if (chunks > (size_t) ThreadPool::get_threads ())
+    chunks = ThreadPool::get_threads ();
+  if (chunks < 1)
+    chunks = 1;
+  size_t rows_per_chunk = (rows + chunks - 1) / chunks;
+
+  // Each chunk is formatted into its own part of out, made large
+  // enough for the longest rows. The chunks are then moved together.
+  size_t start = out.size ();
+  out.resize (start + MAX_ROW_LENGTH * rows);
+  char *buffer = &out[start];
+  std::vector < char *>ends (chunks);
+  ThreadPool::parallel_for (chunks, 1, [&] (size_t first, size_t last)
+    {
+      for (size_t chunk = first; chunk < last; chunk++)
+	{
+	  size_t first_row = chunk * rows_per_chunk;
+	  size_t chunk_rows = (first_row + rows_per_chunk > rows) ?
+	    rows - first_row : rows_per_chunk;
+	  ends[chunk] = format_rows (pairs + 2 * first_row, chunk_rows,
+				     buffer + MAX_ROW_LENGTH * first_row);
+	}
+    });
+
+  char *end = ends[0];
+  for (size_t chunk = 1; chunk < chunks; chunk++)
+    {
+      char *chunk_start = buffer + MAX_ROW_LENGTH * chunk * rows_per_chunk;
+      memmove (end, chunk_start, ends[chunk] - chunk_start);
+      end += ends[chunk] - chunk_start;
+    }
+  out.resize (end - out.data ());
+}
+
+// Both precisions.
+template void CSVFormatter::append (const double *pairs, size_t rows,
+				    std::string & out);
+template void CSVFormatter::append (const float *pairs, size_t rows,
+				    std::string & out);
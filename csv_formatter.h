@@ -0,0 +1,75 @@
+// Time-stamp: <2026-10-17 15:52:40 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef CSV_FORMATTER_H
+#define CSV_FORMATTER_H
+
+// System includes.
+#include <string>
+#include <cstddef>
+
+// Formats rows of two doubles (or floats) as "a, b\n" text lines, as
+// found in the power spectrum and transform CSV files.
+//
+// Each double is printed in scientific notation with 20 decimals, as
+// printf's "%.20e" would, but only the shortest decimal that reads
+// back as the same double is printed, and the remaining decimals are
+// zero. The output is thus byte for byte the same as printf's whenever
+// the exact decimal expansion of the double is no longer than its
+// shortest round trip representation, and reads back the same in
+// any case. Floats are printed the same way, with the shortest decimal
+// that reads back as the same float. Where std::to_chars isn't around,
+// printf is used.
+//
+// Large inputs are split into chunks formatted by the threads of the
+// ThreadPool, which are then joined in order.
+class CSVFormatter
+{
+private:
+
+  // Formats rows rows of pairs into buffer, returning the end of
+  // the text. buffer has to hold MAX_ROW_LENGTH * rows chars.
+  template < typename T >
+    static char *format_rows (const T * pairs, size_t rows, char *buffer);
+
+  // Does append_rows for either precision.
+  template < typename T >
+    static void append (const T * pairs, size_t rows, std::string & out);
+public:
+
+  // Longest possible row, "-d.<20 digits>e-ddd, -d.<20 digits>e-ddd\n".
+  enum
+  {
+    MAX_ROW_LENGTH = 64
+  };
+
+  // Appends rows rows of text to out, each made of the two
+  // consecutive doubles pairs[2 * ix] and pairs[2 * ix + 1].
+  static void append_rows (const double *pairs, size_t rows,
+			   std::string & out)
+  {
+    append (pairs, rows, out);
+  }
+
+  // Same as the above, for floats.
+  static void append_rows (const float *pairs, size_t rows,
+			   std::string & out)
+  {
+    append (pairs, rows, out);
+  }
+};
+#endif
@@ -0,0 +1,330 @@
+// Time-stamp: <2026-10-17 15:38:12 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef FFT_BACKEND_H
+#define FFT_BACKEND_H
+
+// System includes.
+#include <mpi.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Picks the FFTW headers for the backend chosen by configure. FFTW2 is
+// the default, and HAVE_FFTW3 is defined to build against FFTW3 instead.
+#ifdef HAVE_FFTW3
+#   include <fftw3-mpi.h>
+
+// FFTW3 has no fftw_real. This is the precision of the default
+// transforms, FFTW3 having separate libraries for each precision.
+typedef double fftw_real;
+
+// Single precision transforms are built in as well.
+#   define HAVE_SINGLE_PRECISION
+#else
+#   include <rfftw.h>
+#   include <rfftw_mpi.h>
+#   include <fftw_mpi.h>
+#endif
+
+// A complex number of precision T. FFTW3's complex numbers are array
+// types, and FFTW2's only come in one precision. This has the same
+// layout as both, and the same members as FFTW2's fftw_complex.
+template < typename T > struct fft_complex_of
+{
+  T re;
+  T im;
+};
+typedef fft_complex_of < fftw_real > fft_complex;
+
+// The parts of FFTW, MPI and NumPy that depend on the precision T of
+// the data. Only exists for the precisions the build supports, double
+// always, and float with HAVE_SINGLE_PRECISION.
+template < typename T > class FFTWPrecision;
+
+template <> class FFTWPrecision < double >
+{
+public:
+#ifdef HAVE_FFTW3
+  typedef fftw_plan plan;
+  typedef fftw_complex complex;
+#else
+
+  // FFTW2 has a distinct type for local real plans.
+  typedef rfftw_plan plan;
+#endif
+
+  // Name of the precision, as given to --precision.
+  static const char *name ()
+  {
+    return "double";
+  }
+
+  // MPI type of a data point.
+  static MPI_Datatype mpi_type ()
+  {
+    return MPI_DOUBLE;
+  }
+
+  // NumPy types of a data point and a complex number.
+  static const char *numpy_type ()
+  {
+    return "f8";
+  }
+  static const char *numpy_complex_type ()
+  {
+    return "c16";
+  }
+
+  static void import_wisdom_from_file (FILE * wisdom_file)
+  {
+    fftw_import_wisdom_from_file (wisdom_file);
+  }
+  static void export_wisdom_to_file (FILE * wisdom_file)
+  {
+    fftw_export_wisdom_to_file (wisdom_file);
+  }
+
+  // Imports wisdom from a string. Returns false if it isn't wisdom.
+  static bool import_wisdom_from_string (const char *wisdom)
+  {
+#ifdef HAVE_FFTW3
+    return fftw_import_wisdom_from_string (wisdom) != 0;
+#else
+    return fftw_import_wisdom_from_string (wisdom) == FFTW_SUCCESS;
+#endif
+  }
+  static std::string export_wisdom_to_string ()
+  {
+    char *
+      wisdom = fftw_export_wisdom_to_string ();
+    std::string exported (wisdom != NULL ? wisdom : "");
+#ifdef HAVE_FFTW3
+    free (wisdom);
+#else
+    fftw_free (wisdom);
+#endif
+    return exported;
+  }
+
+  // Version of the FFTW library.
+  static const char *version ()
+  {
+    return fftw_version;
+  }
+
+  // Collects the wisdom of every process in comm on the primary one.
+  // FFTW2's wisdom is all local, so there's nothing to collect.
+  static void gather_wisdom (MPI_Comm comm)
+  {
+#ifdef HAVE_FFTW3
+    fftw_mpi_gather_wisdom (comm);
+#endif
+  }
+
+  // Limits the time spent measuring each plan to seconds, or lifts the
+  // limit if seconds is negative. FFTW2 has no such limit.
+  static void set_time_limit (double seconds)
+  {
+#ifdef HAVE_FFTW3
+    fftw_set_timelimit (seconds);
+#endif
+  }
+#ifdef HAVE_FFTW3
+  static ptrdiff_t mpi_local_size_1d (ptrdiff_t n, MPI_Comm comm, int sign,
+				      unsigned flags, ptrdiff_t * local_ni,
+				      ptrdiff_t * local_i_start,
+				      ptrdiff_t * local_no,
+				      ptrdiff_t * local_o_start)
+  {
+    return fftw_mpi_local_size_1d (n, comm, sign, flags, local_ni,
+				   local_i_start, local_no, local_o_start);
+  }
+  static plan mpi_plan_dft_1d (ptrdiff_t n, complex * in, complex * out,
+			       MPI_Comm comm, int sign, unsigned flags)
+  {
+    return fftw_mpi_plan_dft_1d (n, in, out, comm, sign, flags);
+  }
+  static plan plan_r2r_1d (int n, double *in, double *out,
+			   fftw_r2r_kind kind, unsigned flags)
+  {
+    return fftw_plan_r2r_1d (n, in, out, kind, flags);
+  }
+  static plan plan_dft_r2c_1d (int n, double *in, complex * out,
+			       unsigned flags)
+  {
+    return fftw_plan_dft_r2c_1d (n, in, out, flags);
+  }
+  static plan plan_many_dft_r2c (int n, int howmany, double *in,
+				 complex * out, unsigned flags)
+  {
+    return fftw_plan_many_dft_r2c (1, &n, howmany, in, NULL, 1, n, out,
+				  NULL, 1, n / 2 + 1, flags);
+  }
+  static plan plan_many_dft (int n, int howmany, complex * in,
+			     int istride, int idist, complex * out,
+			     int ostride, int odist, int sign, unsigned flags)
+  {
+    return fftw_plan_many_dft (1, &n, howmany, in, NULL, istride, idist,
+			       out, NULL, ostride, odist, sign, flags);
+  }
+  static void execute (const plan p)
+  {
+    fftw_execute (p);
+  }
+  static void execute_dft_r2c (const plan p, double *in, complex * out)
+  {
+    fftw_execute_dft_r2c (p, in, out);
+  }
+  static void execute_dft (const plan p, complex * in, complex * out)
+  {
+    fftw_execute_dft (p, in, out);
+  }
+  static void mpi_execute_dft (const plan p, complex * in, complex * out)
+  {
+    fftw_mpi_execute_dft (p, in, out);
+  }
+  static void execute_r2r (const plan p, double *in, double *out)
+  {
+    fftw_execute_r2r (p, in, out);
+  }
+  static void destroy_plan (plan p)
+  {
+    fftw_destroy_plan (p);
+  }
+#endif
+};
+
+#ifdef HAVE_SINGLE_PRECISION
+template <> class FFTWPrecision < float >
+{
+public:
+  typedef fftwf_plan plan;
+  typedef fftwf_complex complex;
+  static const char *name ()
+  {
+    return "single";
+  }
+  static MPI_Datatype mpi_type ()
+  {
+    return MPI_FLOAT;
+  }
+  static const char *numpy_type ()
+  {
+    return "f4";
+  }
+  static const char *numpy_complex_type ()
+  {
+    return "c8";
+  }
+  static void import_wisdom_from_file (FILE * wisdom_file)
+  {
+    fftwf_import_wisdom_from_file (wisdom_file);
+  }
+  static void export_wisdom_to_file (FILE * wisdom_file)
+  {
+    fftwf_export_wisdom_to_file (wisdom_file);
+  }
+  static bool import_wisdom_from_string (const char *wisdom)
+  {
+    return fftwf_import_wisdom_from_string (wisdom) != 0;
+  }
+  static std::string export_wisdom_to_string ()
+  {
+    char *
+      wisdom = fftwf_export_wisdom_to_string ();
+    std::string exported (wisdom != NULL ? wisdom : "");
+    free (wisdom);
+    return exported;
+  }
+  static const char *version ()
+  {
+    return fftwf_version;
+  }
+  static void gather_wisdom (MPI_Comm comm)
+  {
+    fftwf_mpi_gather_wisdom (comm);
+  }
+  static void set_time_limit (double seconds)
+  {
+    fftwf_set_timelimit (seconds);
+  }
+  static ptrdiff_t mpi_local_size_1d (ptrdiff_t n, MPI_Comm comm, int sign,
+				      unsigned flags, ptrdiff_t * local_ni,
+				      ptrdiff_t * local_i_start,
+				      ptrdiff_t * local_no,
+				      ptrdiff_t * local_o_start)
+  {
+    return fftwf_mpi_local_size_1d (n, comm, sign, flags, local_ni,
+				    local_i_start, local_no, local_o_start);
+  }
+  static plan mpi_plan_dft_1d (ptrdiff_t n, complex * in, complex * out,
+			       MPI_Comm comm, int sign, unsigned flags)
+  {
+    return fftwf_mpi_plan_dft_1d (n, in, out, comm, sign, flags);
+  }
+  static plan plan_r2r_1d (int n, float *in, float *out,
+			   fftw_r2r_kind kind, unsigned flags)
+  {
+    return fftwf_plan_r2r_1d (n, in, out, kind, flags);
+  }
+  static plan plan_dft_r2c_1d (int n, float *in, complex * out,
+			       unsigned flags)
+  {
+    return fftwf_plan_dft_r2c_1d (n, in, out, flags);
+  }
+  static plan plan_many_dft_r2c (int n, int howmany, float *in,
+				 complex * out, unsigned flags)
+  {
+    return fftwf_plan_many_dft_r2c (1, &n, howmany, in, NULL, 1, n, out,
+				   NULL, 1, n / 2 + 1, flags);
+  }
+  static plan plan_many_dft (int n, int howmany, complex * in,
+			     int istride, int idist, complex * out,
+			     int ostride, int odist, int sign, unsigned flags)
+  {
+    return fftwf_plan_many_dft (1, &n, howmany, in, NULL, istride, idist,
+				out, NULL, ostride, odist, sign, flags);
+  }
+  static void execute (const plan p)
+  {
+    fftwf_execute (p);
+  }
+  static void execute_dft_r2c (const plan p, float *in, complex * out)
+  {
+    fftwf_execute_dft_r2c (p, in, out);
+  }
+  static void execute_dft (const plan p, complex * in, complex * out)
+  {
+    fftwf_execute_dft (p, in, out);
+  }
+  static void mpi_execute_dft (const plan p, complex * in, complex * out)
+  {
+    fftwf_mpi_execute_dft (p, in, out);
+  }
+  static void execute_r2r (const plan p, float *in, float *out)
+  {
+    fftwf_execute_r2r (p, in, out);
+  }
+  static void destroy_plan (plan p)
+  {
+    fftwf_destroy_plan (p);
+  }
+};
+#endif
+
+#endif
@@ -0,0 +1,206 @@
+// Time-stamp: <2026-10-17 17:05:12 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// System includes.
+#include <cstring>
+#include <stdint.h>
+
+// Local includes.
+#include "fft_backend.h"
+#include "input_type.h"
+
+// Each encoding is converted by a loop of its own, simple enough for
+// the compiler to vectorize. Data points are read with memcpy, as
+// nothing guarantees their alignment.
+namespace
+{
+
+  // Returns x in the byte order of the machine, given it in little
+  // endian byte order.
+  inline uint16_t from_little_endian (uint16_t x)
+  {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    return __builtin_bswap16 (x);
+#else
+    return x;
+#endif
+  }
+
+  inline uint32_t from_little_endian (uint32_t x)
+  {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    return __builtin_bswap32 (x);
+#else
+    return x;
+#endif
+  }
+
+  // Returns x in the byte order of the machine, given it in big
+  // endian byte order.
+  inline uint16_t from_big_endian (uint16_t x)
+  {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    return x;
+#else
+    return __builtin_bswap16 (x);
+#endif
+  }
+
+  template < typename T > void
+  decode_i16 (const unsigned char *__restrict src, size_t count,
+	      T * __restrict dest, int stride, double scale, bool big_endian)
+  {
+    for (size_t ix = 0; ix < count; ix++)
+      {
+	uint16_t raw;
+	memcpy (&raw, src + 2 * ix, 2);
+	raw = big_endian ? from_big_endian (raw) : from_little_endian (raw);
+	dest[ix * stride] = (T) ((int16_t) raw * scale);
+      }
+  }
+
+  template < typename T > void
+  decode_i24le (const unsigned char *__restrict src, size_t count,
+		T * __restrict dest, int stride, double scale)
+  {
+
+    // Assemble the 24 bits in the top of a 32 bit word, and shift them
+    // down arithmetically to sign extend.
+    for (size_t ix = 0; ix < count; ix++)
+      {
+	const unsigned char *sample = src + 3 * ix;
+	int32_t value =
+	  (int32_t) (((uint32_t) sample[0] << 8) |
+		     ((uint32_t) sample[1] << 16) |
+		     ((uint32_t) sample[2] << 24)) >> 8;
+	dest[ix * stride] = (T) (value * scale);
+      }
+  }
+
+  template < typename T > void
+  decode_i32le (const unsigned char *__restrict src, size_t count,
+		T * __restrict dest, int stride, double scale)
+  {
+    for (size_t ix = 0; ix < count; ix++)
+      {
+	uint32_t raw;
+	memcpy (&raw, src + 4 * ix, 4);
+	dest[ix * stride] = (T) ((int32_t) from_little_endian (raw) * scale);
+      }
+  }
+
+  template < typename S, typename T > void
+  decode_float (const unsigned char *__restrict src, size_t count,
+		T * __restrict dest, int stride, double scale)
+  {
+    for (size_t ix = 0; ix < count; ix++)
+      {
+	S value;
+	memcpy (&value, src + sizeof (S) * ix, sizeof (S));
+	dest[ix * stride] = (T) (value * scale);
+      }
+  }
+}
+
+bool
+InputType::parse (const char *spec, InputType & type)
+{
+  static const struct
+  {
+    const char *name;
+    encoding_t encoding;
+  } encodings[] =
+  {
+    {"i16le", I16LE},
+    {"i16be", I16BE},
+    {"i24le", I24LE},
+    {"i32le", I32LE},
+    {"f32", F32},
+    {"f64", F64}
+  };
+  for (size_t ix = 0; ix < sizeof (encodings) / sizeof (encodings[0]); ix++)
+    if (strcmp (spec, encodings[ix].name) == 0)
+      {
+	type.encoding = encodings[ix].encoding;
+	return true;
+      }
+  return false;
+}
+
+size_t
+InputType::get_size () const
+{
+  switch (encoding)
+    {
+    case I16LE:
+    case I16BE:
+      return 2;
+    case I24LE:
+      return 3;
+    case I32LE:
+    case F32:
+      return 4;
+    default:
+      return 8;
+    }
+}
+
+template < typename T > bool
+InputType::is_native () const
+{
+  if (scale != 1)
+    return false;
+  return (sizeof (T) == sizeof (float)) ? (encoding == F32) : (encoding ==
+							       F64);
+}
+
+template < typename T > void
+InputType::decode (const unsigned char *src, size_t count, T * dest,
+		   int stride) const
+{
+  switch (encoding)
+    {
+    case I16LE:
+      decode_i16 (src, count, dest, stride, scale, false);
+      break;
+    case I16BE:
+      decode_i16 (src, count, dest, stride, scale, true);
+      break;
+    case I24LE:
+      decode_i24le (src, count, dest, stride, scale);
+      break;
+    case I32LE:
+      decode_i32le (src, count, dest, stride, scale);
+      break;
+    case F32:
+      decode_float < float >(src, count, dest, stride, scale);
+      break;
+    default:
+      decode_float < double >(src, count, dest, stride, scale);
+      break;
+    }
+}
+
+// The precisions supported.
+template bool InputType::is_native < double > () const;
+template void InputType::decode < double > (const unsigned char *, size_t,
+					    double *, int) const;
+#ifdef HAVE_SINGLE_PRECISION
+template bool InputType::is_native < float > () const;
+template void InputType::decode < float > (const unsigned char *, size_t,
+					   float *, int) const;
+#endif
@@ -0,0 +1,86 @@
+// Time-stamp: <2026-10-17 17:05:12 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef INPUT_TYPE_H
+#define INPUT_TYPE_H
+
+// System includes.
+#include <cstddef>
+
+// How the data points are stored in an input file. Either IEEE-754
+// floating point numbers in the byte order of the machine, or signed
+// integers as written by analog to digital converters, in the byte order
+// given. Each data point is multiplied by a scale factor as it is read,
+// say to turn ADC counts into volts.
+class InputType
+{
+public:
+  typedef enum
+  {
+    I16LE,
+    I16BE,
+    I24LE,
+    I32LE,
+    F32,
+    F64
+  } encoding_t;
+private:
+
+  // Encoding of each data point.
+  encoding_t encoding;
+
+  // Factor each data point is multiplied by.
+  double scale;
+public:
+
+  // Constructor.
+  InputType (encoding_t enc = F64, double factor = 1):encoding (enc),
+    scale (factor)
+  {
+  }
+
+  // Parses "i16le", "i16be", "i24le", "i32le", "f32" or "f64" into the
+  // encoding of type, leaving its scale alone. Returns false if spec
+  // isn't any of those.
+  static bool parse (const char *spec, InputType & type);
+
+  // Returns the encoding of the data points.
+  encoding_t get_encoding () const
+  {
+    return encoding;
+  }
+
+  // Sets the scale factor.
+  void set_scale (double factor)
+  {
+    scale = factor;
+  }
+
+  // Returns the number of bytes taken up by each data point.
+  size_t get_size () const;
+
+  // Returns true if the data points are stored as unscaled T, so they
+  // can be read as they are.
+  template < typename T > bool is_native () const;
+
+  // Converts count data points from src to T, scaling them, and stores
+  // them every stride T in dest. src and dest mustn't overlap.
+  template < typename T > void decode (const unsigned char *src,
+				       size_t count, T * dest,
+				       int stride) const;
+};
+#endif
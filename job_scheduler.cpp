@@ -0,0 +1,240 @@
+// Time-stamp: <2026-10-17 13:21:47 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// System includes.
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+// Local includes.
+#include "stl_ext.h"
+#include "fft_backend.h"
+#include "job_scheduler.h"
+#include "ps_generator.h"
+#include "segmented_fft.h"
+#include "mpirfftw_input.h"
+#include "wisdom_cache.h"
+
+JobScheduler::JobScheduler (const char *manifest_file_name, bool optimal, const char *import_wisdom_file_name, double rate, int length, int overlap, OutputFormat::format_t output_format, const SpectrumBins & spectrum_bins, bool single, const InputType & type, const Window & taper):
+optimal_plan (optimal),
+sample_rate (rate),
+segment_length (length), segment_overlap (overlap),
+format (output_format), bins (spectrum_bins), single_precision (single),
+input_type (type), window (taper), jobs_failed (0)
+{
+
+  // Import wisdom once, rather than once per job. The primary process
+  // reads it for everybody.
+  if (import_wisdom_file_name != NULL)
+    {
+      bool imported;
+#ifdef HAVE_SINGLE_PRECISION
+      if (single_precision)
+	imported = WisdomCache < float >::import_file (import_wisdom_file_name,
+						       MPI_COMM_WORLD);
+      else
+#endif
+	imported = WisdomCache < double >::import_file (import_wisdom_file_name,
+							MPI_COMM_WORLD);
+      if (!imported)
+	throw JobSchedulerException (JobSchedulerException::EFIO,
+				     std::
+				     string
+				     ("couldn't open input wisdom file '") +
+				     import_wisdom_file_name +
+				     std::string ("' for import"));
+    }
+
+  // Only the primary process needs to know about the jobs.
+  if (MPI::COMM_WORLD.Get_rank () != 0)
+    return;
+
+  std::ifstream fin (manifest_file_name);
+  if (!fin.is_open ())
+    throw JobSchedulerException (JobSchedulerException::EFIO,
+				 std::string ("couldn't open manifest '") +
+				 std::string (manifest_file_name) +
+				 std::string ("' for reading"));
+
+  // Parse the manifest, line by line.
+  std::string line;
+  size_t line_number = 0;
+  while (std::getline (fin, line))
+    {
+      line_number++;
+      std::istringstream fields (line);
+      job the_job;
+      std::string extra;
+
+      // Skip blank lines and comments.
+      if (!(fields >> the_job.input_data_file_name) ||
+	  (the_job.input_data_file_name[0] == '#'))
+	continue;
+
+      // Need exactly two file names.
+      if (!(fields >> the_job.export_spectrum_file_name) || (fields >> extra))
+	throw JobSchedulerException (JobSchedulerException::EMANIFEST,
+				     std::string ("manifest '") +
+				     std::string (manifest_file_name) +
+				     std::string ("' line ") +
+				     to_string (line_number) +
+				     std::
+				     string
+				     (" doesn't consist of an input and an output file name"));
+      jobs.push_back (the_job);
+    }
+}
+
+size_t
+JobScheduler::run ()
+{
+  if (MPI::COMM_WORLD.Get_rank () == 0)
+    run_primary ();
+  else
+    run_worker ();
+  return jobs_failed;
+}
+
+void
+JobScheduler::run_primary ()
+{
+  size_t next_job = 0;
+  int workers_left = MPI::COMM_WORLD.Get_size () - 1;
+
+  // If we're all alone, we have to do everything ourselves.
+  if (workers_left == 0)
+    {
+      for (next_job = 0; next_job < jobs.size (); next_job++)
+	if (!process_job (jobs[next_job]))
+	  jobs_failed++;
+      return;
+    }
+
+  // Otherwise answer requests until every worker is sent home.
+  while (workers_left > 0)
+    {
+      int status;
+      MPI_Status request_status;
+      MPI_Recv (&status, 1, MPI_INT, MPI_ANY_SOURCE, TAG_REQUEST,
+		MPI_COMM_WORLD, &request_status);
+      if (status == JOB_FAILED)
+	jobs_failed++;
+
+      if (next_job < jobs.size ())
+	{
+
+	  // Both file names go in one message, each '\0'-terminated.
+	  std::string message =
+	    jobs[next_job].input_data_file_name + '\0' +
+	    jobs[next_job].export_spectrum_file_name;
+	  MPI_Send ((void *) message.c_str (), message.size () + 1, MPI_CHAR,
+		    request_status.MPI_SOURCE, TAG_JOB, MPI_COMM_WORLD);
+	  next_job++;
+	}
+      else
+	{
+	  MPI_Send (NULL, 0, MPI_CHAR, request_status.MPI_SOURCE, TAG_STOP,
+		    MPI_COMM_WORLD);
+	  workers_left--;
+	}
+    }
+}
+
+void
+JobScheduler::run_worker ()
+{
+  int status = JOB_NONE;
+  for (;;)
+    {
+
+      // Report how the last job went and ask for another.
+      MPI_Send (&status, 1, MPI_INT, 0, TAG_REQUEST, MPI_COMM_WORLD);
+
+      // The answer is of unknown length.
+      MPI_Status reply_status;
+      int reply_length;
+      MPI_Probe (0, MPI_ANY_TAG, MPI_COMM_WORLD, &reply_status);
+      MPI_Get_count (&reply_status, MPI_CHAR, &reply_length);
+      std::vector < char >reply (reply_length + 1, '\0');
+      MPI_Recv (&reply[0], reply_length, MPI_CHAR, 0, reply_status.MPI_TAG,
+		MPI_COMM_WORLD, &reply_status);
+      if (reply_status.MPI_TAG == TAG_STOP)
+	break;
+
+      job the_job;
+      the_job.input_data_file_name = &reply[0];
+      the_job.export_spectrum_file_name =
+	&reply[0] + strlen (&reply[0]) + 1;
+      status = process_job (the_job) ? JOB_DONE : JOB_FAILED;
+    }
+}
+
+template < typename T > bool
+JobScheduler::process_job (const job & the_job)
+{
+
+  // A bad file shouldn't take down the rest of the jobs, so errors
+  // are reported and swallowed here.
+  try
+  {
+
+    // Create the input data object, for our eyes only.
+    MPIRFFTWInput < T > input_data (the_job.input_data_file_name.c_str (),
+				    MPI_COMM_SELF, NULL, input_type, false,
+				    window);
+
+    // Transform the whole file as one segment, unless told otherwise.
+    int length = segment_length, overlap = segment_overlap;
+    if (length == 0)
+      {
+	if (input_data.total_data_points_count > (size_t) INT_MAX)
+	  throw JobSchedulerException (JobSchedulerException::ESIZE,
+				       std::string ("input of ") +
+				       to_string (input_data.
+						  total_data_points_count) +
+				       std::
+				       string
+				       (" data points is too long for one process. Use -W"));
+	length = (int) input_data.total_data_points_count;
+	overlap = 0;
+      }
+
+    // Create the transform object. Plans are cached by SegmentedFFT, so
+    // files of the same length share one plan.
+    SegmentedFFT < T > transform (optimal_plan, input_data, NULL,
+				  length, overlap, MPI_COMM_SELF);
+
+    // Find the power spectrum.
+    PSGenerator < T > power_spectrum (transform, sample_rate, bins);
+
+    // Write out power spectrum to disk.
+    power_spectrum.export_spectrum (the_job.export_spectrum_file_name.
+				    c_str (), format);
+  }
+  catch (GenericException & err)
+  {
+    std::cerr << "ERROR: Process #"
+      << MPI::COMM_WORLD.Get_rank ()
+      << ": '" << the_job.input_data_file_name << "': " << err.what ()
+      << "." << std::endl;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,187 @@
+// Time-stamp: <2026-10-17 13:21:47 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef JOB_SCHEDULER_H
+#define JOB_SCHEDULER_H
+
+// System includes.
+#include <mpi.h>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Local includes.
+#include "fft_backend.h"
+#include "input_type.h"
+#include "window.h"
+#include "output_format.h"
+#include "spectrum_bins.h"
+#include "generic_exception.h"
+
+class JobSchedulerException:public GenericException
+{
+public:
+
+  // Error types thrown.
+  typedef enum
+  {
+
+    // File I/O error.
+    EFIO,
+
+    // Malformed manifest.
+    EMANIFEST,
+
+    // Input too long to be transformed by a single process.
+    ESIZE
+  } error_t;
+private:
+
+  // Error code associated with the exception.
+    error_t error_code;
+public:
+
+  // Constructor used for creation of object.
+    JobSchedulerException (error_t err,
+			   const std::
+			   string & aux_err):GenericException (aux_err),
+    error_code (err)
+  {
+  }
+
+  // Returns the error code association with the exception.
+  error_t get_error_code () const
+  {
+    return error_code;
+  }
+};
+
+// Computes the power spectra of many input files listed in a manifest.
+// Each file is transformed in its entirety by a single process. The
+// primary process hands out files to the other processes as they become
+// idle, so that a mix of long and short files keeps everybody busy.
+// With only one process around, the primary process does all the work.
+class JobScheduler
+{
+private:
+
+  // Message tags.
+  enum
+  {
+
+    // Worker to primary process: give me something to do.
+    TAG_REQUEST = 1,
+
+    // Primary process to worker: here's a job.
+    TAG_JOB,
+
+    // Primary process to worker: nothing left, go home.
+    TAG_STOP
+  };
+
+  // Outcome of the last job, sent along with TAG_REQUEST.
+  enum
+  {
+    JOB_NONE,
+    JOB_DONE,
+    JOB_FAILED
+  };
+
+  // A single line of the manifest.
+  typedef struct
+  {
+    std::string input_data_file_name;
+    std::string export_spectrum_file_name;
+  } job;
+
+  // All the jobs. Only filled in on the primary process.
+    std::vector < job > jobs;
+
+  // Have SegmentedFFT create optimal plans?
+  bool optimal_plan;
+
+  // Sample rate of all input data.
+  double sample_rate;
+
+  // Segment length and overlap as for -W, or 0 to transform each
+  // file as a whole.
+  int segment_length;
+  int segment_overlap;
+
+  // Format of the power spectrum files.
+  OutputFormat::format_t format;
+
+  // Layout of the power spectrum bins.
+  SpectrumBins bins;
+
+  // Are the input files transformed in single precision, rather
+  // than double?
+  bool single_precision;
+
+  // How the data points are stored in the input files.
+  InputType input_type;
+
+  // The window each segment is multiplied by.
+  Window window;
+
+  // Number of jobs that failed.
+  size_t jobs_failed;
+
+  // Hands out jobs. Primary process only.
+  void run_primary ();
+
+  // Asks for jobs and does them.
+  void run_worker ();
+
+  // Does a single job, with data points of type T. Returns false if
+  // it failed.
+  template < typename T > bool process_job (const job & the_job);
+
+  // Does a single job in the precision asked for.
+  bool process_job (const job & the_job)
+  {
+#ifdef HAVE_SINGLE_PRECISION
+    if (single_precision)
+      return process_job < float >(the_job);
+#endif
+    return process_job < double >(the_job);
+  }
+public:
+
+  // Constructor. Reads the manifest on the primary process. Each line of
+  // the manifest holds an input file name followed by the file name to
+  // save its power spectrum to. Empty lines and lines beginning with '#'
+  // are ignored. Wisdom is imported once here, if needed. Input files
+  // are transformed in single precision if single_precision is set,
+  // their data points are stored as type says, and each segment is
+  // multiplied by taper.
+    JobScheduler (const char *manifest_file_name,
+		  bool optimal_plan,
+		  const char *import_wisdom_file_name,
+		  double sample_rate, int segment_length,
+		  int segment_overlap,
+		  OutputFormat::format_t format = OutputFormat::CSV,
+		  const SpectrumBins & bins = SpectrumBins (),
+		  bool single_precision = false,
+		  const InputType & type = InputType (),
+		  const Window & taper = Window ());
+
+  // Does all the jobs. Must be called by every process. Returns the
+  // number of failed jobs on the primary process, and zero elsewhere.
+  size_t run ();
+};
+#endif
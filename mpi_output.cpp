@@ -0,0 +1,231 @@
+// Time-stamp: <2026-10-17 15:10:05 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// System includes.
+#include <vector>
+#include <climits>
+
+// Local includes.
+#include "stl_ext.h"
+#include "mpi_output.h"
+
+// Largest number of bytes handed to MPI in one go, as MPI counts are ints.
+#define MAX_WRITE_CHUNK (1 << 30)
+
+MPIOutput::MPIOutput (const char *name, MPI_Comm communicator):
+comm (communicator), file_name (name), outfile_opened (MPI_FILE_NULL),
+collective (true), file_offset (0), pending_write (MPI_REQUEST_NULL)
+{
+  MPI_Comm_rank (comm, &rank);
+
+  // Try MPI-IO first. Everybody has to agree it worked.
+  int
+    opened = (MPI_File_open (comm, (char *) name,
+			     MPI_MODE_WRONLY | MPI_MODE_CREATE,
+			     MPI_INFO_NULL, &outfile_opened) == MPI_SUCCESS);
+  int
+    all_opened;
+  MPI_Allreduce (&opened, &all_opened, 1, MPI_INT, MPI_MIN, comm);
+
+  // Get rid of whatever was there before.
+  if (all_opened)
+    all_opened = (MPI_File_set_size (outfile_opened, 0) == MPI_SUCCESS);
+  if (all_opened)
+    return;
+
+  // Fall back to gathering everything on the primary process.
+  if (opened)
+    MPI_File_close (&outfile_opened);
+  collective = false;
+  if (rank == 0)
+    {
+      fout.open (name, std::ios::out | std::ios::trunc | std::ios::binary);
+      if (!fout.is_open ())
+	throw MPIOutputException (MPIOutputException::EFIO,
+				  std::string ("could not open '") +
+				  file_name + std::string ("' for writing"));
+    }
+}
+
+MPIOutput::~MPIOutput ()
+{
+
+  // Nothing may be left pending when the file is closed.
+  MPI_Status write_status;
+  MPI_Wait (&pending_write, &write_status);
+  if (outfile_opened != MPI_FILE_NULL)
+    MPI_File_close (&outfile_opened);
+  if (fout.is_open ())
+    fout.close ();
+}
+
+void
+MPIOutput::write_all (MPI_Offset offset, const char *data, long long length)
+{
+
+  // Everybody makes the same number of collective calls, even if
+  // some have less (or nothing) to write.
+  long long
+    my_chunks = (length + MAX_WRITE_CHUNK - 1) / MAX_WRITE_CHUNK,
+    chunks;
+  MPI_Allreduce (&my_chunks, &chunks, 1, MPI_LONG_LONG, MPI_MAX, comm);
+  for (long long chunk = 0; chunk < chunks; chunk++)
+    {
+      long long
+	done = chunk * MAX_WRITE_CHUNK,
+	count = length - done;
+      if (count > MAX_WRITE_CHUNK)
+	count = MAX_WRITE_CHUNK;
+      if (count < 0)
+	count = 0;
+
+      MPI_Status write_status;
+      if (MPI_File_write_at_all (outfile_opened, offset + done,
+				 (char *) data + (count ? done : 0),
+				 (int) count, MPI_CHAR,
+				 &write_status) != MPI_SUCCESS)
+	throw MPIOutputException (MPIOutputException::EFIO,
+				  std::string ("could not write to '") +
+				  file_name + std::string ("'"));
+    }
+}
+
+void
+MPIOutput::gather_and_write (MPI_Offset offset, const char *data,
+			     size_t length)
+{
+  int
+    size;
+  MPI_Comm_size (comm, &size);
+
+  // Sizes and offsets first.
+  int
+    my_length = (int) length;
+  if (length > (size_t) INT_MAX)
+    throw MPIOutputException (MPIOutputException::EFIO,
+			      std::string ("too much data to gather for '") +
+			      file_name + std::string ("'"));
+  long long
+    my_offset = offset;
+  std::vector < int >
+  lengths (size),
+  displs (size);
+  std::vector < long long >
+  offsets (size);
+  MPI_Gather (&my_length, 1, MPI_INT, &lengths[0], 1, MPI_INT, 0, comm);
+  MPI_Gather (&my_offset, 1, MPI_LONG_LONG, &offsets[0], 1, MPI_LONG_LONG, 0,
+	      comm);
+  long long
+    total = 0;
+  for (int ix = 0; ix < size; ix++)
+    {
+      displs[ix] = (int) total;
+      total += lengths[ix];
+    }
+  if ((rank == 0) && (total > INT_MAX))
+    throw MPIOutputException (MPIOutputException::EFIO,
+			      std::string ("too much data to gather for '") +
+			      file_name + std::string ("'"));
+  std::vector < char >
+  gathered (rank == 0 ? total + 1 : 1);
+  MPI_Gatherv ((char *) data, my_length, MPI_CHAR,
+	       &gathered[0], &lengths[0], &displs[0], MPI_CHAR, 0, comm);
+  if (rank != 0)
+    return;
+  for (int ix = 0; ix < size; ix++)
+    if (lengths[ix] > 0)
+      {
+	fout.seekp (file_offset + offsets[ix]);
+	fout.write (&gathered[displs[ix]], lengths[ix]);
+      }
+  if (!fout)
+    throw MPIOutputException (MPIOutputException::EFIO,
+			      std::string ("could not write to '") +
+			      file_name + std::string ("'"));
+}
+
+void
+MPIOutput::write (const char *data, size_t length)
+{
+
+  // Whatever write was started before goes first.
+  finish_write ();
+
+  // Find where our bytes go, and how many bytes go in total.
+  long long
+    my_length = length,
+    preceding = 0,
+    total = 0;
+  MPI_Exscan (&my_length, &preceding, 1, MPI_LONG_LONG, MPI_SUM, comm);
+  if (rank == 0)
+    preceding = 0;
+  MPI_Allreduce (&my_length, &total, 1, MPI_LONG_LONG, MPI_SUM, comm);
+  if (collective)
+    write_all (file_offset + preceding, data, my_length);
+  else
+    gather_and_write (preceding, data, length);
+  file_offset += total;
+}
+
+void
+MPIOutput::write_at (size_t offset, const char *data, size_t length)
+{
+
+  // Whatever write was started before goes first.
+  finish_write ();
+  if (collective)
+    write_all (file_offset + (MPI_Offset) offset, data, (long long) length);
+  else
+    gather_and_write ((MPI_Offset) offset, data, length);
+}
+
+void
+MPIOutput::start_write_at (size_t offset, const char *data, size_t length)
+{
+  finish_write ();
+#if (MPI_VERSION > 3) || ((MPI_VERSION == 3) && (MPI_SUBVERSION >= 1))
+
+  // A single collective call is started if everybody's data fits in
+  // one. Otherwise it's written out there and then.
+  long long
+    my_length = length,
+    longest;
+  MPI_Allreduce (&my_length, &longest, 1, MPI_LONG_LONG, MPI_MAX, comm);
+  if (collective && (longest <= MAX_WRITE_CHUNK))
+    {
+      if (MPI_File_iwrite_at_all (outfile_opened,
+				  file_offset + (MPI_Offset) offset,
+				  (char *) data, (int) length, MPI_CHAR,
+				  &pending_write) != MPI_SUCCESS)
+	throw MPIOutputException (MPIOutputException::EFIO,
+				  std::string ("could not write to '") +
+				  file_name + std::string ("'"));
+      return;
+    }
+#endif
+  write_at (offset, data, length);
+}
+
+void
+MPIOutput::finish_write ()
+{
+  MPI_Status write_status;
+  if (MPI_Wait (&pending_write, &write_status) != MPI_SUCCESS)
+    throw MPIOutputException (MPIOutputException::EFIO,
+			      std::string ("could not write to '") +
+			      file_name + std::string ("'"));
+}
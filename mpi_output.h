@@ -0,0 +1,147 @@
+// Time-stamp: <2026-10-17 15:10:05 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef MPIOUTPUT_H
+#define MPIOUTPUT_H
+
+// System includes.
+#include <mpi.h>
+#include <string>
+#include <fstream>
+#include <cstddef>
+
+// Local includes.
+#include "generic_exception.h"
+
+class MPIOutputException:public GenericException
+{
+public:
+
+  // Error types thrown.
+  typedef enum
+  {
+
+    // File I/O error.
+    EFIO
+  } error_t;
+private:
+
+  // Error code associated with the exception.
+    error_t error_code;
+public:
+
+  // Constructor used for creation of object.
+    MPIOutputException (error_t err,
+			const std::
+			string & aux_err):GenericException (aux_err),
+    error_code (err)
+  {
+  }
+
+  // Returns the error code association with the exception.
+  error_t get_error_code () const
+  {
+    return error_code;
+  }
+};
+
+// An output file shared by all processes in a communicator. Each
+// call to write appends what every process passed it, in rank order.
+// Writing is done with collective MPI-IO where possible. If the file
+// can't be opened through MPI-IO (some file systems don't do MPI-IO
+// writes), everything is gathered on the primary process instead,
+// which writes it out by itself.
+class MPIOutput
+{
+private:
+
+  // Communicator of the processes writing.
+  MPI_Comm comm;
+
+  // Our rank in comm.
+  int rank;
+
+  // File name, for error messages.
+  std::string file_name;
+
+  // MPI File descriptor, if we're using MPI-IO...
+  MPI_File outfile_opened;
+
+  // ...or the primary process' stream, if we're not.
+  std::ofstream fout;
+
+  // Are we using MPI-IO?
+  bool collective;
+
+  // Where the next write goes.
+  MPI_Offset file_offset;
+
+  // The write started by start_write_at and not finished yet, if any.
+  MPI_Request pending_write;
+
+  // Writes length bytes from each process at offset bytes from the
+  // start of the file, each process its own, with collective MPI-IO.
+  void write_all (MPI_Offset offset, const char *data, long long length);
+
+  // Writes length bytes from each process at offset bytes past
+  // file_offset, gathering them on the primary process.
+  void gather_and_write (MPI_Offset offset, const char *data,
+			 size_t length);
+public:
+
+  // Constructor. Creates (or truncates) the file. Must be called by
+  // every process in comm.
+    MPIOutput (const char *file_name, MPI_Comm comm = MPI_COMM_WORLD);
+
+  // Destructor. Closes the file.
+   ~MPIOutput ();
+
+  // Appends length bytes from each process, in rank order. Must be
+  // called by every process in comm, with length possibly 0.
+  void write (const char *data, size_t length);
+
+  // Same as the above, for an STL string.
+  void write (const std::string & data)
+  {
+    write (data.data (), data.size ());
+  }
+
+  // Writes length bytes from each process offset bytes past the end of
+  // what was appended so far, where no other process writes. This
+  // doesn't append anything, so skip past what was written afterwards.
+  // Must be called by every process in comm, with length possibly 0.
+  void write_at (size_t offset, const char *data, size_t length);
+
+  // Starts writing as by write_at, but returns while the data may
+  // still be being written, where MPI-IO can do that (MPI 3.1 and up),
+  // so that the next data can be worked out meanwhile. data must be
+  // left alone until finish_write is called. Any other write finishes
+  // this one first. Must be called by every process in comm, with
+  // length possibly 0.
+  void start_write_at (size_t offset, const char *data, size_t length);
+
+  // Waits for the write started by start_write_at, if any, to finish.
+  // Must be called by every process in comm.
+  void finish_write ();
+
+  // Moves the end of what was appended so far length bytes on.
+  void skip (size_t length)
+  {
+    file_offset += (MPI_Offset) length;
+  }
+};
+#endif
@@ -17,22 +17,99 @@
 
 // System includes.
 #include <cerrno>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 // Local includes.
 #include "stl_ext.h"
+#include "phase_timer.h"
+#include "thread_pool.h"
 #include "mpirfftw_input.h"
 
-MPIRFFTWInput::MPIRFFTWInput (char *file_name):
-  total_data_points_count (0)
+// Number of data points converted at a time.
+#define DECODE_CHUNK 4096
+
+// Number of window weights worked out at a time.
+#define WEIGHT_CHUNK 1024
+
+// Not worth a thread of its own for less than this many data points.
+#define MIN_POINTS_PER_THREAD 65536
+
+template < typename T > MPIRFFTWInput < T >::MPIRFFTWInput (const char *file_name, MPI_Comm comm, const char *hints, const InputType & type, bool read_locally, const Window & taper):
+  infile_opened (MPI_FILE_NULL), local (read_locally), input_file_name (file_name),
+  mapped_data (NULL), mapped_length (0),
+  input_type (type), window (taper), total_data_points_count (0),
+  input_data_array (NULL),
+  read_bytes (0), read_seconds (0), read_pending (false),
+  pending_read (MPI_REQUEST_NULL), pending_view (false)
 {
 
-  // Open the file.
-  MPI_File_open (MPI_COMM_WORLD,
-		 file_name, MPI_MODE_RDONLY, MPI_INFO_NULL, &infile_opened);
+  // Time the opening of the file.
+  PhaseTimer timer (PhaseTimer::OPEN);
+
+  // Local reads don't need MPI-IO at all. Just find the size of the file.
+  if (local)
+    {
+      struct stat file_status;
+      if (stat (file_name, &file_status) != 0)
+	throw
+	  MPIRFFTWInputException (MPIRFFTWInputException::EFIO,
+				  std::
+				  string ("couldn't open input data file '") +
+				  std::string (file_name) +
+				  std::string ("' for reading"));
+      total_data_points_count = file_status.st_size / input_type.get_size ();
+      if (total_data_points_count == 0)
+	throw
+	  MPIRFFTWInputException (MPIRFFTWInputException::EEMPTY,
+				  std::string ("input data file '") +
+				  std::string (file_name) +
+				  std::string ("' is lacking in data points"));
+      return;
+    }
 
-  // Check for failure.
-  if (infile_opened == NULL)
+  // Turn the hints into an MPI_Info object. Hints are a comma separated
+  // list of key=value pairs, as in "cb_nodes=8,cb_buffer_size=16777216".
+  MPI_Info
+    info = MPI_INFO_NULL;
+  if ((hints != NULL) && (*hints != '\0'))
+    {
+      MPI_Info_create (&info);
+      std::string hints_left (hints);
+      while (!hints_left.empty ())
+	{
+	  std::string hint = hints_left.substr (0, hints_left.find (','));
+	  hints_left.erase (0, hint.size () + 1);
+	  size_t equals = hint.find ('=');
+	  if ((equals == 0) || (equals == std::string::npos) ||
+	      (equals == hint.size () - 1))
+	    {
+	      MPI_Info_free (&info);
+	      throw
+		MPIRFFTWInputException (MPIRFFTWInputException::EHINTS,
+					std::string ("malformed MPI-IO hint '") +
+					hint +
+					std::string ("', expected key=value"));
+	    }
+	  MPI_Info_set (info,
+			(char *) hint.substr (0, equals).c_str (),
+			(char *) hint.substr (equals + 1).c_str ());
+	}
+    }
+
+  // Open the file, checking for failure.
+  int
+    open_status = MPI_File_open (comm,
+				 (char *) file_name, MPI_MODE_RDONLY, info,
+				 &infile_opened);
+  if (info != MPI_INFO_NULL)
+    MPI_Info_free (&info);
+  if (open_status != MPI_SUCCESS)
     throw
       MPIRFFTWInputException (MPIRFFTWInputException::EFIO,
 			      std::
@@ -41,11 +118,10 @@ MPIRFFTWInput::MPIRFFTWInput (char *file_name):
 			      std::string ("' for reading"));
 
   // Find the total number of data points inside the opened file.
-  // A data point consists of a single fftw_real.
   MPI_Offset
     filesize;
   MPI_File_get_size (infile_opened, &filesize);
-  total_data_points_count = filesize / sizeof (fftw_real);
+  total_data_points_count = filesize / input_type.get_size ();
 
   // If the file doesn't contain at least one data point.
   if (total_data_points_count == 0)
@@ -56,22 +132,46 @@ MPIRFFTWInput::MPIRFFTWInput (char *file_name):
 			      std::string ("' is lacking in data points"));
 }
 
-MPIRFFTWInput::~MPIRFFTWInput ()
+template < typename T > MPIRFFTWInput < T >::~MPIRFFTWInput ()
 {
-  free (input_data_array);
+
+  // read_data closes the file itself, read_segment doesn't. Nothing
+  // may be left pending when it's closed.
+  if (read_pending)
+    cancel_read ();
+  if (infile_opened != MPI_FILE_NULL)
+    MPI_File_close (&infile_opened);
+
+  // The input data array may be the mapping of the file.
+  if (mapped_data != NULL)
+    munmap (mapped_data, mapped_length);
+  if ((void *) input_data_array != mapped_data)
+    free (input_data_array);
 }
 
-void
-MPIRFFTWInput::read_data (RealFFT & transform)
+template < typename T > void
+MPIRFFTWInput < T >::read_data (RealFFT < T > &transform)
 {
 
+  // Time the read.
+  PhaseTimer timer (PhaseTimer::READ);
+
+  // Local reads are a different story.
+  if (local)
+    {
+      map_data (transform);
+      return;
+    }
+
   // Allocate memory for input data array. Page align it.
   // Yes, even if rfftwnd_mpi_local_sizes dictates nothing to be read,
-  // it still dictates an array to be allocated.
-  if (posix_memalign ((void **) (&input_data_array),
-                      sysconf (_SC_PAGESIZE),
-                      sizeof (fftw_real) *
-                      transform.local_data_array_length) == ENOMEM)
+  // it still dictates an array to be allocated. The FFTW3 RealFFT
+  // allocates it itself, as it needs it to create the plan.
+  if ((input_data_array == NULL) &&
+      (posix_memalign ((void **) (&input_data_array),
+                       sysconf (_SC_PAGESIZE),
+                       sizeof (T) *
+                       transform.local_data_array_length) == ENOMEM))
     throw MPIRFFTWInputException (MPIRFFTWInputException::EMEM,
                                   std::
                                   string
@@ -82,34 +182,653 @@ MPIRFFTWInput::read_data (RealFFT & transform)
                                   +
                                   std::
                                   string
-                                  (" fftw_reals. Maybe data too big to fit in memory? Increase number of MPI nodes"));
+                                  (" data points. Maybe data too big to fit in memory? Increase number of MPI nodes"));
 
-  // Create the file view.
-  MPI_File_set_view (infile_opened,
-                     transform.how_many_to_be_skipped *
-                     sizeof (fftw_real), MPI_DOUBLE, MPI_DOUBLE,
-                     (char *) "native", MPI_INFO_NULL);
-  
-  // Read in our data. First we must create a new input_data_array datatype, since
-  // the data we read in will not be placed continuously in the input_data_array.
-  // Instead we need to pad each fftw_real placed with another fftw_real.
-  // This is due to the way rfftwnd_mpi expects input_data_array to be structured.
-  MPI_Datatype input_data_array_type;
-  MPI_Type_vector (transform.how_many_to_be_read,	// This many data points...
-                   1,                               	// Each data point consisting of one double...
-                   2,                                 	// ... which is padded with another double.
-                   MPI_DOUBLE, &input_data_array_type);
-  
-  // Commit the datatype. Needed before we can use it.
-  MPI_Type_commit (&input_data_array_type);
-  
-  // Read in the appropriate data.
+  // A padded transform may want data points past the end of the file,
+  // which are zeroed once the rest have been read.
+  size_t first_data_point = transform.how_many_to_be_skipped;
+  int stride = transform.input_stride;
+  int count = (first_data_point >= total_data_points_count) ? 0 :
+    (int) std::min ((size_t) transform.how_many_to_be_read,
+		    total_data_points_count - first_data_point);
+
+  // Data points stored as anything but T have to be converted as
+  // they are read.
+  if (!input_type.is_native < T > ())
+    {
+      read_converted (first_data_point, count, input_data_array, stride,
+		      transform.local_data_array_length, true,
+		      first_data_point, total_data_points_count);
+      pad (input_data_array + (size_t) count * stride,
+	   transform.how_many_to_be_read - count, stride);
+      MPI_File_close (&infile_opened);
+      return;
+    }
+
+  // Read in our data. All processes read at once, each a single contiguous
+  // block of the file, which lets the MPI-IO layer merge the requests
+  // into few large ones. rfftwnd_mpi wants each data point padded with
+  // another T, so if input_stride is 2, the data is read into
+  // the first half of input_data_array, and then spread out.
   MPI_Status read_status;
-  MPI_File_read (infile_opened,	        // Read from out opened input data file.
-                 input_data_array,	// Into the input_data_array.
-                 1,	                // Read 1 such layout described by input_data_array_type.
-                 input_data_array_type, &read_status);
-  
+  double read_start = MPI_Wtime ();
+  if (MPI_File_read_at_all (infile_opened,
+                            (MPI_Offset) first_data_point * sizeof (T),
+                            input_data_array, count,
+                            FFTWPrecision < T >::mpi_type (),
+                            &read_status) != MPI_SUCCESS)
+    throw MPIRFFTWInputException (MPIRFFTWInputException::EFIO,
+                                  std::string ("couldn't read ") +
+                                  to_string (count) +
+                                  std::string (" data points at data point ") +
+                                  to_string (first_data_point));
+  read_seconds += MPI_Wtime () - read_start;
+  read_bytes += (double) count * sizeof (T);
+
+  // Spread out. Data points ix >= end / stride all move past end,
+  // where no data point that hasn't moved yet lies, so they can be
+  // moved at once, by several threads. Then the same goes for the
+  // data points before them, and so on. Each thread weighs the data
+  // points it has moved while they are still in its cache. Data point
+  // 0 stays where it is, and is weighed last.
+  size_t window_start = first_data_point;
+  if (stride == 1)
+    taper (input_data_array, count, 1, window_start,
+	   total_data_points_count);
+  else
+    {
+      for (size_t end = count; end > 1;)
+	{
+	  size_t begin = (end + stride - 1) / stride;
+	  T *data = input_data_array;
+	  ThreadPool::parallel_for (end - begin, MIN_POINTS_PER_THREAD,
+				    [&] (size_t first, size_t last)
+	    {
+	      for (size_t ix = begin + first; ix < begin + last; ix++)
+		data[ix * stride] = data[ix];
+	      weigh (data + (begin + first) * stride, last - first, stride,
+		     window_start + begin + first, total_data_points_count);
+	    });
+	  end = begin;
+	}
+      if (count > 0)
+	weigh (input_data_array, 1, stride, window_start,
+	       total_data_points_count);
+    }
+  pad (input_data_array + (size_t) count * stride,
+       transform.how_many_to_be_read - count, stride);
+
   // Close the file as it's not needed anymore.
   MPI_File_close (&infile_opened);
 }
+
+template < typename T > void
+MPIRFFTWInput < T >::read_segment (size_t first_data_point, int count,
+				   T * dest)
+{
+
+  // Time the read.
+  PhaseTimer timer (PhaseTimer::READ);
+  tabulate (count);
+
+  // Data points stored as anything but T have to be converted as
+  // they are read.
+  if (!input_type.is_native < T > ())
+    {
+      read_converted (first_data_point, count, dest, 1, count, false, 0,
+		      count);
+      return;
+    }
+
+  // Read in the segment. The default file view is used, so the
+  // offset is in bytes.
+  MPI_Status read_status;
+  double read_start = MPI_Wtime ();
+  if (MPI_File_read_at (infile_opened,
+			(MPI_Offset) first_data_point * sizeof (T),
+			dest, count, FFTWPrecision < T >::mpi_type (),
+			&read_status) != MPI_SUCCESS)
+    throw MPIRFFTWInputException (MPIRFFTWInputException::EFIO,
+				  std::string ("couldn't read ") +
+				  to_string (count) +
+				  std::string (" data points at data point ") +
+				  to_string (first_data_point));
+  read_seconds += MPI_Wtime () - read_start;
+  read_bytes += (double) count * sizeof (T);
+  taper (dest, count, 1, 0, count);
+}
+
+template < typename T > void
+MPIRFFTWInput < T >::read_strided (size_t first_data_point, int runs,
+				   int run_length, size_t run_stride,
+				   T * dest)
+{
+  start_strided (first_data_point, runs, run_length, run_stride, dest);
+  finish_strided ();
+}
+
+template < typename T > void
+MPIRFFTWInput < T >::start_strided (size_t first_data_point, int runs,
+				    int run_length, size_t run_stride,
+				    T * dest)
+{
+
+  // Time the read.
+  PhaseTimer timer (PhaseTimer::READ);
+  pending_runs = runs;
+  pending_run_length = run_length;
+  pending_run_stride = run_stride;
+  start_runs (first_data_point, runs, run_length, run_stride, dest);
+}
+
+template < typename T > void
+MPIRFFTWInput < T >::finish_strided ()
+{
+
+  // Time the read, or what's left of it.
+  PhaseTimer timer (PhaseTimer::READ);
+  finish_read ();
+
+  // Run r starts with data point first_data_point + r * run_stride of
+  // the whole file.
+  int runs = pending_runs, run_length = pending_run_length;
+  size_t first_data_point = pending_first, run_stride = pending_run_stride;
+  T *dest = pending_dest;
+  if ((window.get_shape () != Window::RECTANGULAR) && (runs > 0))
+    ThreadPool::parallel_for (runs, MIN_POINTS_PER_THREAD / run_length + 1,
+			      [&] (size_t first, size_t last)
+      {
+	for (size_t run = first; run < last; run++)
+	  weigh (dest + run * run_length, run_length, 1,
+		 first_data_point + run * run_stride,
+		 total_data_points_count);
+      });
+}
+
+template < typename T > void
+MPIRFFTWInput < T >::start_segment (size_t first_data_point, int count,
+				    T * dest)
+{
+
+  // Time the read.
+  PhaseTimer timer (PhaseTimer::READ);
+  tabulate (count);
+
+  // Data points stored as T are read straight into dest, anything
+  // else into a separate buffer, and converted once they're in.
+  size_t sample_size = input_type.get_size ();
+  unsigned char *staging = (unsigned char *) dest;
+  if (!input_type.is_native < T > ())
+    {
+      pending_staging.resize ((size_t) count * sample_size + 1);
+      staging = &pending_staging[0];
+    }
+  pending_first = first_data_point;
+  pending_dest = dest;
+  pending_count = count;
+  pending_start = MPI_Wtime ();
+
+  // Read in the segment, as many bytes a data point. The default file
+  // view is used, so the offset is in bytes.
+  MPI_Datatype sample_type;
+  MPI_Type_contiguous ((int) sample_size, MPI_BYTE, &sample_type);
+  MPI_Type_commit (&sample_type);
+  int read_result = MPI_File_iread_at (infile_opened,
+				       (MPI_Offset) first_data_point *
+				       sample_size, staging, count,
+				       sample_type, &pending_read);
+  MPI_Type_free (&sample_type);
+  if (read_result != MPI_SUCCESS)
+    throw MPIRFFTWInputException (MPIRFFTWInputException::EFIO,
+				  std::string ("couldn't read ") +
+				  to_string (count) +
+				  std::string (" data points at data point ") +
+				  to_string (first_data_point));
+  read_pending = true;
+}
+
+template < typename T > void
+MPIRFFTWInput < T >::finish_segment ()
+{
+
+  // Time the read, or what's left of it.
+  PhaseTimer timer (PhaseTimer::READ);
+  finish_read ();
+  taper (pending_dest, pending_count, 1, 0, pending_count);
+}
+
+template < typename T > void
+MPIRFFTWInput < T >::cancel_read ()
+{
+  if (!read_pending)
+    return;
+  MPI_Status read_status;
+  MPI_Wait (&pending_read, &read_status);
+  if (pending_view)
+    MPI_File_set_view (infile_opened, 0, MPI_BYTE, MPI_BYTE,
+		       (char *) "native", MPI_INFO_NULL);
+  pending_view = false;
+  read_pending = false;
+}
+
+template < typename T > void
+MPIRFFTWInput < T >::read_frames (size_t first_data_point, int frames,
+				  int length, int hop, T * dest)
+{
+  start_frames (first_data_point, frames, length, hop, dest);
+  finish_frames ();
+}
+
+template < typename T > void
+MPIRFFTWInput < T >::start_frames (size_t first_data_point, int frames,
+				   int length, int hop, T * dest)
+{
+
+  // Time the read.
+  PhaseTimer timer (PhaseTimer::READ);
+
+  // Every frame is multiplied by the same weights, so they are
+  // worked out once.
+  tabulate (length);
+  pending_frames = frames;
+  pending_frame_length = length;
+  pending_frame_hop = hop;
+  pending_frames_dest = dest;
+
+  // Frames that don't overlap are read straight into dest. Overlapping
+  // ones are read as the single run of data points they span, so that
+  // no data point is read twice, and then copied out frame by frame.
+  frame_span.clear ();
+  if ((hop >= length) || (frames == 0))
+    start_runs (first_data_point, frames, length, hop, dest);
+  else
+    {
+      int span_length = (frames - 1) * hop + length;
+      frame_span.resize (span_length);
+      start_runs (first_data_point, 1, span_length, span_length,
+		  &frame_span[0]);
+    }
+}
+
+template < typename T > void
+MPIRFFTWInput < T >::finish_frames ()
+{
+
+  // Time the read, or what's left of it.
+  PhaseTimer timer (PhaseTimer::READ);
+  finish_read ();
+  int frames = pending_frames, length = pending_frame_length,
+    hop = pending_frame_hop;
+  T *dest = pending_frames_dest;
+  if ((frames == 0) ||
+      (frame_span.empty () && (window.get_shape () == Window::RECTANGULAR)))
+    return;
+  ThreadPool::parallel_for (frames, MIN_POINTS_PER_THREAD / length + 1,
+			    [&] (size_t first, size_t last)
+    {
+      for (size_t frame = first; frame < last; frame++)
+	{
+	  if (!frame_span.empty ())
+	    std::copy (&frame_span[frame * hop],
+		       &frame_span[frame * hop] + length,
+		       dest + frame * length);
+	  weigh (dest + frame * length, length, 1, 0, length);
+	}
+    });
+}
+
+template < typename T > void
+MPIRFFTWInput < T >::read_runs (size_t first_data_point, int runs,
+				int run_length, size_t run_stride, T * dest)
+{
+  start_runs (first_data_point, runs, run_length, run_stride, dest);
+  finish_read ();
+}
+
+template < typename T > void
+MPIRFFTWInput < T >::start_runs (size_t first_data_point, int runs,
+				 int run_length, size_t run_stride, T * dest)
+{
+
+  // Data points stored as T are read straight into dest, anything
+  // else into a separate buffer, and converted once they're in.
+  size_t sample_size = input_type.get_size ();
+  int count = (runs > 0) ? runs * run_length : 0;
+  unsigned char *staging = (unsigned char *) dest;
+  if (!input_type.is_native < T > ())
+    {
+      pending_staging.resize ((size_t) count * sample_size + 1);
+      staging = &pending_staging[0];
+    }
+  pending_first = first_data_point;
+  pending_dest = dest;
+  pending_count = count;
+  pending_start = MPI_Wtime ();
+
+  // The runs are described by the file view, so that they are read
+  // with a single collective call, which the MPI-IO layer can merge
+  // with everybody else's. The default view is put back once they're
+  // read, for read_segment. The types can go as soon as the read has
+  // started.
+  MPI_Datatype sample_type, run_type;
+  MPI_Type_contiguous ((int) sample_size, MPI_BYTE, &sample_type);
+  MPI_Type_commit (&sample_type);
+  MPI_Type_create_hvector ((runs > 0) ? runs : 1,
+			   (runs > 0) ? run_length : 1,
+			   (MPI_Aint) (run_stride * sample_size),
+			   sample_type, &run_type);
+  MPI_Type_commit (&run_type);
+  MPI_File_set_view (infile_opened,
+		     (MPI_Offset) first_data_point * sample_size,
+		     sample_type, run_type, (char *) "native", MPI_INFO_NULL);
+  pending_view = true;
+  read_pending = true;
+#if (MPI_VERSION > 3) || ((MPI_VERSION == 3) && (MPI_SUBVERSION >= 1))
+  int read_result = MPI_File_iread_at_all (infile_opened, 0, staging, count,
+					   sample_type, &pending_read);
+#else
+  MPI_Status read_status;
+  int read_result = MPI_File_read_at_all (infile_opened, 0, staging, count,
+					  sample_type, &read_status);
+#endif
+  MPI_Type_free (&run_type);
+  MPI_Type_free (&sample_type);
+  if (read_result != MPI_SUCCESS)
+    {
+      cancel_read ();
+      throw MPIRFFTWInputException (MPIRFFTWInputException::EFIO,
+				    std::string ("couldn't read ") +
+				    to_string (runs) +
+				    std::string (" runs of ") +
+				    to_string (run_length) +
+				    std::string (" data points at data point ") +
+				    to_string (first_data_point));
+    }
+}
+
+template < typename T > void
+MPIRFFTWInput < T >::finish_read ()
+{
+  MPI_Status read_status;
+  int read_result = MPI_Wait (&pending_read, &read_status);
+  cancel_read ();
+  if (read_result != MPI_SUCCESS)
+    throw MPIRFFTWInputException (MPIRFFTWInputException::EFIO,
+				  std::string ("couldn't read ") +
+				  to_string (pending_count) +
+				  std::string (" data points at data point ") +
+				  to_string (pending_first));
+  size_t sample_size = input_type.get_size ();
+  read_seconds += MPI_Wtime () - pending_start;
+  read_bytes += (double) pending_count * sample_size;
+  if (!input_type.is_native < T > ())
+    decode (&pending_staging[0], pending_count, pending_dest, 1, 0, 0);
+}
+
+template < typename T > void
+MPIRFFTWInput < T >::tabulate (size_t length)
+{
+  if ((window.get_shape () != Window::RECTANGULAR) &&
+      (taper_table.size () != length))
+    {
+      taper_table.resize (length);
+      for (size_t ix = 0; ix < length; ix++)
+	taper_table[ix] = window.weight (ix, length);
+    }
+}
+
+template < typename T > void
+MPIRFFTWInput < T >::weigh (T * dest, size_t count, int stride,
+			    size_t window_start, size_t length)
+{
+  if (window.get_shape () == Window::RECTANGULAR)
+    return;
+
+  // Segments have their weights worked out already.
+  if (length == taper_table.size ())
+    {
+      const double *weights = &taper_table[window_start];
+      for (size_t ix = 0; ix < count; ix++)
+	dest[ix * stride] = (T) (dest[ix * stride] * weights[ix]);
+      return;
+    }
+
+  // Anything else, a whole file or a slice of it, has its weights
+  // worked out a chunk at a time as it goes, there being no point in
+  // keeping weights that are each used once.
+  double weights[WEIGHT_CHUNK];
+  for (size_t start = 0; start < count; start += WEIGHT_CHUNK)
+    {
+      size_t chunk = std::min ((size_t) WEIGHT_CHUNK, count - start);
+      window.weights (window_start + start, chunk, length, weights);
+      for (size_t ix = 0; ix < chunk; ix++)
+	dest[(start + ix) * stride] =
+	  (T) (dest[(start + ix) * stride] * weights[ix]);
+    }
+}
+
+template < typename T > void
+MPIRFFTWInput < T >::taper (T * dest, size_t count, int stride,
+			    size_t window_start, size_t length)
+{
+  if (window.get_shape () == Window::RECTANGULAR)
+    return;
+  ThreadPool::parallel_for (count, MIN_POINTS_PER_THREAD,
+			    [&] (size_t first, size_t last)
+    {
+      weigh (dest + first * stride, last - first, stride,
+	     window_start + first, length);
+    });
+}
+
+template < typename T > void
+MPIRFFTWInput < T >::pad (T * dest, size_t count, int stride)
+{
+  ThreadPool::parallel_for (count, MIN_POINTS_PER_THREAD,
+			    [&] (size_t first, size_t last)
+    {
+      for (size_t ix = first; ix < last; ix++)
+	dest[ix * stride] = 0;
+    });
+}
+
+template < typename T > void
+MPIRFFTWInput < T >::decode (const unsigned char *src, size_t count,
+			     T * dest, int stride, size_t window_start,
+			     size_t length)
+{
+  size_t sample_size = input_type.get_size ();
+  ThreadPool::parallel_for (count, MIN_POINTS_PER_THREAD,
+			    [&] (size_t first, size_t last)
+    {
+      input_type.decode (src + first * sample_size, last - first,
+			 dest + first * stride, stride);
+      if (length != 0)
+	weigh (dest + first * stride, last - first, stride,
+	       window_start + first, length);
+    });
+}
+
+template < typename T > void
+MPIRFFTWInput < T >::read_converted (size_t first_data_point, int count,
+				     T * dest, int stride,
+				     size_t dest_length, bool collective,
+				     size_t window_start, size_t length)
+{
+  size_t sample_size = input_type.get_size ();
+  size_t bytes = (size_t) count * sample_size;
+
+  // The data points take up no more room than they do once converted,
+  // so unless they're wider than T, they fit at the end of dest, and
+  // no extra memory is needed.
+  std::vector < unsigned char >spare;
+  unsigned char *staging;
+  bool in_place = (sample_size <= stride * sizeof (T)) &&
+    ((size_t) count * stride <= dest_length);
+  if (in_place)
+    staging = (unsigned char *) dest + dest_length * sizeof (T) - bytes;
+  else
+    {
+      spare.resize (bytes + 1);
+      staging = &spare[0];
+    }
+
+  // Read in the data points, as many bytes each.
+  MPI_Datatype sample_type;
+  MPI_Type_contiguous ((int) sample_size, MPI_BYTE, &sample_type);
+  MPI_Type_commit (&sample_type);
+  MPI_Status read_status;
+  double read_start = MPI_Wtime ();
+  int read_result =
+    collective ? MPI_File_read_at_all (infile_opened,
+				       (MPI_Offset) first_data_point *
+				       sample_size, staging, count,
+				       sample_type, &read_status)
+    : MPI_File_read_at (infile_opened,
+			(MPI_Offset) first_data_point * sample_size,
+			staging, count, sample_type, &read_status);
+  MPI_Type_free (&sample_type);
+  if (read_result != MPI_SUCCESS)
+    throw MPIRFFTWInputException (MPIRFFTWInputException::EFIO,
+				  std::string ("couldn't read ") +
+				  to_string (count) +
+				  std::string (" data points at data point ") +
+				  to_string (first_data_point));
+  read_seconds += MPI_Wtime () - read_start;
+  read_bytes += (double) bytes;
+
+  // Convert. Going forwards, no data point is overwritten before it is
+  // converted, but the converted data points may overlap the ones
+  // not converted yet, so they are converted a chunk at a time off
+  // a copy.
+  if (!in_place)
+    {
+      decode (staging, count, dest, stride, window_start, length);
+      return;
+    }
+  unsigned char chunk[DECODE_CHUNK * sizeof (double)];
+  for (size_t ix = 0; ix < (size_t) count; ix += DECODE_CHUNK)
+    {
+      size_t chunk_count = std::min ((size_t) DECODE_CHUNK, count - ix);
+      memcpy (chunk, staging + ix * sample_size, chunk_count * sample_size);
+      input_type.decode (chunk, chunk_count, dest + ix * stride, stride);
+      weigh (dest + ix * stride, chunk_count, stride, window_start + ix,
+	     length);
+    }
+}
+
+template < typename T > void
+MPIRFFTWInput < T >::map_data (RealFFT < T > &transform)
+{
+
+  // Map the whole file. The mapping is private, so that the file is
+  // left alone should anything write to it.
+  int fd = open (input_file_name.c_str (), O_RDONLY);
+  if (fd == -1)
+    throw MPIRFFTWInputException (MPIRFFTWInputException::EFIO,
+				  std::
+				  string ("couldn't open input data file '") +
+				  input_file_name +
+				  std::string ("' for reading"));
+  size_t bytes = total_data_points_count * input_type.get_size ();
+  double read_start = MPI_Wtime ();
+  void *mapping =
+    mmap (NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (mapping == MAP_FAILED)
+    throw MPIRFFTWInputException (MPIRFFTWInputException::EFIO,
+				  std::string ("couldn't map input data file '")
+				  + input_file_name +
+				  std::string ("' into memory"));
+  madvise (mapping, bytes, MADV_WILLNEED);
+  mapped_data = mapping;
+  mapped_length = bytes;
+
+  // Data points stored as T need no copy at all, unless the transform
+  // pads them or spreads them out. The mapping is private, so weighing
+  // them leaves the file alone.
+  if (input_type.is_native < T > () && (input_data_array == NULL) &&
+      (transform.input_stride == 1) &&
+      ((size_t) transform.how_many_to_be_read == total_data_points_count))
+    {
+      input_data_array = (T *) mapped_data;
+      taper (input_data_array, total_data_points_count, 1, 0,
+	     total_data_points_count);
+      return;
+    }
+
+  // Anything else is converted, into the input data array, if the
+  // transform has allocated it, after which the mapping isn't needed.
+  if ((input_data_array == NULL) &&
+      posix_memalign ((void **) (&input_data_array),
+		      sysconf (_SC_PAGESIZE),
+		      sizeof (T) * transform.local_data_array_length) ==
+      ENOMEM)
+    throw MPIRFFTWInputException (MPIRFFTWInputException::EMEM,
+				  std::
+				  string ("couldn't allocate input array of ")
+				  +
+				  to_string (transform.local_data_array_length)
+				  +
+				  std::
+				  string
+				  (" data points. Maybe data too big to fit in memory? Increase number of MPI nodes"));
+  size_t count = std::min ((size_t) transform.how_many_to_be_read,
+			   total_data_points_count);
+  decode ((const unsigned char *) mapped_data, count, input_data_array,
+	  transform.input_stride, 0, total_data_points_count);
+  pad (input_data_array + count * transform.input_stride,
+       transform.how_many_to_be_read - count, transform.input_stride);
+  munmap (mapped_data, mapped_length);
+  mapped_data = NULL;
+  read_seconds += MPI_Wtime () - read_start;
+  read_bytes += (double) bytes;
+}
+
+template < typename T > void
+MPIRFFTWInput < T >::get_read_rates (double &min_rate, double &mean_rate,
+			       double &max_rate, double &aggregate_rate)
+{
+  int
+    size;
+  MPI_Comm_size (MPI_COMM_WORLD, &size);
+
+  // Processes that read nothing don't count towards the per process
+  // figures. Their rate is reported as -1.
+  double
+    rate = (read_seconds > 0) ? read_bytes / read_seconds / 1e9 : -1;
+  double
+    totals[2] = { read_bytes, read_seconds }, sums[2];
+  std::vector < double >
+  rates (size);
+  MPI_Allgather (&rate, 1, MPI_DOUBLE, &rates[0], 1, MPI_DOUBLE,
+		 MPI_COMM_WORLD);
+  MPI_Allreduce (totals, sums, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce (&totals[1], &sums[1], 1, MPI_DOUBLE, MPI_MAX,
+		 MPI_COMM_WORLD);
+
+  int readers = 0;
+  min_rate = mean_rate = max_rate = 0;
+  for (int ix = 0; ix < size; ix++)
+    if (rates[ix] >= 0)
+      {
+	if ((readers == 0) || (rates[ix] < min_rate))
+	  min_rate = rates[ix];
+	if ((readers == 0) || (rates[ix] > max_rate))
+	  max_rate = rates[ix];
+	mean_rate += rates[ix];
+	readers++;
+      }
+  if (readers != 0)
+    mean_rate /= readers;
+
+  // The aggregate rate is everything read over the time taken by the
+  // slowest process.
+  aggregate_rate = (sums[1] > 0) ? sums[0] / sums[1] / 1e9 : 0;
+}
+
+// The precisions supported.
+template class MPIRFFTWInput < double >;
+#ifdef HAVE_SINGLE_PRECISION
+template class MPIRFFTWInput < float >;
+#endif
@@ -21,18 +21,26 @@
 // System includes.
 #include <mpi.h>
 #include <string>
-#include <rfftw.h>
+#include <vector>
 #include <cstddef>
 #include <cstdlib>
 
 // Local includes.
+#include "fft_backend.h"
+#include "input_type.h"
+#include "window.h"
 #include "realfft.h"
 #include "ps_generator.h"
 #include "generic_exception.h"
 
 // Forward declarations.
-class RealFFT;
-class PSGenerator;
+template < typename T > class RealFFT;
+template < typename T > class PSGenerator;
+template < typename T > class SegmentedFFT;
+template < typename T > class OutOfCoreFFT;
+template < typename T > class Spectrogram;
+template < typename T > class ZoomFFT;
+template < typename T > class ToneMonitor;
 
 class MPIRFFTWInputException:public GenericException
 {
@@ -49,7 +57,10 @@ public:
     EEMPTY,
 
     // Failure in memory allocation.
-    EMEM
+    EMEM,
+
+    // Malformed MPI-IO hints.
+    EHINTS
   } error_t;
 private:
 
@@ -72,37 +83,247 @@ public:
   }
 };
 
-class MPIRFFTWInput
+// Reads data points of type T, float or double.
+template < typename T > class MPIRFFTWInput
 {
 private:
 
   // We're friends with RealFFT.
-  friend class RealFFT;
+  friend class RealFFT < T >;
 
   // We're friends with PSGenerator.
-  friend class PSGenerator;
+  friend class PSGenerator < T >;
+
+  // We're friends with SegmentedFFT.
+  friend class SegmentedFFT < T >;
+
+  // We're friends with OutOfCoreFFT.
+  friend class OutOfCoreFFT < T >;
+
+  // We're friends with Spectrogram.
+  friend class Spectrogram < T >;
+
+  // We're friends with ZoomFFT.
+  friend class ZoomFFT < T >;
 
-  // MPI File descriptor.
+  // We're friends with ToneMonitor.
+  friend class ToneMonitor < T >;
+
+  // We're friends with JobScheduler.
+  friend class JobScheduler;
+
+  // MPI File descriptor. MPI_FILE_NULL when reading locally.
   MPI_File infile_opened;
 
+  // Is the file read by this process alone, by mapping it into memory
+  // rather than through MPI-IO? And its name, for mapping it.
+  bool local;
+  std::string input_file_name;
+
+  // The mapping of the file, if any, and its length in bytes.
+  void *mapped_data;
+  size_t mapped_length;
+
+  // How the data points are stored in the opened file.
+  InputType input_type;
+
+  // The window the data points are multiplied by as they are read,
+  // and its weights for a segment of taper_table.size () data points,
+  // worked out once for all segments of that length.
+  Window window;
+  std::vector < double >taper_table;
+
   // Total number of data points inside the opened file.
+  // A data point is read as a single T.
   // This will be the total number of points processed.
   // The output generated by RealFFT will have this many
-  // points as well.
+  // points as well, unless it pads them with zeros.
   size_t total_data_points_count;
   
   // Array to hold read-in data points.
-  fftw_real *input_data_array;
+  T *input_data_array;
+
+  // Bytes read so far by this process, and the seconds it took.
+  double read_bytes;
+  double read_seconds;
+
+  // The read started by start_segment or start_frames, if read_pending
+  // is set: its request, where it's read from, where the data points
+  // go, how many there are, the buffer they're read into if they have
+  // to be converted, whether the file view was changed for it, and
+  // when it started.
+  bool read_pending;
+  MPI_Request pending_read;
+  size_t pending_first;
+  T *pending_dest;
+  int pending_count;
+  std::vector < unsigned char >pending_staging;
+  bool pending_view;
+  double pending_start;
+
+  // The frames being read by start_frames: how many, how long, how far
+  // apart, where they go, and the span they're read as if they overlap.
+  int pending_frames;
+  int pending_frame_length;
+  int pending_frame_hop;
+  T *pending_frames_dest;
+  std::vector < T > frame_span;
+
+  // The runs being read by start_strided: how many, how long and how
+  // far apart.
+  int pending_runs;
+  int pending_run_length;
+  size_t pending_run_stride;
+
+  // Works out the weights of the window for segments of length data
+  // points, unless it's rectangular or they're worked out already.
+  void tabulate (size_t length);
+
+  // Multiplies count data points, every stride T of dest, by the
+  // weights of the window spanning length data points, the first
+  // being data point window_start of those. weigh does so by itself,
+  // taper using all the threads there are.
+  void weigh (T * dest, size_t count, int stride, size_t window_start,
+	      size_t length);
+  void taper (T * dest, size_t count, int stride, size_t window_start,
+	      size_t length);
+
+  // Zeroes count data points, every stride T of dest. These stand in
+  // for data points past the end of the file, which a padded transform
+  // reads.
+  void pad (T * dest, size_t count, int stride);
+
+  // Converts count data points from src into every stride T of dest,
+  // using all the threads there are, and unless length is 0, weighs
+  // them as they go, as by weigh. src and dest mustn't overlap.
+  void decode (const unsigned char *src, size_t count, T * dest,
+	       int stride, size_t window_start, size_t length);
+
+  // Reads count data points that aren't stored as T, starting with
+  // data point first_data_point, and converts and weighs them, as by
+  // decode, into every stride T of dest, which is dest_length T long.
+  // The data points are read into the end of dest if there's room, and
+  // into a separate buffer otherwise. collective is true if all
+  // processes read at once.
+  void read_converted (size_t first_data_point, int count, T * dest,
+		       int stride, size_t dest_length, bool collective,
+		       size_t window_start, size_t length);
+
+  // Reads runs as by read_strided, without multiplying them by the
+  // window.
+  void read_runs (size_t first_data_point, int runs, int run_length,
+		  size_t run_stride, T * dest);
+
+  // Starts reading runs as by read_runs, leaving them to be read while
+  // the caller gets on with something else, where MPI-IO can do that
+  // (MPI 3.1 and up). Must be called by every process, and followed by
+  // finish_read.
+  void start_runs (size_t first_data_point, int runs, int run_length,
+		   size_t run_stride, T * dest);
+
+  // Waits for the read started by start_runs or start_segment to
+  // finish, and converts the data points, without multiplying them by
+  // the window. Must be called by every process after start_runs.
+  void finish_read ();
+
+  // read_data for local reads. Maps the whole file into memory. Data
+  // points stored as T are transformed straight from the mapping,
+  // anything else is converted into an array of their own.
+  void map_data (RealFFT < T > &transform);
 public:
 
-  // Constructor. Takes the file name of file to read from as the parameter.
-    MPIRFFTWInput (char *file_name);
+  // Constructor. Takes the file name of file to read from as the parameter,
+  // the communicator of the processes reading it, and optionally MPI-IO
+  // hints to open the file with, as a comma separated list of key=value
+  // pairs, and how the data points are stored, if not as T. If local is
+  // set, the file is read by this process alone, without MPI-IO, and
+  // only read_data can be used. The data points are multiplied by
+  // taper as they are read, which spans the whole file for read_data
+  // and read_strided, and each segment for read_segment.
+    MPIRFFTWInput (const char *file_name, MPI_Comm comm =
+		   MPI_COMM_WORLD, const char *hints = NULL,
+		   const InputType & type = InputType (), bool local = false,
+		   const Window & taper = Window ());
 
   // Destructor.
    ~MPIRFFTWInput ();
 
   // Reads the appropriate data, given a RealFFT object which
   // knows how much and what to read.
-  void read_data (RealFFT & transform);
+  void read_data (RealFFT < T > &transform);
+
+  // Reads count contiguous data points, starting with data point
+  // first_data_point, into dest. Unlike read_data this leaves the
+  // file open, so it can be called repeatedly.
+  void read_segment (size_t first_data_point, int count, T * dest);
+
+  // Starts reading count contiguous data points, as by read_segment,
+  // but returns while they're still being read, so that they can be
+  // read while the last segment is transformed. dest must be left
+  // alone until finish_segment is called. Only a single read may be
+  // pending at a time.
+  void start_segment (size_t first_data_point, int count, T * dest);
+
+  // Waits for the segment started by start_segment to be read, and
+  // converts and multiplies it by the window.
+  void finish_segment ();
+
+  // Waits for the read started by start_segment or start_frames, if
+  // any, and throws it away, for dest to be freed. Must be called by
+  // every process if the read was started by start_frames.
+  void cancel_read ();
+
+  // Reads runs runs of run_length contiguous data points each, the
+  // first starting with data point first_data_point and each
+  // run_stride data points after the previous one, into consecutive Ts
+  // of dest. All processes read at once, so it must be called by every
+  // process, with runs possibly 0. Leaves the file open.
+  void read_strided (size_t first_data_point, int runs, int run_length,
+		     size_t run_stride, T * dest);
+
+  // Starts reading runs as by read_strided, but returns while they're
+  // still being read. dest must be left alone until finish_strided is
+  // called. Must be called by every process, and followed by
+  // finish_strided.
+  void start_strided (size_t first_data_point, int runs, int run_length,
+		      size_t run_stride, T * dest);
+
+  // Waits for the runs started by start_strided to be read, and
+  // multiplies them by the window. Must be called by every process.
+  void finish_strided ();
+
+  // Reads frames frames of length contiguous data points each, the
+  // first starting with data point first_data_point and each hop data
+  // points after the previous one, into consecutive runs of length Ts
+  // of dest, multiplying each by the window spanning a frame. Data
+  // points shared by overlapping frames are read once. All processes
+  // read at once, so it must be called by every process, with frames
+  // possibly 0. Leaves the file open.
+  void read_frames (size_t first_data_point, int frames, int length,
+		    int hop, T * dest);
+
+  // Starts reading frames as by read_frames, but returns while they're
+  // still being read, so that they can be read while the last frames
+  // are transformed. dest must be left alone until finish_frames is
+  // called. Must be called by every process, and followed by
+  // finish_frames.
+  void start_frames (size_t first_data_point, int frames, int length,
+		     int hop, T * dest);
+
+  // Waits for the frames started by start_frames to be read, and
+  // multiplies each by the window. Must be called by every process.
+  void finish_frames ();
+
+  // Returns the number of data points in the file.
+  size_t get_data_points_count () const
+  {
+    return total_data_points_count;
+  }
+
+  // Finds the read rates, in GB/s, of the slowest, average and fastest
+  // process in MPI_COMM_WORLD, and of all processes together. Must be
+  // called by every process.
+  void get_read_rates (double &min_rate, double &mean_rate,
+		       double &max_rate, double &aggregate_rate);
 };
 #endif
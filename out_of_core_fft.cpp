@@ -0,0 +1,517 @@
+// Time-stamp: <2026-10-17 14:31:47 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// System includes.
+#include <cmath>
+#include <cerrno>
+#include <algorithm>
+#include <unistd.h>
+
+// Local includes.
+#include "stl_ext.h"
+#include "phase_timer.h"
+#include "wisdom_cache.h"
+#include "thread_pool.h"
+#include "out_of_core_fft.h"
+
+// Largest number of complex numbers in a buffer, as MPI counts are ints.
+#define MAX_BUFFER_LENGTH (1 << 30)
+
+// Not worth a thread of its own for less than this many complex numbers.
+#define MIN_POINTS_PER_THREAD 16384
+
+// Creates the scratch file name, open for reading and writing by every
+// process in comm, to be deleted once closed.
+static void
+open_scratch_file (MPI_Comm comm, const std::string & name, MPI_File * file)
+{
+  if (MPI_File_open (comm, (char *) name.c_str (),
+		     MPI_MODE_RDWR | MPI_MODE_CREATE |
+		     MPI_MODE_DELETE_ON_CLOSE, MPI_INFO_NULL,
+		     file) != MPI_SUCCESS)
+    throw OutOfCoreFFTException (OutOfCoreFFTException::EFIO,
+				 std::string ("couldn't create scratch file '")
+				 + name + std::string ("'"));
+}
+
+template < typename T > OutOfCoreFFT < T >::OutOfCoreFFT (bool optimal_plan, MPIRFFTWInput < T > &input, const char *import_wisdom_file_name, const char *scratch_directory, size_t memory_budget, MPI_Comm communicator):
+friendly_input (&input), comm (communicator),
+input_block (NULL), output_block (NULL),
+columns_file (MPI_FILE_NULL), transformed_file (MPI_FILE_NULL),
+output_data_array (NULL), first_output_bin (0), output_bins_count (0),
+output_rounds (0)
+{
+
+  // Time the planning.
+  PhaseTimer timer (PhaseTimer::PLAN);
+#ifdef HAVE_FFTW3
+  column_plan = last_column_plan = row_plan = last_row_plan = NULL;
+#else
+  column_plan = row_plan = NULL;
+#endif
+  MPI_Type_contiguous (2, FFTWPrecision < T >::mpi_type (), &complex_type);
+  MPI_Type_commit (&complex_type);
+
+  // Inputs of even length are packed.
+  size_t data_points_count = (*friendly_input).total_data_points_count;
+  packed = (data_points_count % 2 == 0);
+  complex_length = packed ? data_points_count / 2 : data_points_count;
+
+  // Each process has two buffers.
+  size_t budget_length = memory_budget / (2 * sizeof (complex));
+  if (budget_length > MAX_BUFFER_LENGTH)
+    budget_length = MAX_BUFFER_LENGTH;
+
+  // Make the matrix as square as we can, with no more rows than
+  // columns. A whole row has to fit in a buffer.
+  size_t divisor = 1;
+  for (size_t candidate = 2; candidate * candidate <= complex_length;
+       candidate++)
+    if (complex_length % candidate == 0)
+      divisor = candidate;
+  if (complex_length / divisor > budget_length)
+    throw OutOfCoreFFTException (OutOfCoreFFTException::EMEM,
+				 std::string ("couldn't split the transform of ")
+				 + to_string (data_points_count) +
+				 std::string (" data points into blocks of at most ")
+				 + to_string (budget_length) +
+				 std::string (" complex numbers. Increase the memory budget"));
+  rows = (int) divisor;
+  columns = (int) (complex_length / divisor);
+  columns_per_block = (int) std::min (budget_length / rows, (size_t) columns);
+  rows_per_block = (int) std::min (budget_length / columns, (size_t) rows);
+
+  // Output bins are handed out a quarter of a buffer at a time, which
+  // leaves room for the power spectrum to be written out.
+  bins_per_round = std::max (budget_length / 4, (size_t) 1);
+  if (bins_per_round > data_points_count / 2 + 1)
+    bins_per_round = data_points_count / 2 + 1;
+
+  // No bigger buffers than needed. Page align them.
+  buffer_length =
+    std::max (std::max ((size_t) rows * columns_per_block,
+			(size_t) rows_per_block * columns), bins_per_round);
+  if ((posix_memalign ((void **) (&input_block),
+		       sysconf (_SC_PAGESIZE),
+		       sizeof (complex) * buffer_length) == ENOMEM) ||
+      (posix_memalign ((void **) (&output_block),
+		       sysconf (_SC_PAGESIZE),
+		       sizeof (complex) * buffer_length) == ENOMEM))
+    throw OutOfCoreFFTException (OutOfCoreFFTException::EMEM,
+				 std::string ("couldn't allocate buffers of ")
+				 + to_string (buffer_length) +
+				 std::string (" complex numbers. Lower the memory budget"));
+
+  // Create the scratch files, named after the primary process' id.
+  long long
+    id = getpid ();
+  MPI_Bcast (&id, 1, MPI_LONG_LONG, 0, comm);
+  std::string scratch_name =
+    std::string (scratch_directory) + std::string ("/pstool-") +
+    to_string (id);
+  open_scratch_file (comm, scratch_name + std::string ("-columns"),
+		     &columns_file);
+  open_scratch_file (comm, scratch_name + std::string ("-transformed"),
+		     &transformed_file);
+
+  // Check if we need to import wisdom. The primary process reads it
+  // for everybody.
+  if ((import_wisdom_file_name != NULL) &&
+      !WisdomCache < T >::import_file (import_wisdom_file_name, comm))
+    throw OutOfCoreFFTException (OutOfCoreFFTException::EFIO,
+				     std::string ("couldn't open input wisdom file '") +
+				     import_wisdom_file_name +
+				     std::string ("' for import"));
+
+  // Flags for plan creation.
+  int
+    plan_flags = optimal_plan ? FFTW_MEASURE : FFTW_ESTIMATE;
+
+  // Create forward one-dimensional local complex plans. The columns of
+  // a block are interleaved, and the rows of a block are transformed
+  // into interleaved columns, as they are written out.
+#ifdef HAVE_FFTW3
+  typedef typename FFTWPrecision < T >::complex fftw_complex_t;
+  fftw_complex_t *in = (fftw_complex_t *) input_block;
+  fftw_complex_t *out = (fftw_complex_t *) output_block;
+  int last_columns = columns % columns_per_block;
+  int last_rows = rows % rows_per_block;
+  column_plan = FFTWPrecision < T >::plan_many_dft (rows, columns_per_block,
+						    in, columns_per_block, 1,
+						    out, columns_per_block, 1,
+						    FFTW_FORWARD, plan_flags);
+  if (last_columns != 0)
+    last_column_plan =
+      FFTWPrecision < T >::plan_many_dft (rows, last_columns, in,
+					  last_columns, 1, out, last_columns,
+					  1, FFTW_FORWARD, plan_flags);
+  row_plan = FFTWPrecision < T >::plan_many_dft (columns, rows_per_block,
+						 in, 1, columns, out,
+						 rows_per_block, 1,
+						 FFTW_FORWARD, plan_flags);
+  if (last_rows != 0)
+    last_row_plan =
+      FFTWPrecision < T >::plan_many_dft (columns, last_rows, in, 1,
+					  columns, out, last_rows, 1,
+					  FFTW_FORWARD, plan_flags);
+  bool planned = (column_plan != NULL) && (row_plan != NULL) &&
+    ((last_columns == 0) || (last_column_plan != NULL)) &&
+    ((last_rows == 0) || (last_row_plan != NULL));
+#else
+  column_plan = fftw_create_plan (rows, FFTW_FORWARD,
+				  plan_flags | FFTW_USE_WISDOM);
+  row_plan = fftw_create_plan (columns, FFTW_FORWARD,
+			       plan_flags | FFTW_USE_WISDOM);
+  bool planned = (column_plan != NULL) && (row_plan != NULL);
+#endif
+
+  // Check if we actually created the plans.
+  if (!planned)
+    throw OutOfCoreFFTException (OutOfCoreFFTException::EPLAN,
+				 std::string ("plan creation failed :-(("));
+}
+
+template < typename T > OutOfCoreFFT < T >::~OutOfCoreFFT ()
+{
+
+  // Closing the scratch files deletes them.
+  if (columns_file != MPI_FILE_NULL)
+    MPI_File_close (&columns_file);
+  if (transformed_file != MPI_FILE_NULL)
+    MPI_File_close (&transformed_file);
+#ifdef HAVE_FFTW3
+  typename FFTWPrecision < T >::plan plans[4] =
+    { column_plan, last_column_plan, row_plan, last_row_plan };
+  for (int ix = 0; ix < 4; ix++)
+    if (plans[ix] != NULL)
+      FFTWPrecision < T >::destroy_plan (plans[ix]);
+#else
+  if (column_plan != NULL)
+    fftw_destroy_plan (column_plan);
+  if (row_plan != NULL)
+    fftw_destroy_plan (row_plan);
+#endif
+  MPI_Type_free (&complex_type);
+  free (input_block);
+  free (output_block);
+}
+
+template < typename T > void
+OutOfCoreFFT < T >::export_wisdom (const char *export_wisdom_file_name)
+{
+
+  // Time the export.
+  PhaseTimer timer (PhaseTimer::EXPORT);
+
+  // Only export if we are given a file name.
+  if (export_wisdom_file_name != NULL)
+    {
+
+      // Write the wisdom out.
+      if (!WisdomCache < T >::export_file (export_wisdom_file_name))
+	throw OutOfCoreFFTException (OutOfCoreFFTException::EFIO,
+				     std::string ("couldn't open output wisdom file '") +
+				     std::string (export_wisdom_file_name) +
+				     std::string ("' for export"));
+    }
+}
+
+template < typename T > void
+OutOfCoreFFT < T >::transfer (MPI_File file, bool write, size_t first,
+			      int runs, int run_length, size_t run_stride,
+			      complex * data)
+{
+
+  // Time the scratch file I/O.
+  PhaseTimer timer (PhaseTimer::SCRATCH_IO);
+
+  // The runs are described by the file view, so that they are read
+  // (or written) with a single collective call. Processes with nothing
+  // to do still take part.
+  MPI_Datatype run_type;
+  MPI_Type_create_hvector ((runs > 0) ? runs : 1,
+			   (runs > 0) ? run_length : 1,
+			   (MPI_Aint) (run_stride * sizeof (complex)),
+			   complex_type, &run_type);
+  MPI_Type_commit (&run_type);
+  MPI_File_set_view (file, (MPI_Offset) first * sizeof (complex),
+		     complex_type, run_type, (char *) "native",
+		     MPI_INFO_NULL);
+  int
+    count = (runs > 0) ? runs * run_length : 0;
+  MPI_Status status;
+  int
+    result = write ?
+    MPI_File_write_at_all (file, 0, data, count, complex_type, &status) :
+    MPI_File_read_at_all (file, 0, data, count, complex_type, &status);
+  MPI_Type_free (&run_type);
+  if (result != MPI_SUCCESS)
+    throw OutOfCoreFFTException (OutOfCoreFFTException::EFIO,
+				 std::string ("couldn't ") +
+				 std::string (write ? "write " : "read ") +
+				 to_string (count) +
+				 std::string (" complex numbers at ") +
+				 to_string (first) +
+				 std::string (" of a scratch file"));
+}
+
+template < typename T > void
+OutOfCoreFFT < T >::synchronize (MPI_File file)
+{
+
+  // Time the scratch file I/O.
+  PhaseTimer timer (PhaseTimer::SCRATCH_IO);
+
+  // MPI-IO only guarantees a process sees what others wrote
+  // after a sync, barrier, sync sequence.
+  MPI_File_sync (file);
+  MPI_Barrier (comm);
+  MPI_File_sync (file);
+}
+
+template < typename T > void
+OutOfCoreFFT < T >::transform_columns ()
+{
+  int
+    size,
+    rank;
+  MPI_Comm_size (comm, &size);
+  MPI_Comm_rank (comm, &rank);
+  size_t blocks = (columns + columns_per_block - 1) / columns_per_block;
+  size_t rounds = (blocks + size - 1) / size;
+  for (size_t round = 0; round < rounds; round++)
+    {
+
+      // Find our block of columns, if any are left.
+      size_t block = round * size + rank;
+      int first_column = 0, width = 0;
+      if (block < blocks)
+	{
+	  first_column = (int) block * columns_per_block;
+	  width = std::min (columns_per_block, columns - first_column);
+	}
+
+      // Read in the columns, a run of each row. Packed complex numbers
+      // are two consecutive data points. Otherwise the data points
+      // are read in first, and then spread out into complex numbers,
+      // from the back, so as not to overwrite any.
+      T *
+	data = (T *) input_block;
+      if (packed)
+	(*friendly_input).read_strided (2 * (size_t) first_column,
+					(width > 0) ? rows : 0, 2 * width,
+					2 * (size_t) columns, data);
+      else
+	{
+	  (*friendly_input).read_strided ((size_t) first_column,
+					  (width > 0) ? rows : 0, width,
+					  (size_t) columns, data);
+	  for (size_t ix = (size_t) rows * width; ix-- > 0;)
+	    {
+	      T value = data[ix];
+	      input_block[ix].re = value;
+	      input_block[ix].im = 0;
+	    }
+	}
+
+      // Transform the columns.
+      if (width > 0)
+	{
+#ifdef HAVE_FFTW3
+	  FFTWPrecision < T >::execute_dft ((width == columns_per_block) ?
+					    column_plan : last_column_plan,
+					    (typename FFTWPrecision < T >::
+					     complex *) input_block,
+					    (typename FFTWPrecision < T >::
+					     complex *) output_block);
+#else
+	  fftw (column_plan, width, (fftw_complex *) input_block, width, 1,
+		(fftw_complex *) output_block, width, 1);
+#endif
+	}
+
+      // Multiply row k1, column n2 by w^(k1 * n2), where
+      // w = exp(-2 * pi * i / M). The products are less than M,
+      // so there's no need to reduce them modulo M.
+      double
+	angle = -2 * M_PI / (double) complex_length;
+      ThreadPool::parallel_for ((size_t) rows * width, MIN_POINTS_PER_THREAD,
+				[&] (size_t first, size_t last)
+	{
+	  for (size_t ix = first; ix < last; ix++)
+	    {
+	      size_t row = ix / width, column = first_column + ix % width;
+	      double
+		phase = angle * (double) (row * column),
+		w_re = std::cos (phase),
+		w_im = std::sin (phase),
+		re = output_block[ix].re,
+		im = output_block[ix].im;
+	      output_block[ix].re = re * w_re - im * w_im;
+	      output_block[ix].im = re * w_im + im * w_re;
+	    }
+	});
+
+      // Write out the columns, in place.
+      transfer (columns_file, true, (size_t) first_column,
+		(width > 0) ? rows : 0, width, (size_t) columns,
+		output_block);
+    }
+}
+
+template < typename T > void
+OutOfCoreFFT < T >::transform_rows ()
+{
+  int
+    size,
+    rank;
+  MPI_Comm_size (comm, &size);
+  MPI_Comm_rank (comm, &rank);
+  size_t blocks = (rows + rows_per_block - 1) / rows_per_block;
+  size_t rounds = (blocks + size - 1) / size;
+  for (size_t round = 0; round < rounds; round++)
+    {
+
+      // Find our block of rows, if any are left.
+      size_t block = round * size + rank;
+      int first_row = 0, height = 0;
+      if (block < blocks)
+	{
+	  first_row = (int) block * rows_per_block;
+	  height = std::min (rows_per_block, rows - first_row);
+	}
+
+      // Read in the rows, which are contiguous.
+      transfer (columns_file, false, (size_t) first_row * columns,
+		(height > 0) ? 1 : 0, height * columns, 0, input_block);
+
+      // Transform the rows into interleaved columns. Column k2 then
+      // holds bins first_row + rows * k2 onwards.
+      if (height > 0)
+	{
+#ifdef HAVE_FFTW3
+	  FFTWPrecision < T >::execute_dft ((height == rows_per_block) ?
+					    row_plan : last_row_plan,
+					    (typename FFTWPrecision < T >::
+					     complex *) input_block,
+					    (typename FFTWPrecision < T >::
+					     complex *) output_block);
+#else
+	  fftw (row_plan, height, (fftw_complex *) input_block, 1, columns,
+		(fftw_complex *) output_block, height, 1);
+#endif
+	}
+
+      // Write out the bins, in order.
+      transfer (transformed_file, true, (size_t) first_row,
+		(height > 0) ? columns : 0, height, (size_t) rows,
+		output_block);
+    }
+}
+
+template < typename T > void
+OutOfCoreFFT < T >::do_transform ()
+{
+
+  // Time the transform.
+  PhaseTimer timer (PhaseTimer::TRANSFORM);
+  transform_columns ();
+  synchronize (columns_file);
+  transform_rows ();
+  synchronize (transformed_file);
+}
+
+template < typename T > bool
+OutOfCoreFFT < T >::next_output ()
+{
+  int
+    size,
+    rank;
+  MPI_Comm_size (comm, &size);
+  MPI_Comm_rank (comm, &rank);
+
+  // Are we out of rounds?
+  size_t data_points_count = (*friendly_input).total_data_points_count;
+  size_t bins_count = data_points_count / 2 + 1;
+  size_t blocks = (bins_count + bins_per_round - 1) / bins_per_round;
+  if (output_rounds * size >= blocks)
+    return false;
+
+  // Unpacking bins 0 and N/2 needs bin 0 of the complex DFT.
+  if (packed && (output_rounds == 0))
+    transfer (transformed_file, false, 0, 1, 1, 0, &first_complex_bin);
+
+  // Find our block of bins, if any are left.
+  size_t block = output_rounds * size + rank;
+  size_t start = 0, end = 0;
+  if (block < blocks)
+    {
+      start = block * bins_per_round;
+      end = std::min (start + bins_per_round, bins_count);
+    }
+  output_rounds++;
+
+  // Read in the bins of the complex DFT. Bin N/2 of a packed
+  // input is past its end.
+  size_t read_end = std::min (end, complex_length);
+  transfer (transformed_file, false, start, (read_end > start) ? 1 : 0,
+	    (int) (read_end - start), 0, input_block);
+  output_data_array = input_block;
+  first_output_bin = start;
+  output_bins_count = end - start;
+  if (!packed)
+    return true;
+
+  // Read in the mirror bins, M - k for k from 1 to M - 1, which come in
+  // reverse order.
+  size_t from = std::max (start, (size_t) 1), to = read_end;
+  size_t mirror_start = (from < to) ? complex_length - to + 1 : 0;
+  transfer (transformed_file, false, mirror_start, (from < to) ? 1 : 0,
+	    (from < to) ? (int) (to - from) : 0, 0, output_block);
+
+  // Unpack, as the FFTW3 RealFFT does. With Z the packed DFT, the DFT
+  // of the input is
+  // X[k] = (Z[k] + Z*[M-k]) / 2 - i * w^k * (Z[k] - Z*[M-k]) / 2,
+  // where w = exp(-2 * pi * i / N). Bins 0 and M both mirror bin 0.
+  ThreadPool::parallel_for (end - start, MIN_POINTS_PER_THREAD,
+			    [&] (size_t first, size_t last)
+    {
+      for (size_t k = start + first; k < start + last; k++)
+	{
+	  complex z = (k == complex_length) ? first_complex_bin :
+	    input_block[k - start];
+	  complex m = ((k == 0) || (k == complex_length)) ?
+	    first_complex_bin : output_block[complex_length - k - mirror_start];
+	  double
+	    even_re = ((double) z.re + m.re) / 2,
+	    even_im = ((double) z.im - m.im) / 2,
+	    odd_re = ((double) z.im + m.im) / 2,
+	    odd_im = -((double) z.re - m.re) / 2,
+	    w_re = std::cos (2 * M_PI * (double) k / (double) data_points_count),
+	    w_im = -std::sin (2 * M_PI * (double) k / (double) data_points_count);
+	  input_block[k - start].re = even_re + w_re * odd_re - w_im * odd_im;
+	  input_block[k - start].im = even_im + w_re * odd_im + w_im * odd_re;
+	}
+    });
+  return true;
+}
+
+// The precisions supported.
+template class OutOfCoreFFT < double >;
+#ifdef HAVE_SINGLE_PRECISION
+template class OutOfCoreFFT < float >;
+#endif
@@ -0,0 +1,201 @@
+// Time-stamp: <2026-10-17 13:52:08 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef OUT_OF_CORE_FFT_H
+#define OUT_OF_CORE_FFT_H
+
+// System includes.
+#include <mpi.h>
+#include <cstdio>
+#include <string>
+#include <cstddef>
+
+// Local includes.
+#include "fft_backend.h"
+#include "ps_generator.h"
+#include "mpirfftw_input.h"
+#include "generic_exception.h"
+
+// Forward declaration.
+template < typename T > class PSGenerator;
+template < typename T > class MPIRFFTWInput;
+
+class OutOfCoreFFTException:public GenericException
+{
+public:
+
+  // Error types thrown.
+  typedef enum
+  {
+
+    // File I/O error.
+    EFIO,
+
+    // Plan creation error.
+    EPLAN,
+
+    // Failure in memory allocation, or a transform that can't be
+    // split up to fit the memory budget.
+    EMEM
+  } error_t;
+private:
+
+  // Error code associated with the exception.
+    error_t error_code;
+public:
+
+  // Constructor used for creation of object.
+    OutOfCoreFFTException (error_t err,
+			   const std::
+			   string & aux_err):GenericException (aux_err),
+    error_code (err)
+  {
+  }
+
+  // Returns the error code association with the exception.
+  error_t get_error_code () const
+  {
+    return error_code;
+  }
+};
+
+// Transforms inputs too big for the combined memory of the processes,
+// by staging them through scratch files (the four-step FFT). The
+// complex DFT of length M = rows * columns is seen as a matrix of
+// rows rows and columns columns, holding data point n at row
+// n / columns, column n % columns. First each column is transformed,
+// and multiplied by twiddle factors, then each row, after which DFT
+// bin k is at row k % rows, column k / rows. Blocks of columns and
+// rows, as many as fit the memory budget, are dealt out round-robin to
+// the processes, all of which read and write at once, so that the
+// MPI-IO layer can merge their strided requests into large sequential
+// ones. As with the FFTW3 RealFFT, inputs of even length are packed
+// two data points per complex number, and inputs of odd length are
+// transformed with the imaginary parts zeroed. Data points are of
+// type T, float or double.
+template < typename T > class OutOfCoreFFT
+{
+private:
+
+  // A complex number of our precision.
+  typedef fft_complex_of < T > complex;
+
+  // We're friends with PSGenerator.
+  friend class PSGenerator < T >;
+
+  // Pointer to the class friend object.
+  MPIRFFTWInput < T > *friendly_input;
+
+  // Communicator of the processes taking part.
+  MPI_Comm comm;
+
+  // Is the input packed two data points per complex number?
+  bool packed;
+
+  // Length of the complex DFT, and the shape of the matrix.
+  size_t complex_length;
+  int rows;
+  int columns;
+
+  // Number of columns and rows transformed at a time by each process.
+  int columns_per_block;
+  int rows_per_block;
+
+  // Number of output bins handed out at a time to each process.
+  size_t bins_per_round;
+
+  // The two buffers, of buffer_length complex numbers each, that
+  // the blocks are transformed from and to.
+  size_t buffer_length;
+  complex *input_block;
+  complex *output_block;
+
+  // Scratch files, holding the columns once transformed, and then the
+  // complex DFT in order. Both are deleted once closed.
+  MPI_File columns_file;
+  MPI_File transformed_file;
+
+  // MPI type of a complex number.
+  MPI_Datatype complex_type;
+
+#ifdef HAVE_FFTW3
+
+  // Plans for a whole block of columns and of rows, and for the
+  // narrower last blocks, if any.
+  typename FFTWPrecision < T >::plan column_plan, last_column_plan;
+  typename FFTWPrecision < T >::plan row_plan, last_row_plan;
+#else
+
+  // Plans for a column and a row.
+  fftw_plan column_plan, row_plan;
+#endif
+
+  // The output bins handed out by next_output. This is
+  // output_bins_count consecutive complex DFT bins, the first being
+  // bin first_output_bin.
+  complex *output_data_array;
+  size_t first_output_bin;
+  size_t output_bins_count;
+
+  // Number of rounds of output bins handed out so far, and bin 0 of
+  // the complex DFT, which every round of a packed input may need.
+  size_t output_rounds;
+  complex first_complex_bin;
+
+  // Reads (or writes) runs runs of run_length complex numbers, each
+  // run_stride complex numbers apart, starting with complex number
+  // first of file, into (or from) data. Must be called by every process,
+  // with runs possibly 0.
+  void transfer (MPI_File file, bool write, size_t first, int runs,
+		 int run_length, size_t run_stride, complex * data);
+
+  // Makes sure everything written to file so far can be read by every
+  // process. Must be called by every process.
+  void synchronize (MPI_File file);
+
+  // Transforms the columns and then the rows. Must be called by
+  // every process.
+  void transform_columns ();
+  void transform_rows ();
+public:
+
+  // Constructor. Arguments as for RealFFT, plus the directory to keep
+  // the scratch files in, and the memory budget in bytes of each
+  // process, which has to hold a whole row or column.
+    OutOfCoreFFT (bool optimal_plan,
+		  MPIRFFTWInput < T > &input,
+		  const char *import_wisdom_file_name,
+		  const char *scratch_directory, size_t memory_budget,
+		  MPI_Comm comm = MPI_COMM_WORLD);
+
+  // Destructor. Deletes the scratch files.
+   ~OutOfCoreFFT ();
+
+  // Exports wisdom to file, as long as the file name isn't a NULL pointer.
+  void export_wisdom (const char *export_wisdom_file_name);
+
+  // Performs transform, leaving the complex DFT in a scratch file.
+  // Must be called by every process.
+  void do_transform ();
+
+  // Hands out the next round of the output bins 0 to N/2 of the
+  // transform, a block to each process, possibly none, in rank order.
+  // Returns false once all rounds are done. Must be called by every
+  // process.
+  bool next_output ();
+};
+#endif
@@ -0,0 +1,112 @@
+// Time-stamp: <2026-10-17 15:52:40 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// System includes.
+#include <cstring>
+#include <sstream>
+#include <stdint.h>
+
+// Local includes.
+#include "output_format.h"
+
+// The header of a RAW file.
+typedef struct
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint64_t data_points_count;
+  uint64_t entries_count;
+  double sample_rate;
+  double bin_width;
+  char dtype[8];
+  uint32_t columns;
+  uint32_t reserved;
+} raw_header;
+
+bool
+OutputFormat::parse (const char *name, format_t & format)
+{
+  if (strcmp (name, "csv") == 0)
+    format = CSV;
+  else if (strcmp (name, "raw") == 0)
+    format = RAW;
+  else if (strcmp (name, "npy") == 0)
+    format = NPY;
+  else
+    return false;
+  return true;
+}
+
+std::string
+OutputFormat::header (format_t format, const char *dtype,
+		      unsigned columns, size_t data_points_count,
+		      size_t rows_count, double sample_rate, double bin_width)
+{
+
+  // NumPy style byte order character.
+  const uint16_t byte_order_probe = 1;
+  std::string full_dtype =
+    std::string ((*(const char *) &byte_order_probe) ? "<" : ">") + dtype;
+
+  if (format == RAW)
+    {
+      raw_header hdr;
+      memset (&hdr, 0, sizeof (hdr));
+      memcpy (hdr.magic, "PSTOOL", 6);
+      hdr.version = 1;
+      hdr.header_size = sizeof (hdr);
+      hdr.data_points_count = data_points_count;
+      hdr.entries_count = rows_count * columns;
+      hdr.sample_rate = sample_rate;
+      hdr.bin_width = bin_width;
+      strncpy (hdr.dtype, full_dtype.c_str (), sizeof (hdr.dtype) - 1);
+      hdr.columns = columns;
+      return std::string ((const char *) &hdr, sizeof (hdr));
+    }
+
+  if (format == NPY)
+    {
+
+      // Doubles are printed exactly.
+      std::ostringstream dict;
+      dict.precision (17);
+      dict << "{'descr': '" << full_dtype
+	<< "', 'fortran_order': False, 'shape': (" << rows_count;
+      if (columns > 1)
+	dict << ", " << columns << "), }";
+      else
+	dict << ",), }";
+      dict << " # pstool data_points_count=" << data_points_count
+	<< " sample_rate=" << sample_rate << " bin_width=" << bin_width;
+
+      // Magic, version 1.0, 2 byte little endian header length, the
+      // dictionary padded with spaces and terminated by a newline,
+      // so that the data starts 64 byte aligned.
+      std::string preamble ("\x93NUMPY\x01\x00", 8);
+      size_t length = 10 + dict.str ().size () + 1;
+      size_t padded = (length + 63) / 64 * 64;
+      std::string padded_dict =
+	dict.str () + std::string (padded - length, ' ') + '\n';
+      preamble += (char) ((padded - 10) & 0xff);
+      preamble += (char) (((padded - 10) >> 8) & 0xff);
+      return preamble + padded_dict;
+    }
+
+  // CSV headers are written by whoever writes the CSV.
+  return std::string ();
+}
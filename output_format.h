@@ -0,0 +1,79 @@
+// Time-stamp: <2026-10-17 15:52:40 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef OUTPUT_FORMAT_H
+#define OUTPUT_FORMAT_H
+
+// System includes.
+#include <string>
+#include <cstddef>
+
+// Formats the power spectrum and the transform can be exported in.
+//
+// CSV is the original human readable format.
+//
+// RAW is a 64 byte header followed by the entries in native byte order.
+// The header is laid out as follows (all fields native byte order):
+//   0  char[8]  magic, "PSTOOL" followed by two '\0's
+//   8  uint32   format version, 1
+//  12  uint32   header size in bytes, 64
+//  16  uint64   number of data points transformed
+//  24  uint64   number of entries following the header
+//  32  double   sample rate in Hz
+//  40  double   width of each frequency bin in Hz
+//  48  char[8]  NumPy style type of each entry, '\0' padded, e.g. "<f8"
+//  56  uint32   number of columns of entries per row
+//  60  uint32   reserved, 0
+//
+// NPY is NumPy's .npy format (version 1.0), loadable with numpy.load,
+// or memory mappable with numpy.load(..., mmap_mode='r'). The number of
+// data points, sample rate and bin width are stored in a Python comment
+// at the end of the header dictionary, which NumPy ignores.
+//
+// In both binary formats the power spectrum is stored as one double per
+// bin (the power, with bin ix at ix times the bin width), and the
+// transform as one complex double (re, im) per output bin. Power spectra
+// with logarithmically spaced bins have no single bin width, and are
+// stored as two columns, frequency and power, with a bin width of 0.
+// Power spectra of a band, which needn't start at 0 Hz, are stored as
+// two columns too, with the width of their bins.
+// The powers of a list of tones are stored as two columns, frequency
+// and power, in the order the tones were listed, with a bin width of 0.
+// Spectrograms are stored as a row of power spectrum bins per frame.
+class OutputFormat
+{
+public:
+  typedef enum
+  {
+    CSV,
+    RAW,
+    NPY
+  } format_t;
+
+  // Parses a format name ("csv", "raw" or "npy"). Returns false
+  // if the name is not recognised.
+  static bool parse (const char *name, format_t & format);
+
+  // Returns the header for a file in a binary format. dtype is the NumPy
+  // type of each entry without the byte order, e.g. "f8" or "c16", and
+  // there are columns entries to a row.
+  static std::string header (format_t format, const char *dtype,
+			     unsigned columns, size_t data_points_count,
+			     size_t rows_count, double sample_rate,
+			     double bin_width);
+};
+#endif
@@ -0,0 +1,97 @@
+// Time-stamp: <2026-10-17 17:58:40 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// System includes.
+#include <cstring>
+
+// Local includes.
+#include "padding.h"
+
+bool
+Padding::parse (const char *spec, Padding & padding)
+{
+  if (strcmp (spec, "auto") == 0)
+    padding.policy = AUTO;
+  else if (strcmp (spec, "pow2") == 0)
+    padding.policy = POW2;
+  else if (strcmp (spec, "smooth") == 0)
+    padding.policy = SMOOTH;
+  else if (strcmp (spec, "exact") == 0)
+    padding.policy = EXACT;
+  else
+    return false;
+  return true;
+}
+
+size_t
+Padding::get_length (size_t data_points_count) const
+{
+  switch (policy)
+    {
+    case AUTO:
+      return is_fast (data_points_count) ? data_points_count :
+	next_smooth (data_points_count);
+    case POW2:
+      return next_power_of_two (data_points_count);
+    case SMOOTH:
+      return next_smooth (data_points_count);
+    default:
+      return data_points_count;
+    }
+}
+
+size_t
+Padding::next_smooth (size_t length)
+{
+
+  // Each product of powers of 3, 5 and 7 below the best length so far
+  // is doubled until it's long enough. A power of two will do to
+  // start with.
+  size_t best = next_power_of_two (length);
+  for (size_t p7 = 1; p7 < best; p7 *= 7)
+    for (size_t p5 = p7; p5 < best; p5 *= 5)
+      for (size_t p3 = p5; p3 < best; p3 *= 3)
+	{
+	  size_t candidate = p3;
+	  while (candidate < length)
+	    candidate *= 2;
+	  if (candidate < best)
+	    best = candidate;
+	}
+  return best;
+}
+
+size_t
+Padding::next_power_of_two (size_t length)
+{
+  size_t power = 1;
+  while (power < length)
+    power *= 2;
+  return power;
+}
+
+bool
+Padding::is_fast (size_t length)
+{
+  if (length == 0)
+    return true;
+  static const size_t small_primes[] = { 2, 3, 5, 7 };
+  for (size_t ix = 0; ix < sizeof (small_primes) / sizeof (size_t); ix++)
+    while (length % small_primes[ix] == 0)
+      length /= small_primes[ix];
+  return (length == 1) || (length == 11) || (length == 13);
+}
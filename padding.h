@@ -0,0 +1,89 @@
+// Time-stamp: <2026-10-17 17:58:21 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef PADDING_H
+#define PADDING_H
+
+// System includes.
+#include <cstddef>
+
+// How the length of a whole transform is chosen. FFTW is fastest for
+// lengths whose prime factors are all small, and a length with a large
+// prime factor can take many times as long as one just above it. The
+// data points can be padded with zeros up to such a length, which
+// samples the same spectrum on a finer grid of bins. Or their DFT can
+// be found at exactly their length, through Bluestein's algorithm,
+// which turns it into a convolution, done with complex DFTs of a
+// length that is fast.
+class Padding
+{
+public:
+  typedef enum
+  {
+
+    // Transform the data points as they are.
+    NONE,
+
+    // Pad only lengths FFTW isn't fast for, to the next 7-smooth length.
+    AUTO,
+
+    // Pad to the next power of two.
+    POW2,
+
+    // Pad to the next 7-smooth length, whose prime factors are all 2,
+    // 3, 5 or 7.
+    SMOOTH,
+
+    // Transform the data points as they are, with Bluestein's algorithm.
+    EXACT
+  } policy_t;
+private:
+
+  // How the length is chosen.
+  policy_t policy;
+public:
+
+  // No padding.
+  Padding ():policy (NONE)
+  {
+  }
+
+  // Parses "auto", "pow2", "smooth" or "exact". Returns false if spec
+  // isn't any of those.
+  static bool parse (const char *spec, Padding & padding);
+
+  // Returns how the length is chosen.
+  policy_t get_policy () const
+  {
+    return policy;
+  }
+
+  // Returns the length data_points_count data points are transformed
+  // as, which is also the number of bins of their DFT.
+  size_t get_length (size_t data_points_count) const;
+
+  // Returns the smallest 7-smooth length of at least length.
+  static size_t next_smooth (size_t length);
+
+  // Returns the smallest power of two of at least length.
+  static size_t next_power_of_two (size_t length);
+
+  // Is length one FFTW is fast for, with no prime factors but 2, 3, 5
+  // and 7, and at most one 11 or 13, which FFTW has special code for?
+  static bool is_fast (size_t length);
+};
+#endif
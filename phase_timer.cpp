@@ -0,0 +1,149 @@
+// Time-stamp: <2026-10-17 14:44:12 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// System includes.
+#include <cfloat>
+#include <fstream>
+#include <iomanip>
+
+// Local includes.
+#include "thread_pool.h"
+#include "phase_timer.h"
+
+double PhaseTimer::seconds[PHASES];
+bool PhaseTimer::entered[PHASES];
+std::vector < PhaseTimer::phase_t > PhaseTimer::running;
+double PhaseTimer::resumed = 0;
+
+void
+PhaseTimer::charge ()
+{
+  double now = MPI_Wtime ();
+  if (!running.empty ())
+    seconds[running.back ()] += now - resumed;
+  resumed = now;
+}
+
+PhaseTimer::PhaseTimer (phase_t phase)
+{
+  charge ();
+  running.push_back (phase);
+  entered[phase] = true;
+}
+
+PhaseTimer::~PhaseTimer ()
+{
+  charge ();
+  running.pop_back ();
+}
+
+const char *
+PhaseTimer::get_name (phase_t phase)
+{
+  static const char *names[PHASES] = {
+    "other", "open", "plan", "read", "transform", "scratch_io",
+    "power_spectrum", "export"
+  };
+  return names[phase];
+}
+
+void
+PhaseTimer::export_report (const char *file_name, MPI_Comm comm)
+{
+  int
+    rank,
+    size;
+  MPI_Comm_rank (comm, &rank);
+  MPI_Comm_size (comm, &size);
+  charge ();
+
+  // The last entry is the whole run, which every process takes part in.
+  const int entries = PHASES + 1;
+  double own[entries], lowest[entries], total[entries];
+  int participants[entries], participating[entries];
+  struct
+  {
+    double seconds;
+    int rank;
+  } own_slowest[entries], slowest[entries];
+  own[PHASES] = 0;
+  for (int ix = 0; ix < PHASES; ix++)
+    {
+      own[ix] = seconds[ix];
+      own[PHASES] += seconds[ix];
+    }
+  for (int ix = 0; ix < entries; ix++)
+    {
+      participating[ix] = (ix == PHASES) || entered[ix];
+      lowest[ix] = participating[ix] ? own[ix] : DBL_MAX;
+      own_slowest[ix].seconds = own[ix];
+      own_slowest[ix].rank = rank;
+    }
+
+  // Reduce the times, and gather them for the per process figures.
+  std::vector < double >
+  all ((rank == 0) ? (size_t) size * entries : 1);
+  MPI_Reduce (rank == 0 ? MPI_IN_PLACE : lowest, lowest, entries,
+	      MPI_DOUBLE, MPI_MIN, 0, comm);
+  MPI_Reduce (own, total, entries, MPI_DOUBLE, MPI_SUM, 0, comm);
+  MPI_Reduce (participating, participants, entries, MPI_INT, MPI_SUM, 0,
+	      comm);
+  MPI_Reduce (own_slowest, slowest, entries, MPI_DOUBLE_INT, MPI_MAXLOC, 0,
+	      comm);
+  MPI_Gather (own, entries, MPI_DOUBLE, &all[0], entries, MPI_DOUBLE, 0,
+	      comm);
+  if (rank != 0)
+    return;
+
+  // Write out the phases anybody entered.
+  std::ofstream report (file_name);
+  if (!report)
+    throw PhaseTimerException (PhaseTimerException::EFIO,
+			       std::string ("couldn't open timings file '") +
+			       std::string (file_name) +
+			       std::string ("' for writing"));
+  report << std::setprecision (9)
+    << "{" << std::endl
+    << "  \"processes\": " << size << "," << std::endl
+    << "  \"threads\": " << ThreadPool::get_threads () << "," << std::endl
+    << "  \"phases\": [";
+  bool first = true;
+  for (int ix = 0; ix < entries; ix++)
+    {
+      if (participants[ix] == 0)
+	continue;
+      report << (first ? "" : ",") << std::endl
+	<< "    {\"name\": \""
+	<< ((ix == PHASES) ? "total" : get_name ((phase_t) ix))
+	<< "\", \"processes\": " << participants[ix]
+	<< ", \"min\": " << lowest[ix]
+	<< ", \"max\": " << slowest[ix].seconds
+	<< ", \"mean\": " << total[ix] / participants[ix]
+	<< ", \"slowest_rank\": " << slowest[ix].rank << "," << std::endl
+	<< "     \"seconds\": [";
+      for (int process = 0; process < size; process++)
+	report << ((process == 0) ? "" : ", ")
+	  << all[(size_t) process * entries + ix];
+      report << "]}";
+      first = false;
+    }
+  report << std::endl << "  ]" << std::endl << "}" << std::endl;
+  if (!report)
+    throw PhaseTimerException (PhaseTimerException::EFIO,
+			       std::string ("couldn't write timings file '") +
+			       std::string (file_name) + std::string ("'"));
+}
@@ -0,0 +1,132 @@
+// Time-stamp: <2026-10-17 14:31:47 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef PHASE_TIMER_H
+#define PHASE_TIMER_H
+
+// System includes.
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+// Local includes.
+#include "generic_exception.h"
+
+// Thrown at PhaseTimer errors.
+class PhaseTimerException:public GenericException
+{
+public:
+
+  // Error types thrown.
+  typedef enum
+  {
+
+    // File I/O error.
+    EFIO
+  } error_t;
+private:
+
+  // Error code associated with the exception.
+    error_t error_code;
+public:
+
+  // Constructor used for creation of object.
+    PhaseTimerException (error_t err,
+			 const std::
+			 string & aux_err):GenericException (aux_err),
+    error_code (err)
+  {
+  }
+
+  // Returns the error code association with the exception.
+  error_t get_error_code () const
+  {
+    return error_code;
+  }
+};
+
+// Wall-clocks the phases of a run on this process. A phase is timed for
+// as long as a PhaseTimer for it exists, and a PhaseTimer created while
+// another exists pauses the other one, so that the time of a phase
+// doesn't include the phases it's made of, and the times of all phases
+// add up to the time of the run. Only the main thread times phases.
+class PhaseTimer
+{
+public:
+  typedef enum
+  {
+
+    // Anything not in one of the other phases.
+    OTHER,
+
+    // Opening the input file.
+    OPEN,
+
+    // Importing wisdom and creating plans.
+    PLAN,
+
+    // Reading and converting input data points.
+    READ,
+
+    // Transforming.
+    TRANSFORM,
+
+    // Reading and writing scratch files.
+    SCRATCH_IO,
+
+    // Finding power spectra.
+    POWER_SPECTRUM,
+
+    // Writing out power spectra, transforms and wisdom.
+    EXPORT,
+
+    // Number of phases.
+    PHASES
+  } phase_t;
+private:
+
+  // Seconds spent in each phase so far, and whether it was entered.
+  static double seconds[PHASES];
+  static bool entered[PHASES];
+
+  // The phases being timed, innermost last, and when the innermost
+  // one last started or resumed.
+  static std::vector < phase_t > running;
+  static double resumed;
+
+  // Charges the time since the innermost phase resumed to it.
+  static void charge ();
+public:
+
+  // Starts timing phase, pausing whatever phase was being timed.
+    PhaseTimer (phase_t phase);
+
+  // Stops timing the phase, resuming whatever phase was paused.
+   ~PhaseTimer ();
+
+  // Returns the name of phase.
+  static const char *get_name (phase_t phase);
+
+  // Writes the seconds spent in each phase by each process in comm, and
+  // their minimum, maximum and mean over the processes that entered it,
+  // and the rank of the slowest, to file_name on the primary process,
+  // as JSON. The phases still being timed are charged up to now. Must
+  // be called by every process in comm.
+  static void export_report (const char *file_name,
+			     MPI_Comm comm = MPI_COMM_WORLD);
+};
+#endif
@@ -0,0 +1,121 @@
+// Time-stamp: <2026-10-17 15:52:40 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// Local includes.
+#include "power_kernel.h"
+
+// The vector kernels are only built by compilers that can target
+// instruction sets per function, for processors that have them.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(__clang__)
+#   define HAVE_VECTOR_KERNELS
+#   include <immintrin.h>
+#endif
+
+// Plain C++.
+static void
+magnitudes_squared_scalar (const fft_complex * in, size_t count,
+			   double scale, double *out)
+{
+  for (size_t ix = 0; ix < count; ix++)
+    out[ix] = scale * ((in[ix].re * in[ix].re) + (in[ix].im * in[ix].im));
+}
+
+#ifdef HAVE_VECTOR_KERNELS
+
+// AVX2, four complex numbers at a time.
+__attribute__ ((target ("avx2"))) static void
+magnitudes_squared_avx2 (const fft_complex * in, size_t count,
+			 double scale, double *out)
+{
+  const double *data = (const double *) in;
+  __m256d scales = _mm256_set1_pd (scale);
+  size_t ix = 0;
+  for (; ix + 4 <= count; ix += 4)
+    {
+
+      // Squares of re0, im0, re1, im1 and of re2, im2, re3, im3.
+      __m256d first = _mm256_loadu_pd (data + 2 * ix);
+      __m256d second = _mm256_loadu_pd (data + 2 * ix + 4);
+      first = _mm256_mul_pd (first, first);
+      second = _mm256_mul_pd (second, second);
+
+      // The pairwise sums come out in the order 0, 2, 1, 3.
+      __m256d sums = _mm256_hadd_pd (first, second);
+      sums = _mm256_permute4x64_pd (sums, 0xd8);
+      _mm256_storeu_pd (out + ix, _mm256_mul_pd (sums, scales));
+    }
+  magnitudes_squared_scalar (in + ix, count - ix, scale, out + ix);
+}
+
+// AVX-512, eight complex numbers at a time. AVX-512 brings fused
+// multiply-adds along, which the compiler mustn't use either here or
+// in the scalar loop once inlined, so that results don't depend on
+// which of the two does a number.
+__attribute__ ((target ("avx512f"), optimize ("fp-contract=off"))) static void
+magnitudes_squared_avx512 (const fft_complex * in, size_t count,
+			   double scale, double *out)
+{
+  const double *data = (const double *) in;
+  __m512d scales = _mm512_set1_pd (scale);
+
+  // Pick the real and the imaginary parts out of a pair of vectors.
+  __m512i re_index = _mm512_set_epi64 (14, 12, 10, 8, 6, 4, 2, 0);
+  __m512i im_index = _mm512_set_epi64 (15, 13, 11, 9, 7, 5, 3, 1);
+  size_t ix = 0;
+  for (; ix + 8 <= count; ix += 8)
+    {
+      __m512d first = _mm512_loadu_pd (data + 2 * ix);
+      __m512d second = _mm512_loadu_pd (data + 2 * ix + 8);
+      __m512d re = _mm512_permutex2var_pd (first, re_index, second);
+      __m512d im = _mm512_permutex2var_pd (first, im_index, second);
+      __m512d sums = _mm512_add_pd (_mm512_mul_pd (re, re),
+				    _mm512_mul_pd (im, im));
+      _mm512_storeu_pd (out + ix, _mm512_mul_pd (sums, scales));
+    }
+  magnitudes_squared_scalar (in + ix, count - ix, scale, out + ix);
+}
+#endif
+
+PowerKernel::kernel_t
+PowerKernel::pick ()
+{
+
+  // Use the widest vectors around. This runs before main, when
+  // __builtin_cpu_supports needs __builtin_cpu_init called first.
+#ifdef HAVE_VECTOR_KERNELS
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx512f"))
+    return magnitudes_squared_avx512;
+  else if (__builtin_cpu_supports ("avx2"))
+    return magnitudes_squared_avx2;
+#endif
+  return magnitudes_squared_scalar;
+}
+
+// Picked once, as the program starts, before any thread calls it.
+PowerKernel::kernel_t PowerKernel::kernel = PowerKernel::pick ();
+
+void
+PowerKernel::magnitudes_squared (const fft_complex_of < float >*in,
+				 size_t count, double scale, double *out)
+{
+
+  // Simple enough for the compiler to vectorize.
+  for (size_t ix = 0; ix < count; ix++)
+    out[ix] = scale * (((double) in[ix].re * in[ix].re) +
+		       ((double) in[ix].im * in[ix].im));
+}
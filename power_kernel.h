@@ -0,0 +1,59 @@
+// Time-stamp: <2026-10-17 15:52:40 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef POWER_KERNEL_H
+#define POWER_KERNEL_H
+
+// System includes.
+#include <cstddef>
+
+// Local includes.
+#include "fft_backend.h"
+
+// Computes scaled magnitudes squared of complex numbers, the inner loop
+// of the power spectrum. The kernel is picked once, at run time, from
+// the fastest the processor supports: AVX-512, AVX2, or plain C++, as
+// the program starts.
+class PowerKernel
+{
+private:
+
+  // Signature of a kernel.
+  typedef void (*kernel_t) (const fft_complex * in, size_t count,
+			    double scale, double *out);
+
+  // The kernel picked.
+  static kernel_t kernel;
+
+  // Returns the fastest kernel the processor supports.
+  static kernel_t pick ();
+public:
+
+  // Sets out[ix] to scale * (in[ix].re^2 + in[ix].im^2), for ix
+  // from 0 to count - 1. Neither array need be aligned.
+  static void magnitudes_squared (const fft_complex * in, size_t count,
+				  double scale, double *out)
+  {
+    kernel (in, count, scale, out);
+  }
+
+  // Same as the above, for single precision input. The magnitudes
+  // squared are still computed in double precision.
+  static void magnitudes_squared (const fft_complex_of < float >*in,
+				  size_t count, double scale, double *out);
+};
+#endif
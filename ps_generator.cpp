@@ -16,110 +16,496 @@
 // Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 
 // System includes.
-#include <cmath>
 #include <cerrno>
-#include <climits>
+#include <cstring>
+#include <vector>
+#include <algorithm>
 #include <unistd.h>
 
 // Local includes.
 #include "stl_ext.h"
+#include "phase_timer.h"
+#include "mpi_output.h"
+#include "csv_formatter.h"
+#include "power_kernel.h"
+#include "thread_pool.h"
 #include "ps_generator.h"
 
-PSGenerator::PSGenerator (RealFFT & transform, double sample_rate)
+// Rows of CSV or two column binary output put together at a time.
+#define EXPORT_BLOCK_ROWS (1 << 20)
+
+// Not worth a thread of its own for less than this many DFT bins.
+#define MIN_BINS_PER_THREAD 65536
+
+template < typename T > size_t
+PSGenerator < T >::first_bin_from (size_t dft_bin) const
 {
 
-  // Size of power spectrum array.
-  double data_points_count =
-    (double) (*(transform.friendly_input)).total_data_points_count;
-  ps_entries_count = (size_t) (data_points_count / 2 + 1);
+  // The bins are in increasing order of their first DFT bin.
+  size_t low = 0, high = bins.get_count (data_points_count);
+  while (low < high)
+    {
+      size_t middle = low + (high - low) / 2;
+      if (bins.first_dft_bin (middle, data_points_count) < dft_bin)
+	low = middle + 1;
+      else
+	high = middle;
+    }
+  return low;
+}
+
+template < typename T > void
+PSGenerator < T >::allocate_entries ()
+{
 
   // Allocate space on heap for said array. Page align the array.
-  if (posix_memalign ((void **) (&ps_entries),
+  if (posix_memalign ((void **) (&ps_powers),
 		      sysconf (_SC_PAGESIZE),
-		      sizeof (ps_entry) * ps_entries_count) == ENOMEM)
+		      sizeof (double) * ps_entries_count) == ENOMEM)
     throw PSGeneratorException (PSGeneratorException::EMEM,
 				std::
 				string
 				("couldn't allocate power spectrum array of ")
 				+ to_string (ps_entries_count) +
 				std::string (" entries."));
+  memset (ps_powers, 0, sizeof (double) * ps_entries_count);
+}
 
-  // Find size of each bin (in Hz).
-  double bin_size = sample_rate / data_points_count;
+template < typename T > void
+PSGenerator < T >::rebin ()
+{
 
-  // Calculate power spectrum. Normalize according to Parseval's theorem.
-  // Find DC component.
-  ps_entries[0].hz = 0;
-  ps_entries[0].joules_per_hz = (transform.output_data_array[0].re *
-				 transform.output_data_array[0].re) /
-    data_points_count;
+  // The entries so far are the full spectrum.
+  double *full_powers = ps_powers;
+  size_t full_entries_count = ps_entries_count;
+  ps_entries_count = bins.get_count (data_points_count);
+  allocate_entries ();
 
-  // ix < (data_points_count / 2) rounded up.
-  for (double ix = 1; ix < (data_points_count + 1) / 2; ix++)
+  // Each bin integrates the power of a range of the full spectrum's bins.
+  // The full spectrum is split between the threads, each doing the bins
+  // that start in its part.
+  ThreadPool::parallel_for (full_entries_count, MIN_BINS_PER_THREAD,
+			    [&] (size_t first, size_t last)
     {
+      size_t end_bin = (last == full_entries_count) ? ps_entries_count :
+	first_bin_from (last);
+      for (size_t bin = (first == 0) ? 0 : first_bin_from (first);
+	   bin < end_bin; bin++)
+	{
+	  size_t end_ix = bins.first_dft_bin (bin + 1, data_points_count);
+	  for (size_t ix = bins.first_dft_bin (bin, data_points_count);
+	       ix < end_ix; ix++)
+	    ps_powers[bin] += full_powers[ix];
+	}
+    });
+  free (full_powers);
+}
 
-      ps_entries[(size_t) ix].hz = ix * bin_size;
-      ps_entries[(size_t) ix].joules_per_hz =
-	2 *
-	((transform.output_data_array[(size_t) ix].re *
-	  transform.output_data_array[(size_t) ix].re) +
-	 (transform.output_data_array[(size_t) ix].im *
-	  transform.output_data_array[(size_t) ix].im)) / data_points_count;
+template < typename T > void
+PSGenerator < T >::reduce_entries ()
+{
+
+  // Sum up the contributions of all processes on the primary process.
+  // Everybody else ends up with an empty spectrum.
+  int
+    rank;
+  MPI_Comm_rank (comm, &rank);
+  if (rank == 0)
+    MPI_Reduce (MPI_IN_PLACE, ps_powers, ps_entries_count, MPI_DOUBLE,
+		MPI_SUM, 0, comm);
+  else
+    {
+      MPI_Reduce (ps_powers, NULL, ps_entries_count, MPI_DOUBLE,
+		  MPI_SUM, 0, comm);
+      ps_entries_count = 0;
     }
-  if ((size_t) (data_points_count) % 2 == 0)
+}
+
+template < typename T > void
+PSGenerator < T >::find_powers (const fft_complex_of < T > *output,
+				size_t first_bin, size_t end_bin)
+{
+
+  // Time the power spectrum.
+  PhaseTimer timer (PhaseTimer::POWER_SPECTRUM);
+
+  // Normalize according to Parseval's theorem, and for the equivalent
+  // noise bandwidth of the window. All bins but the DC component and
+  // the Nyquist frequency (when there is one) are mirrored by a negative
+  // frequency, and count twice. The latter two have no imaginary part.
+  double scale = 2.0 / ((double) data_points_count * window_mean_square);
+
+  // In place, the power of a bin overwrites the first half (the whole,
+  // in single precision) of its output, so bins low to 2 * low - 1 are
+  // read from past where they are written, and can be done at once, by
+  // several threads, once the bins before them are done.
+  size_t count = end_bin - first_bin;
+  for (size_t low = 0, high = powers_in_place ? 1 : count; low < count;
+       low = high, high *= 2)
+    ThreadPool::parallel_for (std::min (high, count) - low,
+			      MIN_BINS_PER_THREAD,
+			      [&] (size_t first, size_t last)
+      {
+	PowerKernel::magnitudes_squared (output + low + first,
+					 last - first, scale,
+					 ps_powers + low + first);
+      });
+  if ((first_bin == 0) && (end_bin > 0))
+    ps_powers[0] /= 2;
+  if ((data_points_count % 2 == 0) &&
+      (first_bin <= data_points_count / 2) &&
+      (end_bin > data_points_count / 2))
+    ps_powers[data_points_count / 2 - first_bin] /= 2;
+}
+
+template < typename T > void
+PSGenerator < T >::add_powers (const fft_complex_of < T > *output,
+			       size_t first_bin, size_t end_bin)
+{
+
+  // The DFT bins are split between the threads, each doing the
+  // requested bins that start in its part. The magnitudes squared are
+  // found a block at a time, and normalized as by find_powers.
+  double scale = 2.0 / ((double) data_points_count * window_mean_square);
+  ThreadPool::parallel_for (end_bin - first_bin, MIN_BINS_PER_THREAD,
+			    [&] (size_t first, size_t last)
+    {
+      std::vector < double > block_powers (EXPORT_BLOCK_ROWS);
+      size_t last_bin = (first_bin + last == end_bin) ? ps_entries_count :
+	first_bin_from (first_bin + last);
+
+      // The first thread also does the bin DFT bin first_bin falls in,
+      // which may start before it.
+      size_t bin = first_bin_from (first_bin + first + (first == 0));
+      if ((first == 0) && (bin > 0))
+	bin--;
+      for (; bin < last_bin; bin++)
+	{
+	  size_t start_ix = bins.first_dft_bin (bin, data_points_count);
+	  size_t end_ix = bins.first_dft_bin (bin + 1, data_points_count);
+	  if (start_ix < first_bin)
+	    start_ix = first_bin;
+	  if (end_ix > end_bin)
+	    end_ix = end_bin;
+	  while (start_ix < end_ix)
+	    {
+	      size_t block = end_ix - start_ix;
+	      if (block > block_powers.size ())
+		block = block_powers.size ();
+	      PowerKernel::magnitudes_squared (output +
+					       (start_ix - first_bin), block,
+					       scale, &block_powers[0]);
+	      for (size_t ix = 0; ix < block; ix++)
+		{
+		  if ((start_ix + ix == 0) ||
+		      (2 * (start_ix + ix) == data_points_count))
+		    block_powers[ix] /= 2;
+		  ps_powers[bin] += block_powers[ix];
+		}
+	      start_ix += block;
+	    }
+	}
+    });
+}
+
+template < typename T > PSGenerator < T >::PSGenerator (RealFFT < T > &transform, double rate, const SpectrumBins & spectrum_bins):
+powers_in_place (false), first_entry (0),
+data_points_count (transform.transform_length),
+sample_rate (rate), first_frequency (0),
+window_mean_square ((*(transform.friendly_input)).window.
+		    mean_square ((*(transform.friendly_input)).
+				 total_data_points_count)),
+bins (spectrum_bins), comm (transform.comm), streamed_transform (NULL)
+{
+
+  // Time the power spectrum.
+  PhaseTimer timer (PhaseTimer::POWER_SPECTRUM);
+
+  // Zeros padding the input add nothing to its energy, and the window
+  // only spans the data points of the input, so the bins of a padded
+  // transform, more finely spaced, still add up to the same energy.
+  // The one-sided power spectrum has bins 0 to N/2. Find which of those
+  // are among the output bins we hold.
+  size_t first_bin = transform.first_output_bin;
+  size_t end_bin = transform.first_output_bin + transform.output_bins_count;
+  if (end_bin > data_points_count / 2 + 1)
+    end_bin = data_points_count / 2 + 1;
+  if (end_bin < first_bin)
+    end_bin = first_bin;
+
+  // Find size of each bin (in Hz).
+  bin_size = sample_rate / (double) data_points_count;
+
+  // Calculate power spectrum.
+  if (bins.get_spacing () == SpectrumBins::FULL)
+    {
+
+      // Size of power spectrum array. A bin's power takes up no more
+      // room than its output.
+      ps_entries_count = end_bin - first_bin;
+      first_entry = first_bin;
+      if (transform.in_place)
+	{
+	  ps_powers = (double *) transform.output_data_array;
+	  powers_in_place = true;
+	}
+      else
+	allocate_entries ();
+      find_powers (transform.output_data_array, first_bin, end_bin);
+      return;
+    }
+
+  // Rebinning. Everybody integrates the power of the bins they hold
+  // straight into the requested bins, which are then summed up.
+  ps_entries_count = bins.get_count (data_points_count);
+  allocate_entries ();
+  add_powers (transform.output_data_array, first_bin, end_bin);
+  reduce_entries ();
+}
+
+template < typename T > PSGenerator < T >::PSGenerator (SegmentedFFT < T > &transform, double rate, const SpectrumBins & spectrum_bins):
+powers_in_place (false), first_entry (0),
+data_points_count ((size_t) transform.segment_length),
+sample_rate (rate), first_frequency (0),
+window_mean_square ((*(transform.friendly_input)).window.
+		    mean_square (data_points_count)), bins (spectrum_bins),
+comm (transform.comm), streamed_transform (NULL)
+{
+
+  // Time the power spectrum.
+  PhaseTimer timer (PhaseTimer::POWER_SPECTRUM);
+
+  // Size of power spectrum array. Only as long as one segment's spectrum.
+  ps_entries_count = data_points_count / 2 + 1;
+  allocate_entries ();
+
+  // Accumulate the magnitudes squared of each of our segments. The output
+  // of rfftw is in halfcomplex order - r0, r1, ..., r(n/2), ..., i1.
+  while (transform.do_transform ())
     {
+      T *out = transform.output_data_array;
+
+      // DC component.
+      ps_powers[0] += (double) out[0] * out[0];
+
+      // ix < (data_points_count / 2) rounded up.
+      ThreadPool::parallel_for ((data_points_count + 1) / 2 - 1,
+				MIN_BINS_PER_THREAD,
+				[&] (size_t first, size_t last)
+	{
+	  for (size_t ix = first + 1; ix < last + 1; ix++)
+	    ps_powers[ix] +=
+	      2 * (((double) out[ix] * out[ix]) +
+		   ((double) out[data_points_count - ix] *
+		    out[data_points_count - ix]));
+	});
 
       // Nyquist frequency.
-      ps_entries[(size_t) (data_points_count / 2)].hz =
-	(data_points_count / 2) * bin_size;
-      ps_entries[(size_t) (data_points_count / 2)].joules_per_hz =
-	(transform.output_data_array[(size_t) (data_points_count / 2)].re *
-	 transform.output_data_array[(size_t) (data_points_count / 2)].re) /
-	data_points_count;
+      if (data_points_count % 2 == 0)
+	ps_powers[data_points_count / 2] +=
+	  (double) out[data_points_count / 2] * out[data_points_count / 2];
     }
+
+  // Rebin before summing up, so that less has to be sent around.
+  if (bins.get_spacing () != SpectrumBins::FULL)
+    rebin ();
+  reduce_entries ();
+
+  // Find size of each bin (in Hz).
+  bin_size = sample_rate / (double) data_points_count;
+
+  // Average over segments. Normalize according to Parseval's theorem,
+  // per segment, and for the equivalent noise bandwidth of the window.
+  double scale =
+    1.0 / ((double) data_points_count * (double) transform.segments_count *
+	   window_mean_square);
+  for (size_t ix = 0; ix < ps_entries_count; ix++)
+    ps_powers[ix] *= scale;
 }
 
-PSGenerator::~PSGenerator ()
+template < typename T > PSGenerator < T >::PSGenerator (OutOfCoreFFT < T > &transform, double rate, const SpectrumBins & spectrum_bins):
+ps_powers (NULL), ps_entries_count (0), powers_in_place (false),
+first_entry (0),
+data_points_count ((*(transform.friendly_input)).total_data_points_count),
+sample_rate (rate), first_frequency (0),
+window_mean_square ((*(transform.friendly_input)).window.
+		    mean_square (data_points_count)), bins (spectrum_bins),
+comm (transform.comm), streamed_transform (NULL)
 {
-  free (ps_entries);
+
+  // Time the power spectrum.
+  PhaseTimer timer (PhaseTimer::POWER_SPECTRUM);
+
+  // Find size of each bin (in Hz).
+  bin_size = sample_rate / (double) data_points_count;
+
+  // The full spectrum is as big as the input, so it's left for
+  // export_spectrum to find, a round at a time.
+  if (bins.get_spacing () == SpectrumBins::FULL)
+    {
+      streamed_transform = &transform;
+      return;
+    }
+
+  // Rebinning. Everybody integrates the power of each round of bins
+  // they are handed straight into the requested bins, which are then
+  // summed up.
+  ps_entries_count = bins.get_count (data_points_count);
+  allocate_entries ();
+  while (transform.next_output ())
+    add_powers (transform.output_data_array, transform.first_output_bin,
+		transform.first_output_bin + transform.output_bins_count);
+  reduce_entries ();
 }
 
-void
-PSGenerator::export_spectrum (const char *export_spectrum_file_name)
+template < typename T > PSGenerator < T >::PSGenerator (ZoomFFT < T > &transform):
+powers_in_place (false), first_entry (transform.first_output_bin),
+data_points_count ((*(transform.friendly_input)).total_data_points_count),
+sample_rate (transform.sample_rate), bin_size (transform.bin_size),
+first_frequency (transform.first_band_bin * transform.bin_size),
+window_mean_square ((*(transform.friendly_input)).window.
+		    mean_square (data_points_count)),
+comm (transform.comm), streamed_transform (NULL)
 {
 
+  // Time the power spectrum.
+  PhaseTimer timer (PhaseTimer::POWER_SPECTRUM);
+
+  // Normalized as the spectrum of the whole input, were it padded to
+  // the length the bins are as wide for, transform_length * decimation.
+  // Decimating divides the DFT by decimation, which takes back as much.
+  // The DC component and the Nyquist frequency count once, all other
+  // bins twice.
+  ps_entries_count = transform.output_bins_count;
+  allocate_entries ();
+  double scale = 2.0 * (double) transform.decimation /
+    ((double) transform.transform_length * window_mean_square);
+  ThreadPool::parallel_for (ps_entries_count, MIN_BINS_PER_THREAD,
+			    [&] (size_t first, size_t last)
+    {
+      PowerKernel::magnitudes_squared (transform.output_data_array + first,
+				       last - first, scale, ps_powers + first);
+    });
+  size_t first_bin = transform.first_band_bin + first_entry;
+  size_t nyquist_bin = transform.transform_length * transform.decimation / 2;
+  if ((first_bin == 0) && (ps_entries_count > 0))
+    ps_powers[0] /= 2;
+  if ((nyquist_bin >= first_bin) &&
+      (nyquist_bin < first_bin + ps_entries_count))
+    ps_powers[nyquist_bin - first_bin] /= 2;
+}
+
+template < typename T > PSGenerator < T >::~PSGenerator ()
+{
+  if (!powers_in_place)
+    free (ps_powers);
+}
+
+template < typename T > void
+PSGenerator < T >::append_entries (std::string & out,
+				   OutputFormat::format_t format)
+{
+
+  // Binary formats hold just the power of each bin, unless the bins
+  // are logarithmically spaced, or of a band.
+  if ((format != OutputFormat::CSV) && !has_frequencies ())
+    {
+      out.append ((const char *) ps_powers,
+		  sizeof (double) * ps_entries_count);
+      return;
+    }
+
+  // Put the frequencies next to the powers, a block at a time.
+  std::vector < double >
+  pairs (2 * EXPORT_BLOCK_ROWS);
+  for (size_t start = 0; start < ps_entries_count;
+       start += EXPORT_BLOCK_ROWS)
+    {
+      size_t rows = ps_entries_count - start;
+      if (rows > EXPORT_BLOCK_ROWS)
+	rows = EXPORT_BLOCK_ROWS;
+      for (size_t ix = 0; ix < rows; ix++)
+	{
+	  pairs[2 * ix] = frequency (first_entry + start + ix);
+	  pairs[2 * ix + 1] = ps_powers[start + ix];
+	}
+      if (format == OutputFormat::CSV)
+	CSVFormatter::append_rows (&pairs[0], rows, out);
+      else
+	out.append ((const char *) &pairs[0], sizeof (double) * 2 * rows);
+    }
+}
+
+template < typename T > void
+PSGenerator < T >::export_spectrum (const char *export_spectrum_file_name,
+			      OutputFormat::format_t format)
+{
+
+  // Time the export.
+  PhaseTimer timer (PhaseTimer::EXPORT);
+
   // Only export if we are given a file name.
   if (export_spectrum_file_name != NULL)
     {
-      std::ofstream fout;
-      fout.open (export_spectrum_file_name);
-      if (!fout.is_open ())
-	throw PSGeneratorException (PSGeneratorException::EFIO,
-				    std::string ("could not open '") +
-				    std::string (export_spectrum_file_name) +
-				    std::string ("' for writing"));
-
-      // Attempt writing-out data.
-      try
-      {
+      int rank;
+      MPI_Comm_rank (comm, &rank);
 
-        // Set output format.
-        // Yuck :-). Hey, at least this way I don't need to determine the
-        // precision by hand.
-        fout.setf(std::ios_base::scientific, std::ios_base::floatfield); 
-        fout.precision((int)(std::ceil(std::log10(std::pow(2.0,(double)(CHAR_BIT*sizeof(double)))))));
-    	fout << "# Hz, J" << std::endl;
-	for (size_t ix = 0; ix < ps_entries_count; ix++)
-	  fout << ps_entries[ix].hz
-	    << ", " << ps_entries[ix].joules_per_hz << std::endl;
-	fout.close ();
-      }
-      catch (std::ios::failure & err)
-      {
-	throw PSGeneratorException (PSGeneratorException::EFIO,
-				    std::string ("could not write to '") +
-				    std::string (export_spectrum_file_name) +
-				    std::string ("'"));
-      }
+      // Logarithmically spaced bins need their frequencies in binary
+      // formats too, as they don't follow from a bin width, and so do
+      // the bins of a band, which don't start at 0 Hz.
+      bool log_bins = (bins.get_spacing () == SpectrumBins::LOG);
+      std::string out;
+      if (format == OutputFormat::CSV)
+	{
+	  if (rank == 0)
+	    out = "# Hz, J\n";
+	}
+      else
+	{
+	  unsigned long long entries_count = ps_entries_count, total_entries;
+	  if (streamed_transform != NULL)
+	    total_entries = data_points_count / 2 + 1;
+	  else
+	    MPI_Allreduce (&entries_count, &total_entries, 1,
+			   MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+	  if (rank == 0)
+	    out = OutputFormat::header (format, "f8",
+					has_frequencies ()? 2 : 1,
+					data_points_count, total_entries,
+					sample_rate,
+					log_bins ? 0 : frequency (1) -
+					frequency (0));
+	}
+
+      // Everybody writes out their bins, in order.
+      MPIOutput output (export_spectrum_file_name, comm);
+      if (streamed_transform == NULL)
+	{
+	  append_entries (out, format);
+	  output.write (out);
+	  return;
+	}
+
+      // A streamed spectrum is written out a round at a time, each
+      // process holding consecutive bins, in rank order.
+      output.write (out);
+      ps_entries_count = (*streamed_transform).bins_per_round;
+      allocate_entries ();
+      while ((*streamed_transform).next_output ())
+	{
+	  first_entry = (*streamed_transform).first_output_bin;
+	  ps_entries_count = (*streamed_transform).output_bins_count;
+	  find_powers ((*streamed_transform).output_data_array, first_entry,
+		       first_entry + ps_entries_count);
+	  out.clear ();
+	  append_entries (out, format);
+	  output.write (out);
+	}
     }
 }
+
+// The precisions supported.
+template class PSGenerator < double >;
+#ifdef HAVE_SINGLE_PRECISION
+template class PSGenerator < float >;
+#endif
@@ -19,16 +19,25 @@
 #define PS_GENERATOR
 
 // System includes.
+#include <mpi.h>
 #include <string>
 #include <fstream>
 #include <cstddef>
 
 // Local includes.
 #include "realfft.h"
+#include "segmented_fft.h"
+#include "out_of_core_fft.h"
+#include "zoom_fft.h"
+#include "output_format.h"
+#include "spectrum_bins.h"
 #include "generic_exception.h"
 
 // Forward declaration.
-class RealFFT;
+template < typename T > class RealFFT;
+template < typename T > class SegmentedFFT;
+template < typename T > class OutOfCoreFFT;
+template < typename T > class ZoomFFT;
 
 // Thrown at PSGenerator errors.
 class PSGeneratorException:public GenericException
@@ -66,31 +75,127 @@ public:
   }
 };
 
-class PSGenerator
+// Finds the power spectrum of a transform of data points of type T,
+// float or double. The power spectrum itself is always kept in double
+// precision.
+template < typename T > class PSGenerator
 {
-public:
-  typedef struct
-  {
-    double hz;
-    double joules_per_hz;
-  }
-  ps_entry;
 private:
 
-  // Pointer to an array of ps_entry elements.
-    ps_entry * ps_entries;
+  // The power (in J) of each bin. Each process only holds the entries
+  // for the bins it computed. The frequencies of the bins aren't
+  // stored, but worked out from the bin layout when needed.
+  double *ps_powers;
 
   // Number of entries in the above array.
   size_t ps_entries_count;
+
+  // Is the above array the output of the transform, overwritten by
+  // the power spectrum? It isn't ours to free then.
+  bool powers_in_place;
+
+  // Index of the first of the above entries in the whole spectrum.
+  size_t first_entry;
+
+  // Number of data points each spectrum was computed from, counting
+  // any zeros they were padded with, the sample rate (in Hz) and the
+  // width of each bin (in Hz), for file headers.
+  size_t data_points_count;
+  double sample_rate;
+  double bin_size;
+
+  // Frequency (in Hz) of the first bin. Only a band has one but 0.
+  double first_frequency;
+
+  // Mean square of the window the data points were multiplied by, which
+  // the power is divided by, so that the power of broadband noise comes
+  // out the same with any window.
+  double window_mean_square;
+
+  // Layout of the bins.
+  SpectrumBins bins;
+
+  // Communicator of the processes sharing the power spectrum.
+  MPI_Comm comm;
+
+  // Out-of-core transform whose full spectrum is found a round at a
+  // time as it's written out, as it doesn't fit in memory. NULL if the
+  // whole spectrum is held in ps_powers.
+  OutOfCoreFFT < T > *streamed_transform;
+
+  // Allocates the ps_powers array, and zeroes it.
+  void allocate_entries ();
+
+  // Returns the frequency (in Hz) of entry ix of the whole spectrum.
+  double frequency (size_t ix) const
+  {
+    return first_frequency + bins.centre (ix, data_points_count) * bin_size;
+  }
+
+  // Do binary formats store the frequency of each entry next to its
+  // power? They do unless entry ix lies at ix times the bin width.
+  bool has_frequencies () const
+  {
+    return (bins.get_spacing () == SpectrumBins::LOG) ||
+      (first_frequency != 0);
+  }
+
+  // Returns the first bin that starts at or after DFT bin dft_bin.
+  size_t first_bin_from (size_t dft_bin) const;
+
+  // Replaces the full spectrum in ps_powers by one laid out as bins.
+  void rebin ();
+
+  // Sets ps_powers to the full spectrum of DFT bins first_bin up to
+  // end_bin, given their output, which ps_powers may overwrite.
+  void find_powers (const fft_complex_of < T > *output, size_t first_bin,
+		    size_t end_bin);
+
+  // Adds the power of DFT bins first_bin up to end_bin, given their
+  // output, to the bins in ps_powers.
+  void add_powers (const fft_complex_of < T > *output, size_t first_bin,
+		   size_t end_bin);
+
+  // Appends the entries in ps_powers to out, in format.
+  void append_entries (std::string & out, OutputFormat::format_t format);
+
+  // Sums up the entries of all processes in comm on its primary process.
+  // Everybody else is left with no entries.
+  void reduce_entries ();
 public:
 
-  // Computes a one-sided power spectrum.
-    PSGenerator (RealFFT & transform, double sample_rate);
+  // Computes a one-sided power spectrum. Each process computes
+  // the bins for the part of the transform output it holds. If bins
+  // asks for anything but the full spectrum, each process integrates
+  // the power of the output it holds into the requested bins, which
+  // are summed up on the primary process.
+  // The full spectrum of an in place transform overwrites its output.
+    PSGenerator (RealFFT < T > &transform, double rate,
+		 const SpectrumBins & bins = SpectrumBins ());
+
+  // Computes a one-sided power spectrum averaged over all the segments
+  // of a SegmentedFFT (Welch's method). Must be called by every process
+  // in the SegmentedFFT's communicator, as the per-process sums are
+  // reduced onto its primary process.
+    PSGenerator (SegmentedFFT < T > &transform, double rate,
+		 const SpectrumBins & bins = SpectrumBins ());
+  // Computes a one-sided power spectrum of an OutOfCoreFFT, a round
+  // of its output at a time. Must be called by every process in its
+  // communicator. A full spectrum is only found as it's exported.
+    PSGenerator (OutOfCoreFFT < T > &transform, double rate,
+		 const SpectrumBins & bins = SpectrumBins ());
+
+  // Computes a one-sided power spectrum of the band of a ZoomFFT, its
+  // bins as wide as the ZoomFFT's. Each process computes the bins of
+  // the band it holds.
+    PSGenerator (ZoomFFT < T > &transform);
    ~PSGenerator ();
 
   // Exports the power spectrum to a file, as long as the file
-  // name isn't a NULL pointer.
-  void export_spectrum (const char *export_spectrum_file_name);
+  // name isn't a NULL pointer. Must be called by every process
+  // in the communicator, as each writes out its own bins.
+  void export_spectrum (const char *export_spectrum_file_name,
+			OutputFormat::format_t format = OutputFormat::CSV);
 };
 
 #endif
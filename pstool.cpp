@@ -20,10 +20,10 @@
 #include <cstdlib>
 #include <iostream>
 #include <signal.h>
-#include <rfftw_mpi.h>
 #include <exception>
 #include <cerrno>
 #include <cmath>
+#include <climits>
 #include <unistd.h>
 #include <getopt.h>
 
@@ -38,13 +38,83 @@
 
 // Local includes.
 #include "stl_ext.h"
+#include "fft_backend.h"
 #include "realfft.h"
 #include "ps_generator.h"
+#include "segmented_fft.h"
+#include "spectrogram.h"
+#include "streaming_psd.h"
+#include "out_of_core_fft.h"
+#include "zoom_fft.h"
+#include "tone_monitor.h"
+#include "job_scheduler.h"
+#include "output_format.h"
+#include "thread_pool.h"
+#include "input_type.h"
+#include "window.h"
+#include "phase_timer.h"
+#include "wisdom_cache.h"
+#include "spectrum_bins.h"
+#include "padding.h"
+#include "band.h"
 #include "mpirfftw_input.h"
 
 // Our version.
 #define VERSION 1
 
+// Codes of options that only have a long form. Kept clear of
+// the characters used by the short options.
+enum
+{
+  OPT_FORMAT = 256,
+  OPT_BINS,
+  OPT_PRECISION,
+  OPT_INPUT_TYPE,
+  OPT_INPUT_SCALE,
+  OPT_LOCAL,
+  OPT_SCRATCH_DIR,
+  OPT_MEMORY_BUDGET,
+  OPT_IN_PLACE,
+  OPT_WINDOW,
+  OPT_TIMINGS,
+  OPT_WISDOM_DIR,
+  OPT_WISDOM_TIME_LIMIT,
+  OPT_SPECTROGRAM,
+  OPT_STREAM,
+  OPT_AVERAGE,
+  OPT_PUBLISH_EVERY,
+  OPT_PAD,
+  OPT_BAND,
+  OPT_TONES
+};
+
+// Long options.
+static const struct option long_options[] = {
+  {"format", required_argument, NULL, OPT_FORMAT},
+  {"bins", required_argument, NULL, OPT_BINS},
+  {"precision", required_argument, NULL, OPT_PRECISION},
+  {"input-type", required_argument, NULL, OPT_INPUT_TYPE},
+  {"input-scale", required_argument, NULL, OPT_INPUT_SCALE},
+  {"local", no_argument, NULL, OPT_LOCAL},
+  {"scratch-dir", required_argument, NULL, OPT_SCRATCH_DIR},
+  {"memory-budget", required_argument, NULL, OPT_MEMORY_BUDGET},
+  {"in-place", no_argument, NULL, OPT_IN_PLACE},
+  {"window", required_argument, NULL, OPT_WINDOW},
+  {"timings", required_argument, NULL, OPT_TIMINGS},
+  {"wisdom-dir", required_argument, NULL, OPT_WISDOM_DIR},
+  {"wisdom-time-limit", required_argument, NULL, OPT_WISDOM_TIME_LIMIT},
+  {"spectrogram", required_argument, NULL, OPT_SPECTROGRAM},
+  {"stream", required_argument, NULL, OPT_STREAM},
+  {"average", required_argument, NULL, OPT_AVERAGE},
+  {"publish-every", required_argument, NULL, OPT_PUBLISH_EVERY},
+  {"pad", required_argument, NULL, OPT_PAD},
+  {"band", required_argument, NULL, OPT_BAND},
+  {"tones", required_argument, NULL, OPT_TONES},
+  {"threads", required_argument, NULL, 'T'},
+  {NULL, 0, NULL, 0}
+};
+
+#ifndef HAVE_FFTW3
 void *
 fftw_complex_aligned_malloc (size_t n)
 {
@@ -55,6 +125,7 @@ fftw_complex_aligned_malloc (size_t n)
   else
     return p;
 }
+#endif
 
 void
 sig_handler(int signum)
@@ -71,6 +142,359 @@ sig_handler(int signum)
     exit (-1);
 }
 
+// What to do with a single input file, as given on the command line.
+typedef struct
+{
+  const char *input_data_file_name;
+  const char *export_spectrum_file_name;
+  const char *export_wisdom_file_name;
+  const char *import_wisdom_file_name;
+  const char *export_realfft_results_file_name;
+  const char *mpiio_hints;
+  const char *scratch_directory;
+  const char *wisdom_directory;
+  const char *tones_file_name;
+  double wisdom_time_limit;
+  size_t memory_budget;
+  InputType input_type;
+  Window window;
+  bool local;
+  bool in_place;
+  bool optimum_plan;
+  double sample_rate;
+  int segment_length;
+  int segment_overlap;
+  int frame_length;
+  int frame_hop;
+  int average_frames;
+  int publish_every;
+  OutputFormat::format_t format;
+  SpectrumBins bins;
+  Padding padding;
+  Band band;
+} spectrum_settings;
+
+template < typename T > void
+report_read_rates (MPIRFFTWInput < T > &input_data)
+{
+  double min_rate, mean_rate, max_rate, aggregate_rate;
+
+  // Everybody has to take part in this, but only the primary process
+  // in our communicator group tells.
+  input_data.get_read_rates (min_rate, mean_rate, max_rate, aggregate_rate);
+  if (MPI::COMM_WORLD.Get_rank () == 0)
+    std::cout << "Read input at " << aggregate_rate
+              << " GB/s in total, per process min/avg/max "
+              << min_rate << '/' << mean_rate << '/' << max_rate
+              << " GB/s." << std::endl;
+}
+
+// Finds the averaged power spectrum of the segments of an input file
+// of data points of type T.
+template < typename T > void
+welch_spectrum (const spectrum_settings & settings)
+{
+
+  // Create the input data object.
+  MPIRFFTWInput < T > input_data (settings.input_data_file_name,
+                                  MPI_COMM_WORLD, settings.mpiio_hints,
+                                  settings.input_type, false,
+                                  settings.window);
+
+  // Look up wisdom for the segments in the cache, if we keep one.
+  WisdomCache < T > wisdom_cache (settings.wisdom_directory, "segments",
+                                  (size_t) settings.segment_length,
+                                  settings.wisdom_time_limit);
+  wisdom_cache.import ();
+
+  // Create the segmented transform object.
+  SegmentedFFT < T > transform (settings.optimum_plan, input_data,
+                                settings.import_wisdom_file_name,
+                                settings.segment_length,
+                                settings.segment_overlap);
+
+  // Keep whatever wisdom planning added to the cache.
+  wisdom_cache.store ();
+
+  // Transform all segments and find the averaged power spectrum.
+  // Every process takes part in this.
+  PSGenerator < T > power_spectrum (transform, settings.sample_rate,
+                                    settings.bins);
+  report_read_rates (input_data);
+
+  // Write out power spectrum to disk. Only the primary process
+  // has the averaged spectrum, but everybody takes part in this.
+  power_spectrum.export_spectrum (settings.export_spectrum_file_name,
+                                  settings.format);
+
+  // Save wisdom if we need to.
+  if (MPI::COMM_WORLD.Get_rank () == 0)
+    transform.export_wisdom (settings.export_wisdom_file_name);
+}
+
+// Finds the power spectra of the frames of an input file of data
+// points of type T, and writes them out as a spectrogram.
+template < typename T > void
+spectrogram_spectrum (const spectrum_settings & settings)
+{
+
+  // Create the input data object.
+  MPIRFFTWInput < T > input_data (settings.input_data_file_name,
+                                  MPI_COMM_WORLD, settings.mpiio_hints,
+                                  settings.input_type, false,
+                                  settings.window);
+
+  // Look up wisdom for the frames in the cache, if we keep one.
+  WisdomCache < T > wisdom_cache (settings.wisdom_directory, "frames",
+                                  (size_t) settings.frame_length,
+                                  settings.wisdom_time_limit);
+  wisdom_cache.import ();
+
+  // Create the spectrogram object, which deals out the frames.
+  Spectrogram < T > spectrogram (settings.optimum_plan, input_data,
+                                 settings.import_wisdom_file_name,
+                                 settings.frame_length, settings.frame_hop);
+
+  // Keep whatever wisdom planning added to the cache.
+  wisdom_cache.store ();
+
+  // Transform all frames, writing out each process' rows as it goes.
+  // Everybody takes part in this.
+  spectrogram.export_spectrogram (settings.export_spectrum_file_name,
+                                  settings.format, settings.sample_rate);
+  report_read_rates (input_data);
+
+  // Save wisdom if we need to.
+  if (MPI::COMM_WORLD.Get_rank () == 0)
+    spectrogram.export_wisdom (settings.export_wisdom_file_name);
+}
+
+// Keeps a running power spectrum of a stream of data points of type
+// T, publishing it as it goes.
+template < typename T > void
+stream_spectrum (const spectrum_settings & settings)
+{
+
+  // Look up wisdom for the frames in the cache, if we keep one.
+  WisdomCache < T > wisdom_cache (settings.wisdom_directory, "stream",
+                                  (size_t) settings.frame_length,
+                                  settings.wisdom_time_limit);
+  wisdom_cache.import ();
+
+  // Create the streaming object. The primary process opens the stream.
+  StreamingPSD < T > stream (settings.optimum_plan,
+                             settings.input_data_file_name,
+                             settings.input_type, settings.window,
+                             settings.import_wisdom_file_name,
+                             settings.frame_length, settings.frame_hop,
+                             settings.average_frames,
+                             settings.publish_every);
+
+  // Keep whatever wisdom planning added to the cache.
+  wisdom_cache.store ();
+
+  // Average frames until the stream ends. Everybody takes part in this.
+  size_t frames_count = stream.run (settings.export_spectrum_file_name,
+                                    settings.format, settings.sample_rate);
+  if (MPI::COMM_WORLD.Get_rank () == 0)
+    std::cout << "Averaged " << frames_count << " frames of the stream."
+              << std::endl;
+
+  // Save wisdom if we need to.
+  if (MPI::COMM_WORLD.Get_rank () == 0)
+    stream.export_wisdom (settings.export_wisdom_file_name);
+}
+
+// Finds the power spectrum of an input file of data points of type T
+// over settings.band alone.
+template < typename T > void
+band_spectrum (const spectrum_settings & settings)
+{
+
+  // Create the input data object.
+  MPIRFFTWInput < T > input_data (settings.input_data_file_name,
+                                  MPI_COMM_WORLD, settings.mpiio_hints,
+                                  settings.input_type, false,
+                                  settings.window);
+
+  // Look up wisdom for the transform in the cache, if we keep one.
+  // Every band of inputs of a length shares the cache file.
+  WisdomCache < T > wisdom_cache (settings.wisdom_directory, "band",
+                                  input_data.get_data_points_count (),
+                                  settings.wisdom_time_limit);
+  wisdom_cache.import ();
+
+  // Create the transform object, which works out how far to decimate.
+  ZoomFFT < T > transform (settings.optimum_plan, input_data,
+                           settings.import_wisdom_file_name,
+                           settings.sample_rate, settings.band);
+  if (MPI::COMM_WORLD.Get_rank () == 0)
+    std::cout << "Decimated " << input_data.get_data_points_count ()
+              << " data points by " << transform.get_decimation ()
+              << ", transforming " << transform.get_transform_length ()
+              << " into bins of " << transform.get_bin_size () << " Hz."
+              << std::endl;
+
+  // Keep whatever wisdom planning added to the cache.
+  wisdom_cache.store ();
+
+  // Execute transform. The input is read, mixed and decimated as it
+  // goes. Everybody takes part in this.
+  transform.do_transform ();
+  report_read_rates (input_data);
+
+  // Find the power spectrum of the band, and write it out to disk.
+  PSGenerator < T > power_spectrum (transform);
+  power_spectrum.export_spectrum (settings.export_spectrum_file_name,
+                                  settings.format);
+
+  // Save wisdom if we need to.
+  if (MPI::COMM_WORLD.Get_rank () == 0)
+    transform.export_wisdom (settings.export_wisdom_file_name);
+}
+
+// Finds the power of an input file of data points of type T at each of
+// the tones listed in settings.tones_file_name alone.
+template < typename T > void
+tone_spectrum (const spectrum_settings & settings)
+{
+
+  // Create the input data object.
+  MPIRFFTWInput < T > input_data (settings.input_data_file_name,
+                                  MPI_COMM_WORLD, settings.mpiio_hints,
+                                  settings.input_type, false,
+                                  settings.window);
+
+  // Read the tones. There's nothing to plan.
+  ToneMonitor < T > monitor (input_data, settings.tones_file_name,
+                             settings.sample_rate);
+  if (MPI::COMM_WORLD.Get_rank () == 0)
+    std::cout << "Monitoring " << monitor.get_tones_count ()
+              << " tones." << std::endl;
+
+  // Sum up the DFT at each tone. Everybody takes part in this.
+  monitor.do_monitor ();
+  report_read_rates (input_data);
+
+  // Write out the power of each tone to disk.
+  monitor.export_powers (settings.export_spectrum_file_name,
+                         settings.format);
+}
+
+// Finds the power spectrum of an input file of data points of type T,
+// transformed as a whole. If settings.local is set, the primary process
+// maps the input file and transforms it all by itself.
+template < typename T > void
+whole_spectrum (const spectrum_settings & settings)
+{
+  if (settings.local && (MPI::COMM_WORLD.Get_rank () != 0))
+    return;
+
+  // Create the input data object.
+  MPIRFFTWInput < T > input_data (settings.input_data_file_name,
+                                  MPI_COMM_WORLD, settings.mpiio_hints,
+                                  settings.input_type, settings.local,
+                                  settings.window);
+
+  // Look up wisdom for the transform in the cache, if we keep one.
+  // Local transforms are planned by the primary process alone. Padded
+  // transforms are planned for their padded length, and Bluestein's
+  // algorithm plans transforms of its own.
+  size_t data_points_count = input_data.get_data_points_count ();
+  size_t transform_length = settings.padding.get_length (data_points_count);
+  bool chirp = (settings.padding.get_policy () == Padding::EXACT);
+  WisdomCache < T > wisdom_cache (settings.wisdom_directory,
+                                  chirp ? "chirp" : "whole",
+                                  transform_length,
+                                  settings.wisdom_time_limit,
+                                  settings.local ? MPI_COMM_SELF :
+                                  MPI_COMM_WORLD);
+  wisdom_cache.import ();
+
+  // Create the transform object. Calculate how much and what data to read.
+  RealFFT < T > transform (settings.optimum_plan, input_data,
+                           settings.import_wisdom_file_name,
+                           settings.in_place, settings.padding);
+  if ((MPI::COMM_WORLD.Get_rank () == 0) &&
+      (transform_length != data_points_count))
+    std::cout << "Padded " << data_points_count << " data points to "
+              << transform_length << "." << std::endl;
+
+  // Keep whatever wisdom planning added to the cache.
+  wisdom_cache.store ();
+
+  // Read the appropriate data. There's nothing to report about
+  // mapping a file.
+  input_data.read_data (transform);
+  if (!settings.local)
+    report_read_rates (input_data);
+
+  // Execute transform.
+  transform.do_transform ();
+
+  // Find the power spectrum. Each process handles the bins
+  // of the transform it holds.
+  PSGenerator < T > power_spectrum (transform, settings.sample_rate,
+                                    settings.bins);
+
+  // Write out power spectrum to disk.
+  power_spectrum.export_spectrum (settings.export_spectrum_file_name,
+                                  settings.format);
+
+  // Write out the results of the transformation to disk if we need to.
+  transform.export_transformed (settings.export_realfft_results_file_name,
+                                settings.format, settings.sample_rate);
+
+  // Save wisdom if we need to. Only the primary process in our
+  // communicator group does this, as everybody has the same wisdom.
+  if (MPI::COMM_WORLD.Get_rank () == 0)
+    transform.export_wisdom (settings.export_wisdom_file_name);
+}
+
+// Finds the power spectrum of an input file of data points of type T,
+// transformed as a whole, but through scratch files in
+// settings.scratch_directory, rather than in memory.
+template < typename T > void
+out_of_core_spectrum (const spectrum_settings & settings)
+{
+
+  // Create the input data object.
+  MPIRFFTWInput < T > input_data (settings.input_data_file_name,
+                                  MPI_COMM_WORLD, settings.mpiio_hints,
+                                  settings.input_type, false,
+                                  settings.window);
+
+  // Look up wisdom for the transform in the cache, if we keep one.
+  WisdomCache < T > wisdom_cache (settings.wisdom_directory, "out-of-core",
+                                  input_data.get_data_points_count (),
+                                  settings.wisdom_time_limit);
+  wisdom_cache.import ();
+
+  // Create the transform object, and its scratch files.
+  OutOfCoreFFT < T > transform (settings.optimum_plan, input_data,
+                                settings.import_wisdom_file_name,
+                                settings.scratch_directory,
+                                settings.memory_budget);
+
+  // Keep whatever wisdom planning added to the cache.
+  wisdom_cache.store ();
+
+  // Execute transform. The input is read as it goes.
+  transform.do_transform ();
+  report_read_rates (input_data);
+
+  // Find the power spectrum, and write it out to disk. Unless it's
+  // rebinned, it's only found as it's written out.
+  PSGenerator < T > power_spectrum (transform, settings.sample_rate,
+                                    settings.bins);
+  power_spectrum.export_spectrum (settings.export_spectrum_file_name,
+                                  settings.format);
+
+  // Save wisdom if we need to.
+  if (MPI::COMM_WORLD.Get_rank () == 0)
+    transform.export_wisdom (settings.export_wisdom_file_name);
+}
+
 void exc_handler()
 {
   
@@ -193,14 +617,26 @@ main (int argc, char **argv)
   std::set_terminate((std::terminate_handler)exc_handler);
   std::set_unexpected((std::unexpected_handler)exc_handler);
 
+  // Perform MPI initialization. Neither our threads nor FFTW3's ever
+  // call MPI themselves, so funneling all MPI calls through the main
+  // thread is good enough.
+  int thread_support = MPI::Init_thread (argc, argv, MPI_THREAD_FUNNELED);
+#ifdef HAVE_FFTW3
+
+  // FFTW3 wants its threads initialized before its MPI support.
+  // Each precision is a library of its own.
+  fftw_init_threads ();
+  fftw_mpi_init ();
+  fftwf_init_threads ();
+  fftwf_mpi_init ();
+#else
+
   // Force FFTW2 to allocate memory that is fftw_complex-aligned.
   // This might result in a performance boost as reading unaligned
   // data is slow. 
   fftw_malloc_hook = &fftw_complex_aligned_malloc;
   fftw_free_hook = &free;
-
-  // Perform MPI initialization.
-  MPI::Init (argc, argv);
+#endif
 
   // We're going to set handlers for all the normal termination 
   // signals, as we want graceful shutdown. 
@@ -240,25 +676,57 @@ main (int argc, char **argv)
     std::cout << "pstool - power spectrum calculation tool." << std::endl
               << "Copyright (C) 2005 Andrey Warkentin. Licensed under GPL v2." << std::endl;
 
-  int c;
+  int c, exit_status = EXIT_SUCCESS;
+  char *strtol_end;
   opterr = 0;
   double sample_rate = 0;
+  unsigned long long memory_budget = 1 << 30; // Bytes per process out of core.
+  double wisdom_time_limit = 60; // Seconds to measure each plan for with --wisdom-dir.
+  long threads = 1,		// Threads per process.
+    segment_length = 0,		// Length of each segment in -W mode.
+    segment_overlap = 0,	// Overlap between consecutive segments in -W mode.
+    frame_length = 0,		// Length of each frame in --spectrogram mode.
+    frame_hop = 0,		// Distance between consecutive frames in --spectrogram mode.
+    average_frames = 16,	// Frames averaged over in --stream mode.
+    publish_every = 16;		// Frames between publications in --stream mode.
   bool help_flag = false,	// Show help information?
     optimum_plan = false,	// Have RealFFT create an optimal plan?
-    sample_flag = false;	// Have we been passed a sample rate for the data?
+    sample_flag = false,	// Have we been passed a sample rate for the data?
+    welch_flag = false,		// Average the spectra of overlapping segments?
+    spectrogram_flag = false,	// Write the spectrum of each frame?
+    stream_flag = false,	// Keep a running spectrum of a stream?
+    band_flag = false,		// Find the spectrum of a band alone?
+    single_precision = false,	// Transform in single precision?
+    input_type_flag = false,	// Have we been told how the input is stored?
+    local_flag = false,		// Transform on the primary process alone?
+    in_place_flag = false;	// Transform and find the spectrum in place?
   char *input_data_file_name = NULL,	      // Input data file name.
     *export_spectrum_file_name = NULL,	      // Output data file name. (used for exporting power spectrum).
     *export_wisdom_file_name = NULL,	      // File name for RealFFT wisdom export.
     *import_wisdom_file_name = NULL,	      // File name for RealFFT wisdom import.
-    *export_realfft_results_file_name = NULL; // File name for RealFFT results export.
+    *export_realfft_results_file_name = NULL, // File name for RealFFT results export.
+    *manifest_file_name = NULL,		      // File name of the job manifest.
+    *scratch_directory = NULL,		      // Directory for out-of-core scratch files.
+    *timings_file_name = NULL,		      // File name for the timing report.
+    *wisdom_directory = NULL,		      // Directory of the wisdom cache.
+    *tones_file_name = NULL,		      // File name of the tones in --tones mode.
+    *mpiio_hints = getenv ("PSTOOL_MPIIO_HINTS"); // MPI-IO hints for the input data file.
+  OutputFormat::format_t format = OutputFormat::CSV; // Format of the output files.
+  SpectrumBins bins;		// Layout of the power spectrum bins.
+  Padding padding;		// How the length of a whole transform is chosen.
+  Band band;			// Band to find the spectrum of in --band mode.
+  InputType input_type;		// How the input data points are stored.
+  Window window;		// Window the input data points are multiplied by.
 
   // Get command line parameters.
-  while ((c = getopt (argc, argv, "e:hi:o:s:t:w:")) != -1)
+  while ((c = getopt_long (argc, argv, "e:hH:i:m:o:s:t:T:w:W:",
+			   long_options, NULL)) != -1)
     switch (c)
       {
       case 'e':
 
-	// We will want to export FFTW2 wisdom to a file
+	// We will want to export wisdom to a file. There's no point in
+	// that unless the plans are measured.
 	optimum_plan = true;
 	export_wisdom_file_name = optarg;
 	break;
@@ -267,11 +735,21 @@ main (int argc, char **argv)
 	// Show help information.
 	help_flag = true;
 	break;
+      case 'H':
+
+	// Set MPI-IO hints, overriding PSTOOL_MPIIO_HINTS.
+	mpiio_hints = optarg;
+	break;
       case 'i':
 
 	// Set input data file name.
 	input_data_file_name = optarg;
 	break;
+      case 'm':
+
+	// Set job manifest file name.
+	manifest_file_name = optarg;
+	break;
       case 'o':
         
 	// Set output data file name.
@@ -307,11 +785,377 @@ main (int argc, char **argv)
 	// We will save the results produced by RealFFT::do_transform to a file.
 	export_realfft_results_file_name = optarg;
 	break;
+      case 'T':
+
+	// Parse the thread count parameter.
+	// Convert from base-10.
+	threads = std::strtol (optarg, &strtol_end, 10);
+
+	// Make sure we have non-garbage input.
+	if ((*strtol_end != '\0') || (threads < 1) || (threads > INT_MAX))
+	  {
+
+	    // No need to print this more than once.
+	    // So have the primary process in the
+	    // communicator group do it.
+	    if (MPI::COMM_WORLD.Get_rank () == 0)
+	      std::cerr << "ERROR: Invalid thread count passed." << std::endl;
+	    MPI::Finalize ();
+	    exit (-1);
+	  }
+	break;
       case 'w':
 
 	// We will want to import wisdom prior to creating our plan.
 	import_wisdom_file_name = optarg;
 	break;
+      case 'W':
+
+	// Yes, we will be averaging segments.
+	welch_flag = true;
+
+	// Parse the <segment>,<overlap> parameter.
+	// Convert from base-10.
+	segment_length = std::strtol (optarg, &strtol_end, 10);
+	if (*strtol_end == ',')
+	  segment_overlap = std::strtol (strtol_end + 1, &strtol_end, 10);
+
+	// Make sure we have non-garbage input.
+	if ((*strtol_end != '\0') ||
+	    (segment_length < 2) ||
+	    (segment_length > INT_MAX) ||
+	    (segment_overlap < 0) || (segment_overlap >= segment_length))
+	  {
+
+	    // No need to print this more than once.
+	    // So have the primary process in the
+	    // communicator group do it.
+	    if (MPI::COMM_WORLD.Get_rank () == 0)
+	      std::cerr << "ERROR: Invalid segment length or overlap passed."
+			<< std::endl;
+	    MPI::Finalize ();
+	    exit (-1);
+	  }
+	break;
+      case OPT_SPECTROGRAM:
+
+	// Yes, we will be writing a spectrogram.
+	spectrogram_flag = true;
+
+	// Parse the <window>,<hop> parameter.
+	// Convert from base-10.
+	frame_length = std::strtol (optarg, &strtol_end, 10);
+	if (*strtol_end == ',')
+	  frame_hop = std::strtol (strtol_end + 1, &strtol_end, 10);
+
+	// Make sure we have non-garbage input.
+	if ((*strtol_end != '\0') ||
+	    (frame_length < 2) || (frame_length > INT_MAX) ||
+	    (frame_hop < 1) || (frame_hop > INT_MAX))
+	  {
+
+	    // No need to print this more than once.
+	    // So have the primary process in the
+	    // communicator group do it.
+	    if (MPI::COMM_WORLD.Get_rank () == 0)
+	      std::cerr << "ERROR: Invalid spectrogram window or hop passed."
+			<< std::endl;
+	    MPI::Finalize ();
+	    exit (-1);
+	  }
+	break;
+      case OPT_STREAM:
+
+	// Yes, we will be reading a stream.
+	stream_flag = true;
+
+	// Parse the <window>,<hop> parameter.
+	// Convert from base-10.
+	frame_length = std::strtol (optarg, &strtol_end, 10);
+	if (*strtol_end == ',')
+	  frame_hop = std::strtol (strtol_end + 1, &strtol_end, 10);
+
+	// Make sure we have non-garbage input.
+	if ((*strtol_end != '\0') ||
+	    (frame_length < 2) || (frame_length > INT_MAX) ||
+	    (frame_hop < 1) || (frame_hop > INT_MAX))
+	  {
+
+	    // No need to print this more than once.
+	    // So have the primary process in the
+	    // communicator group do it.
+	    if (MPI::COMM_WORLD.Get_rank () == 0)
+	      std::cerr << "ERROR: Invalid stream window or hop passed."
+			<< std::endl;
+	    MPI::Finalize ();
+	    exit (-1);
+	  }
+	break;
+      case OPT_AVERAGE:
+
+	// Parse the number of frames to average over.
+	// Convert from base-10.
+	average_frames = std::strtol (optarg, &strtol_end, 10);
+
+	// Make sure we have non-garbage input.
+	if ((*optarg == '\0') || (*strtol_end != '\0') ||
+	    (average_frames < 1) || (average_frames > INT_MAX))
+	  {
+
+	    // No need to print this more than once.
+	    // So have the primary process in the
+	    // communicator group do it.
+	    if (MPI::COMM_WORLD.Get_rank () == 0)
+	      std::cerr << "ERROR: Invalid number of frames to average passed."
+			<< std::endl;
+	    MPI::Finalize ();
+	    exit (-1);
+	  }
+	break;
+      case OPT_PUBLISH_EVERY:
+
+	// Parse the number of frames between publications.
+	// Convert from base-10.
+	publish_every = std::strtol (optarg, &strtol_end, 10);
+
+	// Make sure we have non-garbage input.
+	if ((*optarg == '\0') || (*strtol_end != '\0') ||
+	    (publish_every < 1) || (publish_every > INT_MAX))
+	  {
+
+	    // No need to print this more than once.
+	    // So have the primary process in the
+	    // communicator group do it.
+	    if (MPI::COMM_WORLD.Get_rank () == 0)
+	      std::cerr << "ERROR: Invalid number of frames between publications passed."
+			<< std::endl;
+	    MPI::Finalize ();
+	    exit (-1);
+	  }
+	break;
+      case OPT_PAD:
+
+	// Set how the length of a whole transform is chosen.
+	if (!Padding::parse (optarg, padding))
+	  {
+
+	    // No need to print this more than once.
+	    // So have the primary process in the
+	    // communicator group do it.
+	    if (MPI::COMM_WORLD.Get_rank () == 0)
+	      std::cerr << "ERROR: Invalid padding passed." << std::endl;
+	    MPI::Finalize ();
+	    exit (-1);
+	  }
+	break;
+      case OPT_BAND:
+
+	// Yes, we will be zooming into a band.
+	band_flag = true;
+	if (!Band::parse (optarg, band))
+	  {
+
+	    // No need to print this more than once.
+	    // So have the primary process in the
+	    // communicator group do it.
+	    if (MPI::COMM_WORLD.Get_rank () == 0)
+	      std::cerr << "ERROR: Invalid band passed." << std::endl;
+	    MPI::Finalize ();
+	    exit (-1);
+	  }
+	break;
+      case OPT_TONES:
+
+	// We will be monitoring the tones listed in a file.
+	tones_file_name = optarg;
+	break;
+      case OPT_FORMAT:
+
+	// Set the output file format.
+	if (!OutputFormat::parse (optarg, format))
+	  {
+
+	    // No need to print this more than once.
+	    // So have the primary process in the
+	    // communicator group do it.
+	    if (MPI::COMM_WORLD.Get_rank () == 0)
+	      std::cerr << "ERROR: Invalid output format passed." << std::endl;
+	    MPI::Finalize ();
+	    exit (-1);
+	  }
+	break;
+      case OPT_BINS:
+
+	// Set the layout of the power spectrum bins.
+	if (!SpectrumBins::parse (optarg, bins))
+	  {
+
+	    // No need to print this more than once.
+	    // So have the primary process in the
+	    // communicator group do it.
+	    if (MPI::COMM_WORLD.Get_rank () == 0)
+	      std::cerr << "ERROR: Invalid bins passed." << std::endl;
+	    MPI::Finalize ();
+	    exit (-1);
+	  }
+	break;
+      case OPT_WINDOW:
+
+	// Set the window the input is multiplied by.
+	if (!Window::parse (optarg, window))
+	  {
+
+	    // No need to print this more than once.
+	    // So have the primary process in the
+	    // communicator group do it.
+	    if (MPI::COMM_WORLD.Get_rank () == 0)
+	      std::cerr << "ERROR: Invalid window passed." << std::endl;
+	    MPI::Finalize ();
+	    exit (-1);
+	  }
+	break;
+      case OPT_PRECISION:
+
+	// Set the precision of the input data and the transforms.
+	// Single precision needs a single precision FFTW, and FFTW2
+	// only comes in the precision it was built with.
+	if (std::string (optarg) == "double")
+	  single_precision = false;
+#ifdef HAVE_SINGLE_PRECISION
+	else if (std::string (optarg) == "single")
+	  single_precision = true;
+#endif
+	else
+	  {
+
+	    // No need to print this more than once.
+	    // So have the primary process in the
+	    // communicator group do it.
+	    if (MPI::COMM_WORLD.Get_rank () == 0)
+	      std::cerr << "ERROR: Invalid precision passed." << std::endl;
+	    MPI::Finalize ();
+	    exit (-1);
+	  }
+	break;
+      case OPT_INPUT_TYPE:
+
+	// Set how the input data points are stored.
+	input_type_flag = true;
+	if (!InputType::parse (optarg, input_type))
+	  {
+
+	    // No need to print this more than once.
+	    // So have the primary process in the
+	    // communicator group do it.
+	    if (MPI::COMM_WORLD.Get_rank () == 0)
+	      std::cerr << "ERROR: Invalid input type passed." << std::endl;
+	    MPI::Finalize ();
+	    exit (-1);
+	  }
+	break;
+      case OPT_INPUT_SCALE:
+	{
+
+	  // Parse the scale factor.
+	  char *strtod_end;
+	  double scale = std::strtod (optarg, &strtod_end);
+
+	  // Make sure we have non-garbage input.
+	  if ((*optarg == '\0') || (*strtod_end != '\0') ||
+	      !std::isfinite (scale) || (scale == 0))
+	    {
+
+	      // No need to print this more than once.
+	      // So have the primary process in the
+	      // communicator group do it.
+	      if (MPI::COMM_WORLD.Get_rank () == 0)
+		std::cerr << "ERROR: Invalid input scale passed." << std::endl;
+	      MPI::Finalize ();
+	      exit (-1);
+	    }
+	  input_type.set_scale (scale);
+	}
+	break;
+      case OPT_LOCAL:
+
+	// Have the primary process do everything.
+	local_flag = true;
+	break;
+      case OPT_IN_PLACE:
+
+	// Overwrite the input with the output, and the output with the
+	// power spectrum.
+	in_place_flag = true;
+	break;
+      case OPT_TIMINGS:
+
+	// Report how long each phase took to this file.
+	timings_file_name = optarg;
+	break;
+      case OPT_WISDOM_DIR:
+
+	// Keep measured wisdom in this directory.
+	wisdom_directory = optarg;
+	break;
+      case OPT_WISDOM_TIME_LIMIT:
+
+	// Parse the time limit.
+	wisdom_time_limit = std::strtod (optarg, &strtol_end);
+
+	// Make sure we have non-garbage input.
+	if ((*optarg == '\0') || (*strtol_end != '\0') ||
+	    !(wisdom_time_limit > 0))
+	  {
+
+	    // No need to print this more than once.
+	    // So have the primary process in the
+	    // communicator group do it.
+	    if (MPI::COMM_WORLD.Get_rank () == 0)
+	      std::cerr << "ERROR: Invalid wisdom time limit passed." << std::endl;
+	    MPI::Finalize ();
+	    exit (-1);
+	  }
+	break;
+      case OPT_SCRATCH_DIR:
+
+	// Transform out of core, through scratch files in this directory.
+	scratch_directory = optarg;
+	break;
+      case OPT_MEMORY_BUDGET:
+	{
+
+	  // Parse the memory budget, optionally followed by K, M, G or T.
+	  // Convert from base-10.
+	  memory_budget = std::strtoull (optarg, &strtol_end, 10);
+	  int shift = 0;
+	  if (*strtol_end != '\0')
+	    {
+	      std::string units ("KMGT");
+	      size_t unit = units.find (*strtol_end);
+	      if ((unit != std::string::npos) && (strtol_end[1] == '\0'))
+		{
+		  shift = 10 * (int) (unit + 1);
+		  strtol_end++;
+		}
+	    }
+
+	  // Make sure we have non-garbage input.
+	  if ((*optarg == '\0') || (*optarg == '-') ||
+	      (*strtol_end != '\0') || (memory_budget == 0) ||
+	      (memory_budget > (ULLONG_MAX >> shift)))
+	    {
+
+	      // No need to print this more than once.
+	      // So have the primary process in the
+	      // communicator group do it.
+	      if (MPI::COMM_WORLD.Get_rank () == 0)
+		std::cerr << "ERROR: Invalid memory budget passed." << std::endl;
+	      MPI::Finalize ();
+	      exit (-1);
+	    }
+	  memory_budget <<= shift;
+	}
+	break;
       default:
 
 	// Show help information if passed an unrecognised option.
@@ -321,8 +1165,93 @@ main (int argc, char **argv)
 
   // Make sure we were executed correctly. We need the input and output file names,
   // as well as the sample rate.
-  if ((input_data_file_name == NULL) ||
-      (export_spectrum_file_name == NULL) || !sample_flag)
+  // A manifest stands in for both.
+  if (manifest_file_name != NULL)
+    {
+      if ((input_data_file_name != NULL) ||
+	  (export_spectrum_file_name != NULL) || !sample_flag ||
+	  (export_realfft_results_file_name != NULL) ||
+	  (export_wisdom_file_name != NULL))
+	help_flag = true;
+    }
+  else if ((input_data_file_name == NULL) ||
+	   (export_spectrum_file_name == NULL) || !sample_flag)
+    help_flag = true;
+
+  // There is no single transform to save when averaging segments.
+  if (welch_flag && (export_realfft_results_file_name != NULL))
+    help_flag = true;
+
+  // Nor a single transform to do locally.
+  if (local_flag && (welch_flag || (manifest_file_name != NULL)))
+    help_flag = true;
+
+  // In place transforms are of a whole file in memory, through MPI
+  // plans, and don't keep their output.
+  if (in_place_flag &&
+      (welch_flag || local_flag || (scratch_directory != NULL) ||
+       (manifest_file_name != NULL) ||
+       (export_realfft_results_file_name != NULL)))
+    help_flag = true;
+
+  // Spectrograms are of overlapping frames of a single file, read
+  // through MPI-IO, and only come in binary formats.
+  if (spectrogram_flag &&
+      (welch_flag || local_flag || in_place_flag ||
+       (scratch_directory != NULL) || (manifest_file_name != NULL) ||
+       (export_realfft_results_file_name != NULL) ||
+       (bins.get_spacing () != SpectrumBins::FULL) ||
+       (format == OutputFormat::CSV)))
+    help_flag = true;
+
+  // Streams are read by the primary process alone, a frame at a time,
+  // and only ever give the running spectrum.
+  if (stream_flag &&
+      (welch_flag || spectrogram_flag || local_flag || in_place_flag ||
+       (scratch_directory != NULL) || (manifest_file_name != NULL) ||
+       (export_realfft_results_file_name != NULL) ||
+       (bins.get_spacing () != SpectrumBins::FULL)))
+    help_flag = true;
+
+  // Jobs each plan transforms of their own.
+  if ((wisdom_directory != NULL) && (manifest_file_name != NULL))
+    help_flag = true;
+
+  // Only whole transforms in memory are padded. Segments, frames and
+  // jobs are transformed at lengths of their own.
+  if ((padding.get_policy () != Padding::NONE) &&
+      (welch_flag || spectrogram_flag || stream_flag ||
+       (scratch_directory != NULL) || (manifest_file_name != NULL)))
+    help_flag = true;
+
+  // Bands are of a single file, read through MPI-IO, and have bins of
+  // their own.
+  if (band_flag &&
+      (welch_flag || spectrogram_flag || stream_flag || local_flag ||
+       in_place_flag || (scratch_directory != NULL) ||
+       (manifest_file_name != NULL) ||
+       (export_realfft_results_file_name != NULL) ||
+       (bins.get_spacing () != SpectrumBins::FULL) ||
+       (padding.get_policy () != Padding::NONE)))
+    help_flag = true;
+
+  // Tones are of a single file, read through MPI-IO, and have no
+  // transform, so there's nothing to plan or keep.
+  if ((tones_file_name != NULL) &&
+      (welch_flag || spectrogram_flag || stream_flag || band_flag ||
+       local_flag || in_place_flag || optimum_plan ||
+       (scratch_directory != NULL) || (manifest_file_name != NULL) ||
+       (wisdom_directory != NULL) || (import_wisdom_file_name != NULL) ||
+       (export_realfft_results_file_name != NULL) ||
+       (bins.get_spacing () != SpectrumBins::FULL) ||
+       (padding.get_policy () != Padding::NONE)))
+    help_flag = true;
+
+  // Out-of-core transforms are of a whole file, and only keep the
+  // power spectrum.
+  if ((scratch_directory != NULL) &&
+      (welch_flag || local_flag || (manifest_file_name != NULL) ||
+       (export_realfft_results_file_name != NULL)))
     help_flag = true;
         
   // Display usage information only if we are the primary process in our
@@ -331,53 +1260,217 @@ main (int argc, char **argv)
     {
       if (MPI::COMM_WORLD.Get_rank () == 0)
 	std::cerr << "Usage: " << argv[0] 
-                  << " [-e <file>] [-h] -i <file> -o <file> -s <sample rate> [-t <file>] [-w <file>]"  << std::endl 
-                  << "\t-e\t- Save wisdom for RFFT plan creation to <file>." <<  std::endl 
+                  << " [-e <file>] [-h] [-H <hints>] -i <file> -o <file> -s <sample rate> [-t <file>] [-T <threads>] [-w <file>] [-W <segment>,<overlap>] [--format=<format>] [--bins=<bins>] [--precision=<precision>] [--input-type=<type>] [--input-scale=<scale>] [--window=<window>] [--local] [--in-place] [--pad=<padding>] [--band=<low>:<high>[:<resolution>]] [--tones=<file>] [--scratch-dir=<dir> [--memory-budget=<bytes>]] [--wisdom-dir=<dir> [--wisdom-time-limit=<seconds>]] [--timings=<file>]"  << std::endl
+                  << "       " << argv[0]
+                  << " [-e <file>] [-h] [-H <hints>] -i <file> -o <file> -s <sample rate> --spectrogram=<window>,<hop> --format=<format> [-T <threads>] [-w <file>] [--precision=<precision>] [--input-type=<type>] [--input-scale=<scale>] [--window=<window>] [--wisdom-dir=<dir> [--wisdom-time-limit=<seconds>]] [--timings=<file>]"  << std::endl
+                  << "       " << argv[0]
+                  << " [-e <file>] [-h] -i <stream> -o <file> -s <sample rate> --stream=<window>,<hop> [--average=<frames>] [--publish-every=<frames>] [-T <threads>] [-w <file>] [--format=<format>] [--precision=<precision>] [--input-type=<type>] [--input-scale=<scale>] [--window=<window>] [--wisdom-dir=<dir> [--wisdom-time-limit=<seconds>]] [--timings=<file>]"  << std::endl
+                  << "       " << argv[0]
+                  << " [-h] -m <file> -s <sample rate> [-T <threads>] [-w <file>] [-W <segment>,<overlap>] [--format=<format>] [--bins=<bins>] [--precision=<precision>] [--input-type=<type>] [--input-scale=<scale>] [--window=<window>] [--timings=<file>]"  << std::endl 
+                  << "\t-e\t- Measure plans (FFTW_MEASURE) and save their wisdom to <file>." <<  std::endl 
                   << "\t-h\t- Show this helpful information." << std::endl 
+                  << "\t-H\t- Open input data file with MPI-IO <hints>, e.g. cb_nodes=4,cb_buffer_size=16777216." << std::endl
+                  << "\t\t  Defaults to the contents of the PSTOOL_MPIIO_HINTS environment variable." << std::endl 
                   << "\t-i\t- Set input data file name to <file>." << std::endl 
+                  << "\t-m\t- Process each '<input file> <output file>' line of manifest <file>." << std::endl
+                  << "\t\t  Each input file is transformed by a single process." << std::endl 
                   << "\t-o\t- Set output data file name to <file>." << std::endl
                   << "\t-s\t- Set sample rate of input data to <sample rate> Hz." << std::endl 
                   << "\t-t\t- Save results of RFFT to <file>." << std::endl 
-                  << "\t-w\t- Import wisdom for RFFT plan creation from <file>." << std::endl;
+                  << "\t-T\t- Use <threads> threads per process, say one process per node and a thread" << std::endl
+                  << "\t\t  per core. Threads transform (FFTW3 builds only), spread out and convert input," << std::endl
+                  << "\t\t  find power spectra and format CSV files. Also --threads=<threads>." << std::endl 
+                  << "\t-w\t- Import wisdom for RFFT plan creation from <file>." << std::endl
+                  << "\t-W\t- Average spectra of <segment> point segments overlapping by <overlap> points." << std::endl
+                  << "\t\t  Can't be combined with -t." << std::endl
+                  << "\t--format - Write output files as csv (default), raw or npy." << std::endl
+                  << "\t\t  raw and npy start with a header giving the number of data points," << std::endl
+                  << "\t\t  sample rate and bin width, followed by binary doubles." << std::endl
+                  << "\t--bins\t- Integrate the power spectrum into linear:<count> linearly or" << std::endl
+                  << "\t\t  log:<count> logarithmically spaced bins." << std::endl
+                  << "\t--precision - Read and transform input data as double (default) or" << std::endl
+                  << "\t\t  single (FFTW3 builds only) precision floating point numbers." << std::endl
+                  << "\t--input-type - Read input data points stored as i16le, i16be, i24le or i32le" << std::endl
+                  << "\t\t  integers, or f32 or f64 floating point numbers, instead of in the precision" << std::endl
+                  << "\t\t  of the transform." << std::endl
+                  << "\t--input-scale - Multiply each input data point by <scale>." << std::endl
+                  << "\t--window - Multiply the input (each segment with -W or -m) by a hann, hamming," << std::endl
+                  << "\t\t  blackman-harris, flattop or kaiser:<beta> window as it's read. The power" << std::endl
+                  << "\t\t  spectrum is corrected for the window's equivalent noise bandwidth." << std::endl
+                  << "\t--local\t- Map the input file into memory and transform it on the primary process" << std::endl
+                  << "\t\t  alone. Implied when running on a single process, unless --in-place is given." << std::endl
+                  << "\t\t  Can't be combined with -W or --in-place." << std::endl
+                  << "\t--in-place - Transform in place, and find the power spectrum in place of the" << std::endl
+                  << "\t\t  output, halving memory use. Transforms through MPI plans even on a single" << std::endl
+                  << "\t\t  process. Can't be combined with -t, -W, --local or --scratch-dir." << std::endl
+                  << "\t--pad\t- Pad the input with zeros up to a length FFTW is fast for: auto pads" << std::endl
+                  << "\t\t  only lengths with prime factors FFTW is slow for, to the next length with" << std::endl
+                  << "\t\t  none above 7, smooth always does, and pow2 pads to the next power of two." << std::endl
+                  << "\t\t  The bins get narrower to match. exact keeps the length, and finds the DFT" << std::endl
+                  << "\t\t  with Bluestein's algorithm instead, in about four times the memory." << std::endl
+                  << "\t\t  Can't be combined with -W, -m or --scratch-dir." << std::endl
+                  << "\t--band\t- Find the power spectrum from <low> to <high> Hz alone, in bins of" << std::endl
+                  << "\t\t  <resolution> Hz, or finer, if need be, to resolve the whole input. The input" << std::endl
+                  << "\t\t  is mixed down, low-pass filtered and decimated as it's read, and only what's" << std::endl
+                  << "\t\t  left is transformed. Can't be combined with -t, -W, -m, --bins, --local," << std::endl
+                  << "\t\t  --in-place, --pad or --scratch-dir." << std::endl
+                  << "\t--tones\t- Find the power at each frequency (in Hz) listed, one per line, in <file>" << std::endl
+                  << "\t\t  alone, with the Goertzel algorithm, rather than transforming the input." << std::endl
+                  << "\t\t  Can't be combined with -e, -t, -w, -W, -m, --band, --bins, --local," << std::endl
+                  << "\t\t  --in-place, --pad, --scratch-dir or --wisdom-dir." << std::endl
+                  << "\t--scratch-dir - Transform inputs too big for memory through scratch files in <dir>," << std::endl
+                  << "\t\t  twice the size of the input. Can't be combined with -t, -W or --local." << std::endl
+                  << "\t--memory-budget - Use at most about <bytes> (suffixed K, M, G or T) of memory per" << std::endl
+                  << "\t\t  process out of core. 1G by default." << std::endl
+                  << "\t--spectrogram - Write the power spectrum of every <window> point frame, each" << std::endl
+                  << "\t\t  <hop> points after the previous one, as a row of a raw or npy matrix." << std::endl
+                  << "\t--stream - Read input from <stream> as it arrives: - for standard input," << std::endl
+                  << "\t\t  unix:<path> for a UNIX domain socket, or a FIFO. Keep a running power" << std::endl
+                  << "\t\t  spectrum of every <window> point frame, each <hop> points after the previous" << std::endl
+                  << "\t\t  one, and replace the output file with it every so many frames." << std::endl
+                  << "\t--average - Give each new frame 1/<frames> of the weight of the running" << std::endl
+                  << "\t\t  spectrum. 16 by default." << std::endl
+                  << "\t--publish-every - Replace the output file every <frames> frames, and when" << std::endl
+                  << "\t\t  the stream ends. 16 by default." << std::endl
+                  << "\t--wisdom-dir - Measure plans, keeping their wisdom in <dir>, keyed by the input" << std::endl
+                  << "\t\t  length, processes, threads, FFTW version and CPUs. Only plans not yet in" << std::endl
+                  << "\t\t  <dir> are measured. Can't be combined with -m." << std::endl
+                  << "\t--wisdom-time-limit - Measure each plan for at most about <seconds> (FFTW3" << std::endl
+                  << "\t\t  builds only). 60 by default." << std::endl
+                  << "\t--timings - Write how long each process spent opening, planning, reading," << std::endl
+                  << "\t\t  transforming and so on to <file>, as JSON, with the min/max/mean over" << std::endl
+                  << "\t\t  processes and the slowest process." << std::endl;
       MPI::Finalize ();
       exit (-1);
     }
 
+  // Unless told otherwise, the input is stored in the precision of
+  // the transform.
+  if (!input_type_flag && single_precision)
+    InputType::parse ("f32", input_type);
+
+  // Threads are no use if the MPI implementation can't cope with them.
+  if ((threads > 1) && (thread_support < MPI_THREAD_FUNNELED))
+    {
+      if (MPI::COMM_WORLD.Get_rank () == 0)
+	std::cerr << "WARNING: MPI lacks thread support, using one thread per process."
+		  << std::endl;
+      threads = 1;
+    }
+
+#ifdef HAVE_FFTW3
+
+  // All plans from here on are threaded.
+  fftw_plan_with_nthreads ((int) threads);
+  fftwf_plan_with_nthreads ((int) threads);
+#endif
+
+  // Everything else is done by a pool of threads.
+  ThreadPool::set_threads ((int) threads);
+
   try
   {
 
-    // Create the input data object.
-    MPIRFFTWInput input_data (input_data_file_name);
+    // Whatever isn't timed by anything else is timed as part of main.
+    PhaseTimer timer (PhaseTimer::OTHER);
 
-    // Create the transform object. Calculate how much and what data to read.
-    RealFFT transform (optimum_plan, input_data, import_wisdom_file_name);
+    // Working through a manifest is a different beast altogether.
+    if (manifest_file_name != NULL)
+      {
 
-    // Read the appropriate data.
-    input_data.read_data (transform);
+        // Read the manifest.
+        JobScheduler scheduler (manifest_file_name, optimum_plan,
+                                import_wisdom_file_name, sample_rate,
+                                (int) segment_length, (int) segment_overlap,
+                                format, bins, single_precision,
+                                input_type, window);
 
-    // Execute transform.
-    transform.do_transform ();
-    
-    // Only find the power spectrum, write it out, write out the results of the
-    // transformation and save the FFTW2 wisdom if we are the primary
-    // process in our communicator group, since we are the only process with
-    // the actual results of the transformation, the computed spectrum and
-    // the wisdom.
-    if (MPI::COMM_WORLD.Get_rank () == 0)
+        // Do all the jobs. Only the primary process knows how many failed.
+        size_t jobs_failed = scheduler.run ();
+        if (jobs_failed != 0)
+          {
+            std::cerr << "ERROR: " << jobs_failed << " job(s) failed."
+                      << std::endl;
+            exit_status = EXIT_FAILURE;
+          }
+      }
+    else
       {
 
-	// Find the power spectrum.
-	PSGenerator power_spectrum (transform, sample_rate);
-
-	// Write out power spectrum to disk.
-	power_spectrum.export_spectrum (export_spectrum_file_name);
+        // Everything else works on a single input file, in the
+        // precision asked for.
+        spectrum_settings settings;
+        settings.input_data_file_name = input_data_file_name;
+        settings.export_spectrum_file_name = export_spectrum_file_name;
+        settings.export_wisdom_file_name = export_wisdom_file_name;
+        settings.import_wisdom_file_name = import_wisdom_file_name;
+        settings.export_realfft_results_file_name =
+          export_realfft_results_file_name;
+        settings.mpiio_hints = mpiio_hints;
+        settings.scratch_directory = scratch_directory;
+        settings.wisdom_directory = wisdom_directory;
+        settings.tones_file_name = tones_file_name;
+        settings.wisdom_time_limit = wisdom_time_limit;
+        settings.memory_budget = (size_t) memory_budget;
+        settings.input_type = input_type;
+        settings.window = window;
+        settings.in_place = in_place_flag;
+        settings.local = (local_flag || (MPI::COMM_WORLD.Get_size () == 1)) &&
+          (scratch_directory == NULL) && !in_place_flag;
+        settings.optimum_plan = optimum_plan || (wisdom_directory != NULL);
+        settings.sample_rate = sample_rate;
+        settings.segment_length = (int) segment_length;
+        settings.segment_overlap = (int) segment_overlap;
+        settings.frame_length = (int) frame_length;
+        settings.frame_hop = (int) frame_hop;
+        settings.average_frames = (int) average_frames;
+        settings.publish_every = (int) publish_every;
+        settings.format = format;
+        settings.bins = bins;
+        settings.padding = padding;
+        settings.band = band;
 
-        // Write out the results of the transformation to disk if we need to. 
-        transform.export_transformed (export_realfft_results_file_name);
-        
-        // Save wisdom if we need to. 
-        transform.export_wisdom (export_wisdom_file_name);
+        // Averaging segments is a different beast too, and so are
+        // streams, spectrograms and transforming out of core.
+#ifdef HAVE_SINGLE_PRECISION
+        if (single_precision)
+          {
+            if (stream_flag)
+              stream_spectrum < float >(settings);
+            else if (spectrogram_flag)
+              spectrogram_spectrum < float >(settings);
+            else if (welch_flag)
+              welch_spectrum < float >(settings);
+            else if (band_flag)
+              band_spectrum < float >(settings);
+            else if (tones_file_name != NULL)
+              tone_spectrum < float >(settings);
+            else if (scratch_directory != NULL)
+              out_of_core_spectrum < float >(settings);
+            else
+              whole_spectrum < float >(settings);
+          }
+        else
+#endif
+        if (stream_flag)
+          stream_spectrum < double >(settings);
+        else if (spectrogram_flag)
+          spectrogram_spectrum < double >(settings);
+        else if (welch_flag)
+          welch_spectrum < double >(settings);
+        else if (band_flag)
+          band_spectrum < double >(settings);
+        else if (tones_file_name != NULL)
+          tone_spectrum < double >(settings);
+        else if (scratch_directory != NULL)
+          out_of_core_spectrum < double >(settings);
+        else
+          whole_spectrum < double >(settings);
       }
+
+    // Report the timings if we need to. Everybody takes part in this.
+    if (timings_file_name != NULL)
+      PhaseTimer::export_report (timings_file_name);
   }
   catch (GenericException & err)
   {
@@ -387,7 +1480,17 @@ main (int argc, char **argv)
     MPI::COMM_WORLD.Abort (EXIT_FAILURE);
   }
 
-  // Finish.
+  // Finish. Every transform object is gone by now, so no cached plan
+  // is in use.
+  SegmentedFFT < double >::forget_plans ();
+#ifdef HAVE_SINGLE_PRECISION
+  SegmentedFFT < float >::forget_plans ();
+#endif
+  ThreadPool::set_threads (1);
+#ifdef HAVE_FFTW3
+  fftwf_mpi_cleanup ();
+  fftw_mpi_cleanup ();
+#endif
   MPI::Finalize ();
-  return 0;
+  return exit_status;
 }
@@ -19,36 +19,51 @@
 #include <cmath>
 #include <cerrno>
 #include <climits>
+#include <sstream>
+#include <algorithm>
 #include <unistd.h>
 
 // Local includes.
 #include "realfft.h"
 #include "stl_ext.h"
+#include "phase_timer.h"
+#include "wisdom_cache.h"
+#include "mpi_output.h"
+#include "csv_formatter.h"
+#include "thread_pool.h"
 
-RealFFT::RealFFT (bool optimal_plan, MPIRFFTWInput & input, const char *import_wisdom_file_name):friendly_input (&input)
+// Not worth a thread of its own for less than this many data points.
+#define MIN_POINTS_PER_THREAD 16384
+
+// The FFTW3 versions of these live in realfft_fftw3.cpp.
+#ifndef HAVE_FFTW3
+template < typename T > RealFFT < T >::RealFFT (bool optimal_plan, MPIRFFTWInput < T > &input, const char *import_wisdom_file_name, bool in_place_transform, const Padding & padding):
+input_stride (2),
+output_data_array (NULL),
+first_output_bin (0), output_bins_count (0), friendly_input (&input),
+local (input.local), comm (input.local ? MPI_COMM_SELF : MPI_COMM_WORLD),
+in_place (in_place_transform),
+transform_length (padding.get_length (input.total_data_points_count)),
+chirp (padding.get_policy () == Padding::EXACT), chirp_length (0),
+chirp_spectrum_count (0), chirp_output_start (0), chirp_output_count (0),
+chirp_spectrum (NULL), work_data_array (NULL)
 {
 
+  // Time the planning.
+  PhaseTimer timer (PhaseTimer::PLAN);
+
   // Flags for plan creation.
   int
     rfftw_mpi_plan_flags = 0;
 
-  // Check if we need to import wisdom.
-  if (import_wisdom_file_name != NULL)
-    {
-
-      // Yup. Open wisdom file.
-      FILE *
-	wisdom_file;
-      if ((wisdom_file = fopen (import_wisdom_file_name, "r")) != NULL)
-	// And import.
-	fftw_import_wisdom_from_file (wisdom_file);
-      else
-	throw RealFFTException (RealFFTException::EFIO,
-				std::
-				string ("couldn't open input wisdom file '") +
+  // Check if we need to import wisdom. The primary process reads it
+  // for everybody.
+  if ((import_wisdom_file_name != NULL) &&
+      !WisdomCache < T >::import_file (import_wisdom_file_name, comm))
+    throw RealFFTException (RealFFTException::EFIO,
+				std::string ("couldn't open input wisdom file '") +
 				import_wisdom_file_name +
 				std::string ("' for import"));
-    }
 
   // If we are creating an optimal (slow creation, fastest transform) plan.
   if (optimal_plan)
@@ -56,128 +71,455 @@ RealFFT::RealFFT (bool optimal_plan, MPIRFFTWInput & input, const char *import_w
   else
     rfftw_mpi_plan_flags = FFTW_ESTIMATE;
 
-  // Create a forward two-dimensional RFFTW MPI plan, with the size
-  // of the second dimension 1, as we really are doing a one-dimenstional
-  // transformation. FFTW2 refuses to create an MPI one-dimensional plan :-(.
-  myplan = rfftw2d_mpi_create_plan (MPI_COMM_WORLD,
-				    (*friendly_input).total_data_points_count,
-				    1,
-				    FFTW_REAL_TO_COMPLEX,
-				    rfftw_mpi_plan_flags | FFTW_USE_WISDOM);
-
-  // Check if we actually created the plan.
-  if (myplan == NULL)
-    throw
-      RealFFTException (RealFFTException::EPLAN,
-			std::string ("plan creation failed :-(("));
-
-  // Compute how much data (and what data) we need to load in this MPI process.
-  rfftwnd_mpi_local_sizes (myplan,
-			   &how_many_to_be_read,
-			   &how_many_to_be_skipped,
-			   &how_many_to_be_read_transposed,
-			   &how_many_to_be_skipped_transposed,
-			   &local_data_array_length);
-
-  // local_data_array_length is counted in fftw_real(s).
-  // Lets page-align this array.
-  if (posix_memalign ((void **) (&output_data_array),
+  // Bluestein's algorithm takes a forward and a backward complex MPI
+  // plan, even for a local transform. The forward DFT leaves its output
+  // scrambled, and the backward DFT takes it that way, which saves
+  // both putting it in order. Each data point is read in as a complex
+  // number, and both DFTs are done in place.
+  if (chirp)
+    {
+      chirp_length =
+	Padding::next_smooth (2 * (*friendly_input).total_data_points_count -
+			      1);
+      chirp_plan = fftw_mpi_create_plan (comm, (int) chirp_length,
+					 FFTW_FORWARD,
+					 rfftw_mpi_plan_flags |
+					 FFTW_USE_WISDOM |
+					 FFTW_SCRAMBLED_OUTPUT);
+      backward_plan = fftw_mpi_create_plan (comm, (int) chirp_length,
+					    FFTW_BACKWARD,
+					    rfftw_mpi_plan_flags |
+					    FFTW_USE_WISDOM |
+					    FFTW_SCRAMBLED_INPUT);
+      if ((chirp_plan == NULL) || (backward_plan == NULL))
+	throw
+	  RealFFTException (RealFFTException::EPLAN,
+			    std::string ("plan creation failed :-(("));
+      int
+	spectrum_count,
+	spectrum_start,
+	backward_count,
+	backward_start,
+	output_count,
+	output_start,
+	forward_length,
+	backward_length;
+      fftw_mpi_local_sizes (chirp_plan, &how_many_to_be_read,
+			    &how_many_to_be_skipped, &spectrum_count,
+			    &spectrum_start, &forward_length);
+      fftw_mpi_local_sizes (backward_plan, &backward_count, &backward_start,
+			    &output_count, &output_start, &backward_length);
+      if ((backward_count != spectrum_count) ||
+	  (backward_start != spectrum_start))
+	throw
+	  RealFFTException (RealFFTException::EPLAN,
+			    std::
+			    string
+			    ("forward and backward plans don't line up"));
+      chirp_spectrum_count = spectrum_count;
+      chirp_output_start = output_start;
+      chirp_output_count = output_count;
+      local_data_array_length = 2 * std::max (forward_length,
+					      backward_length);
+      if (posix_memalign ((void **) (&chirp_spectrum),
+			  sysconf (_SC_PAGESIZE),
+			  sizeof (T) * local_data_array_length) == ENOMEM)
+	throw
+	  RealFFTException (RealFFTException::EMEM,
+			    std::string ("couldn't allocate chirp array of ") +
+			    to_string (local_data_array_length / 2) +
+			    std::string (" complex numbers"));
+    }
+
+  // A local transform reads the whole input contiguously, and
+  // transforms it with a plain one-dimensional real plan. FFTW2 plans
+  // aren't tied to arrays, so there's nothing to worry about when the
+  // input turns out to be a mapping of the file. The input is padded
+  // with zeros up to transform_length.
+  else if (local)
+    {
+      local_plan = rfftw_create_plan (transform_length,
+				      FFTW_REAL_TO_COMPLEX,
+				      rfftw_mpi_plan_flags | FFTW_USE_WISDOM);
+      if (local_plan == NULL)
+	throw
+	  RealFFTException (RealFFTException::EPLAN,
+			    std::string ("plan creation failed :-(("));
+      how_many_to_be_read = transform_length;
+      how_many_to_be_skipped = 0;
+      input_stride = 1;
+      local_data_array_length = how_many_to_be_read;
+    }
+  else
+    {
+
+      // Create a forward two-dimensional RFFTW MPI plan, with the size
+      // of the second dimension 1, as we really are doing a one-dimenstional
+      // transformation. FFTW2 refuses to create an MPI one-dimensional plan :-(.
+      myplan = rfftw2d_mpi_create_plan (comm, transform_length, 1,
+					FFTW_REAL_TO_COMPLEX,
+					rfftw_mpi_plan_flags |
+					FFTW_USE_WISDOM);
+
+      // Check if we actually created the plan.
+      if (myplan == NULL)
+	throw
+	  RealFFTException (RealFFTException::EPLAN,
+			    std::string ("plan creation failed :-(("));
+
+      // Compute how much data (and what data) we need to load in this MPI process.
+      rfftwnd_mpi_local_sizes (myplan,
+			       &how_many_to_be_read,
+			       &how_many_to_be_skipped,
+			       &how_many_to_be_read_transposed,
+			       &how_many_to_be_skipped_transposed,
+			       &local_data_array_length);
+    }
+
+  // local_data_array_length is counted in Ts.
+  // Lets page-align this array. In place MPI transforms do without.
+  // Bluestein's algorithm uses it for both of its DFTs.
+  if ((local || !in_place) &&
+      posix_memalign ((void **) (&work_data_array),
 		      sysconf (_SC_PAGESIZE),
-		      sizeof (fftw_real) * local_data_array_length) == ENOMEM)
+		      sizeof (T) * local_data_array_length) == ENOMEM)
     throw
       RealFFTException (RealFFTException::EMEM,
-			std::string ("couldn't allocate output array of ") +
+			std::string ("couldn't allocate work array of ") +
 			to_string (local_data_array_length) +
 			std::
 			string
-			(" fftw_reals. Maybe data too big to fit in memory? Increase number of MPI nodes"));
+			(" data points. Maybe data too big to fit in memory? Increase number of MPI nodes"));
 }
 
-RealFFT::~RealFFT ()
+template < typename T > RealFFT < T >::~RealFFT ()
 {
-  free (output_data_array);
+  free (work_data_array);
+  free (chirp_spectrum);
+
+  // Local transforms have an output array of their own, unless it's
+  // Bluestein's algorithm's.
+  if (local && !chirp)
+    free (output_data_array);
 }
 
-void
-RealFFT::export_wisdom (const char *export_wisdom_file_name)
+template < typename T > void
+RealFFT < T >::do_transform ()
 {
 
-  // Only export if we are given a file name.
-  if (export_wisdom_file_name != NULL)
+  // Time the transform.
+  PhaseTimer timer (PhaseTimer::TRANSFORM);
+
+  // Bluestein's algorithm. The DFT of the second chirp is found first,
+  // with the same plan, so that it's scrambled the same way.
+  if (chirp)
     {
+      fftw_complex *data = (fftw_complex *) (*friendly_input).input_data_array;
+      fftw_complex *work = (fftw_complex *) work_data_array;
+      fill_chirp_filter ();
+      fftw_mpi (chirp_plan, 1, (fftw_complex *) chirp_spectrum, work);
+      modulate_input ();
+      fftw_mpi (chirp_plan, 1, data, work);
+      apply_chirp_filter ();
+      fftw_mpi (backward_plan, 1, data, work);
+      fftw_mpi_destroy_plan (chirp_plan);
+      fftw_mpi_destroy_plan (backward_plan);
+      demodulate_output ();
+      return;
+    }
 
-      // Open wisdom file.
-      FILE *wisdom_file;
-      if ((wisdom_file = fopen (export_wisdom_file_name, "w")) != NULL)
+  // Local transforms go out of place into the work array, and the
+  // halfcomplex output is then reordered into complex bins.
+  if (local)
+    {
+      size_t data_points_count = transform_length;
+      rfftw_one (local_plan, (*friendly_input).input_data_array,
+		 work_data_array);
+      rfftw_destroy_plan (local_plan);
+      output_bins_count = data_points_count / 2 + 1;
+      if (posix_memalign ((void **) (&output_data_array),
+			  sysconf (_SC_PAGESIZE),
+			  sizeof (complex) * output_bins_count) == ENOMEM)
+	throw
+	  RealFFTException (RealFFTException::EMEM,
+			    std::string ("couldn't allocate output array of ")
+			    + to_string (output_bins_count) +
+			    std::string (" complex numbers"));
 
-	// And export.
-	fftw_export_wisdom_to_file (wisdom_file);
-      else
-	throw RealFFTException (RealFFTException::EFIO,
-				std::
-				string ("couldn't open output wisdom file '")
-				+ std::string (export_wisdom_file_name) +
-				std::string ("' for export"));
+      // Bin k has its real part at k, and its imaginary part at N - k.
+      // The DC component and the Nyquist frequency have none.
+      output_data_array[0].re = work_data_array[0];
+      output_data_array[0].im = 0;
+      for (size_t k = 1; k < output_bins_count; k++)
+	{
+	  output_data_array[k].re = work_data_array[k];
+	  output_data_array[k].im =
+	    (2 * k == data_points_count) ? 0 :
+	    work_data_array[data_points_count - k];
+	}
+      first_output_bin = 0;
+      return;
     }
-}
 
-void
-RealFFT::do_transform ()
-{
-  
-  // Do transform.
+  // Do transform. rfftwnd_mpi transforms in place, using the work
+  // array, if any, as scratch space.
   rfftwnd_mpi (myplan,
 	       1,
 	       (*friendly_input).input_data_array,
-	       (fftw_real *) output_data_array, FFTW_NORMAL_ORDER);
+	       work_data_array, FFTW_NORMAL_ORDER);
   
   // Destroy the plan. Not needed anymore.
   rfftwnd_mpi_destroy_plan (myplan);
+
+  // Each padded data point is now a complex output bin. We have the
+  // bins corresponding to the data points we've read.
+  output_data_array = (complex *) (*friendly_input).input_data_array;
+  first_output_bin = how_many_to_be_skipped;
+  output_bins_count = how_many_to_be_read;
 }
 
-void
-RealFFT::export_transformed (const char *export_transformed_file_name)
+// FFTW2 only comes in the precision it was built with.
+template RealFFT < fftw_real >::RealFFT (bool, MPIRFFTWInput < fftw_real > &,
+					 const char *, bool, const Padding &);
+template RealFFT < fftw_real >::~RealFFT ();
+template void RealFFT < fftw_real >::do_transform ();
+#endif
+
+// Returns n * n mod modulus, without overflowing, as long as twice
+// the modulus doesn't.
+static size_t
+square_mod (size_t n, size_t modulus)
 {
+  size_t square = 0, addend = n % modulus;
+  for (; n != 0; n >>= 1)
+    {
+      if (n & 1)
+	square = (square + addend) % modulus;
+      addend = (addend * 2) % modulus;
+    }
+  return square;
+}
+
+// Makes phase n * n mod modulus, given that it's last_n * last_n mod
+// modulus, and last_n n. Squares of neighbouring numbers are a step
+// apart, so a run of them takes a single square_mod.
+static void
+step_phase (size_t n, size_t & last_n, size_t & phase, size_t modulus)
+{
+  if ((last_n != (size_t) -1) && (n == last_n + 1))
+    phase = (phase + (2 * last_n + 1) % modulus) % modulus;
+  else if ((last_n != (size_t) -1) && (n + 1 == last_n))
+    phase = (phase + modulus - (2 * n + 1) % modulus) % modulus;
+  else if (n != last_n)
+    phase = square_mod (n, modulus);
+  last_n = n;
+}
+
+// The chirps of Bluestein's algorithm for N data points are
+// exp(-+ i * pi * n^2 / N). As exp(i * pi * n^2 / N) only depends on
+// n^2 mod 2N, that's what they are worked out from, which keeps the
+// phase exact however long the input is. The DFT of the input is
+// X[k] = w[k] * sum (x[n] * w[n] * conj (w[k - n])), with
+// w[n] = exp(-i * pi * n^2 / N), a convolution of x[n] * w[n] with
+// conj (w[n]), the latter wrapped around chirp_length.
+template < typename T > void
+RealFFT < T >::fill_chirp_filter ()
+{
+  size_t data_points_count = (*friendly_input).total_data_points_count;
+  size_t modulus = 2 * data_points_count;
+  double scale = 1.0 / (double) chirp_length;
+  size_t first = how_many_to_be_skipped;
+  ThreadPool::parallel_for (how_many_to_be_read, MIN_POINTS_PER_THREAD,
+			    [&] (size_t start, size_t end)
+    {
+      size_t last_n = (size_t) -1, phase = 0;
+      for (size_t ix = start; ix < end; ix++)
+	{
+	  size_t j = first + ix;
+	  complex & b = chirp_spectrum[ix];
+	  if ((j >= data_points_count) &&
+	      (j <= chirp_length - data_points_count))
+	    {
+	      b.re = b.im = 0;
+	      continue;
+	    }
+	  step_phase ((j < data_points_count) ? j : chirp_length - j,
+		      last_n, phase, modulus);
+	  double angle = M_PI * (double) phase / (double) data_points_count;
+	  b.re = (T) (scale * std::cos (angle));
+	  b.im = (T) (scale * std::sin (angle));
+	}
+    });
+}
+
+template < typename T > void
+RealFFT < T >::modulate_input ()
+{
+
+  // The imaginary parts of the data points read are whatever was in
+  // the input data array, and the data points past the end of the
+  // input are zero.
+  size_t data_points_count = (*friendly_input).total_data_points_count;
+  size_t modulus = 2 * data_points_count;
+  complex *data = (complex *) (*friendly_input).input_data_array;
+  size_t first = how_many_to_be_skipped;
+  ThreadPool::parallel_for (how_many_to_be_read, MIN_POINTS_PER_THREAD,
+			    [&] (size_t start, size_t end)
+    {
+      size_t last_n = (size_t) -1, phase = 0;
+      for (size_t ix = start; ix < end; ix++)
+	{
+	  size_t n = first + ix;
+	  if (n >= data_points_count)
+	    {
+	      data[ix].re = data[ix].im = 0;
+	      continue;
+	    }
+	  step_phase (n, last_n, phase, modulus);
+	  double angle = M_PI * (double) phase / (double) data_points_count;
+	  double x = data[ix].re;
+	  data[ix].re = (T) (x * std::cos (angle));
+	  data[ix].im = (T) (-x * std::sin (angle));
+	}
+    });
+}
+
+template < typename T > void
+RealFFT < T >::apply_chirp_filter ()
+{
+  complex *data = (complex *) (*friendly_input).input_data_array;
+  ThreadPool::parallel_for (chirp_spectrum_count, MIN_POINTS_PER_THREAD,
+			    [&] (size_t start, size_t end)
+    {
+      for (size_t ix = start; ix < end; ix++)
+	{
+	  double re = data[ix].re, im = data[ix].im;
+	  double b_re = chirp_spectrum[ix].re, b_im = chirp_spectrum[ix].im;
+	  data[ix].re = (T) (re * b_re - im * b_im);
+	  data[ix].im = (T) (re * b_im + im * b_re);
+	}
+    });
+}
+
+template < typename T > void
+RealFFT < T >::demodulate_output ()
+{
+
+  // Only the first N bins of the convolution are bins of the DFT.
+  size_t data_points_count = (*friendly_input).total_data_points_count;
+  size_t modulus = 2 * data_points_count;
+  complex *data = (complex *) (*friendly_input).input_data_array;
+  size_t first = chirp_output_start;
+  size_t count = (first >= data_points_count) ? 0 :
+    std::min (chirp_output_count, data_points_count - first);
+  ThreadPool::parallel_for (count, MIN_POINTS_PER_THREAD,
+			    [&] (size_t start, size_t end)
+    {
+      size_t last_n = (size_t) -1, phase = 0;
+      for (size_t ix = start; ix < end; ix++)
+	{
+	  step_phase (first + ix, last_n, phase, modulus);
+	  double angle = M_PI * (double) phase / (double) data_points_count;
+	  double c = std::cos (angle), s = -std::sin (angle);
+	  double re = data[ix].re, im = data[ix].im;
+	  data[ix].re = (T) (re * c - im * s);
+	  data[ix].im = (T) (re * s + im * c);
+	}
+    });
+  output_data_array = data;
+  first_output_bin = first;
+  output_bins_count = count;
+}
+
+template < typename T > void
+RealFFT < T >::export_wisdom (const char *export_wisdom_file_name)
+{
+
+  // Time the export.
+  PhaseTimer timer (PhaseTimer::EXPORT);
 
   // Only export if we are given a file name.
-  if (export_transformed_file_name != NULL)
+  if (export_wisdom_file_name != NULL)
     {
 
-      // Open file.
-      std::ofstream fout;
-      fout.open (export_transformed_file_name);
-      if (!fout.is_open ())
+      // Write the wisdom out.
+      if (!WisdomCache < T >::export_file (export_wisdom_file_name))
 	throw RealFFTException (RealFFTException::EFIO,
-				std::string ("could not open '") +
-				std::string (export_transformed_file_name) +
-				std::string ("' for writing"));
-
-      // Attempt writing-out data.
-      try
-      {
-
-        // Set output format.
-        // Yuck :-). Hey, at least this way I don't need to determine the
-        // precision by hand.
-        fout.setf(std::ios_base::scientific, std::ios_base::floatfield); 
-        fout.precision((int)(std::ceil(std::log10(std::pow(2.0,(double)(CHAR_BIT*sizeof(double)))))));
-	fout << "# re, im" << std::endl;
-
-        // The output consists of the same number of points as the input.
-        // Yes this isn't clean, but the alternative is not clean either
-        // when it's patently obvious this is the case.
-	for (size_t ix = 0; ix < (*friendly_input).total_data_points_count;
-	     ix++)
-	  fout << output_data_array[ix].re << ", " << output_data_array[ix].
-	    im << std::endl;
-	fout.close ();
-      }
-      catch (std::ios::failure & err)
-      {
-	throw RealFFTException (RealFFTException::EFIO,
-				std::string ("could not write to '") +
-				std::string (export_transformed_file_name) +
-				std::string ("'"));
-      }
+				std::string ("couldn't open output wisdom file '") +
+				std::string (export_wisdom_file_name) +
+				std::string ("' for export"));
     }
 }
+
+template < typename T > void
+RealFFT < T >::export_transformed (const char *export_transformed_file_name,
+			      OutputFormat::format_t format,
+			      double sample_rate)
+{
+
+  // Time the export.
+  PhaseTimer timer (PhaseTimer::EXPORT);
+
+  // Only export if we are given a file name.
+  if (export_transformed_file_name != NULL)
+    {
+      int
+	rank;
+      MPI_Comm_rank (comm, &rank);
+
+      // Binary formats hold the output bins as they are.
+      if (format != OutputFormat::CSV)
+	{
+	  size_t data_points_count = transform_length;
+	  unsigned long long bins_count = output_bins_count, total_bins;
+	  MPI_Allreduce (&bins_count, &total_bins, 1,
+			 MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+	  std::string out;
+	  if (rank == 0)
+	    out = OutputFormat::header (format,
+					FFTWPrecision < T >::numpy_complex_type (),
+					1, data_points_count,
+					total_bins, sample_rate,
+					sample_rate /
+					(double) data_points_count);
+	  out.append ((const char *) output_data_array,
+		      sizeof (complex) * output_bins_count);
+
+	  // Everybody writes out their bins, in order.
+	  MPIOutput output (export_transformed_file_name, comm);
+	  output.write (out);
+	  return;
+	}
+
+      // Format our output bins.
+      std::string out;
+      if (rank == 0)
+	out = "# re, im\n";
+      CSVFormatter::append_rows (&output_data_array[0].re, output_bins_count,
+				 out);
+
+      // Everybody writes out their bins, in order.
+      MPIOutput output (export_transformed_file_name, comm);
+      output.write (out);
+    }
+}
+
+// The precisions supported.
+template void RealFFT < double >::fill_chirp_filter ();
+template void RealFFT < double >::modulate_input ();
+template void RealFFT < double >::apply_chirp_filter ();
+template void RealFFT < double >::demodulate_output ();
+template void RealFFT < double >::export_wisdom (const char *);
+template void RealFFT < double >::export_transformed (const char *,
+						      OutputFormat::format_t,
+						      double);
+#ifdef HAVE_SINGLE_PRECISION
+template void RealFFT < float >::fill_chirp_filter ();
+template void RealFFT < float >::modulate_input ();
+template void RealFFT < float >::apply_chirp_filter ();
+template void RealFFT < float >::demodulate_output ();
+template void RealFFT < float >::export_wisdom (const char *);
+template void RealFFT < float >::export_transformed (const char *,
+						     OutputFormat::format_t,
+						     double);
+#endif
@@ -23,16 +23,18 @@
 #include <cstdio>
 #include <string>
 #include <cstddef>
-#include <rfftw_mpi.h>
 
 // Local includes.
+#include "fft_backend.h"
 #include "ps_generator.h"
 #include "mpirfftw_input.h"
+#include "output_format.h"
+#include "padding.h"
 #include "generic_exception.h"
 
 // Forward declaration.
-class PSGenerator;
-class MPIRFFTWInput;
+template < typename T > class PSGenerator;
+template < typename T > class MPIRFFTWInput;
 
 class RealFFTException:public GenericException
 {
@@ -71,28 +73,118 @@ public:
   }
 };
 
-class RealFFT
+// Transforms data points of type T, float or double. FFTW2 builds only
+// support the precision FFTW2 was built with, double.
+template < typename T > class RealFFT
 {
 private:
 
+  // A complex number of our precision.
+  typedef fft_complex_of < T > complex;
+
   // We're friends with MPIRFFTWInput.
-  friend class MPIRFFTWInput;
+  friend class MPIRFFTWInput < T >;
 
   // We're friends with PSGenerator.
-  friend class PSGenerator;
-
-  // Plan.
-  rfftwnd_mpi_plan myplan;
+  friend class PSGenerator < T >;
 
   // Current process needs to read-in this many data points...
   int how_many_to_be_read;
 
-  // ...after skipping this many.
+  // ...after skipping this many...
   int how_many_to_be_skipped;
 
-  // Size (in fftw_reals) of output_data_array. (also of the input data array).
+  // ...placing consecutive data points this many Ts apart.
+  int input_stride;
+
+  // Size (in Ts) of the input data array.
   int local_data_array_length;
 
+  // The output of the transform held by this process. This is
+  // output_bins_count consecutive complex DFT bins, the first being
+  // bin first_output_bin.
+  complex *output_data_array;
+  size_t first_output_bin;
+  size_t output_bins_count;
+
+  // Pointer to the class friend object.
+  MPIRFFTWInput < T > *friendly_input;
+
+  // Is the input transformed by this process alone, with a local
+  // rather than an MPI plan? This is the case if the input is read
+  // locally. The processes taking part are in comm.
+  bool local;
+  MPI_Comm comm;
+
+  // Does the output overwrite the input, and the power spectrum the
+  // output? Local transforms, whose input may be a mapping of the
+  // file, still go out of place.
+  bool in_place;
+
+  // Number of data points transformed: the data points of the input,
+  // followed by as many zeros as the padding asks for. The DFT has as
+  // many bins.
+  size_t transform_length;
+
+  // Is the DFT found with Bluestein's algorithm? The input is then
+  // multiplied by a chirp, and convolved with another, through a
+  // forward and a backward complex DFT of chirp_length, which leave
+  // the DFT of the input, multiplied by the first chirp once more. The
+  // forward DFT reads how_many_to_be_read complex numbers, from
+  // how_many_to_be_skipped on, and leaves chirp_spectrum_count of them,
+  // in an order of FFTW's own, which the backward DFT takes as they
+  // are, and turns into chirp_output_count bins from chirp_output_start
+  // on. chirp_spectrum is the forward DFT of the second chirp, in that
+  // same order, divided by chirp_length, as FFTW doesn't normalize.
+  bool chirp;
+  size_t chirp_length;
+  size_t chirp_spectrum_count;
+  size_t chirp_output_start;
+  size_t chirp_output_count;
+  complex *chirp_spectrum;
+
+  // Steps of Bluestein's algorithm. The first fills chirp_spectrum with
+  // the second chirp, ready for the forward DFT. The second multiplies
+  // the data points read by the first chirp, and the third the forward
+  // DFT of that by chirp_spectrum. The last multiplies the bins left by
+  // the backward DFT by the first chirp, making them the output.
+  void fill_chirp_filter ();
+  void modulate_input ();
+  void apply_chirp_filter ();
+  void demodulate_output ();
+#ifdef HAVE_FFTW3
+
+  // Plan.
+  typename FFTWPrecision < T >::plan myplan;
+
+  // Inputs of even length are packed two data points per complex
+  // number, and transformed with a complex DFT of half the length.
+  // Inputs of odd length are transformed with a complex DFT of the same
+  // length, with the imaginary parts zeroed.
+  bool packed;
+
+  // Length of the complex DFT.
+  ptrdiff_t complex_length;
+
+  // Portion of the complex DFT input and output held by this process.
+  ptrdiff_t local_ni, local_i_start, local_no, local_o_start;
+
+  // Array the transform writes to. For packed inputs the output is
+  // then unpacked into output_data_array.
+  complex *transformed_data_array;
+
+  // Plan of the backward DFT of Bluestein's algorithm. myplan is that
+  // of the forward one.
+  typename FFTWPrecision < T >::plan backward_plan;
+
+  // Turns the half length complex DFT of the packed input into
+  // the first half of the DFT of the input.
+  void unpack ();
+#else
+
+  // Plan.
+  rfftwnd_mpi_plan myplan;
+
   // If fftwnd_mpi is called with FFTW_TRANSPOSED_ORDER, then y will
   // be the first dimension for the output and the local y extend will be given
   // by how_many_to_be_read_transposed and local_y_start_after_transpose. We don't
@@ -100,18 +192,34 @@ private:
   int how_many_to_be_read_transposed;
   int how_many_to_be_skipped_transposed;
 
-  // Pointer to the class friend object.
-  MPIRFFTWInput *friendly_input;
+  // Work array for rfftwnd_mpi, which transforms in place. The output
+  // ends up in the input data array. Without a work array, which is
+  // the case for in_place transforms, it's slower, but needs half the
+  // memory. Local plans transform out of place into the work array,
+  // which then holds the output in halfcomplex order.
+  T *work_data_array;
 
-  // Array to hold output data.
-  fftw_complex *output_data_array;
+  // Local plan.
+  rfftw_plan local_plan;
+
+  // Plans of the forward and backward DFTs of Bluestein's algorithm.
+  fftw_mpi_plan chirp_plan;
+  fftw_mpi_plan backward_plan;
+#endif
 public:
 
   // Constructor. Set true to optimal_plan if plan creation with FFTW_MEASURE
   // is desired. (slow plan creation!). Pass an MPIRFFTWInput object as it will be
   // needed. Pass import_wisdom_file_name as NULL if no wisdom is to be imported.
+  // If the input is read locally, the transform is done by this process
+  // alone, and may be threaded on FFTW3 builds. If in_place is set, the
+  // transform needs no memory beyond the input array, and the power
+  // spectrum is found in place of the output, which can then no longer
+  // be exported. The input is padded with zeros, or transformed with
+  // Bluestein's algorithm, as padding says.
     RealFFT (bool optimal_plan,
-	     MPIRFFTWInput & input, const char *import_wisdom_file_name);
+	     MPIRFFTWInput < T > &input, const char *import_wisdom_file_name,
+	     bool in_place = false, const Padding & padding = Padding ());
 
   // Destructor.
    ~RealFFT ();
@@ -120,7 +228,11 @@ public:
   void export_wisdom (const char *export_wisdom_file_name);
 
   // Exports the result of the transform to file, as long as the file name isn't a NULL pointer.
-  void export_transformed (const char *export_transformed_file_name);
+  // Must be called by every process, as each writes out the output bins it holds.
+  // The sample rate only ends up in the header of the binary formats.
+  void export_transformed (const char *export_transformed_file_name,
+			   OutputFormat::format_t format = OutputFormat::CSV,
+			   double sample_rate = 1);
 
   // Performs transform.
   void do_transform ();
@@ -0,0 +1,518 @@
+// Time-stamp: <2026-10-17 14:02:33 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// RealFFT on top of FFTW3. FFTW3's MPI interface has no one-dimensional
+// real transform either, but unlike FFTW2 it does have a one-dimensional
+// complex one. An even number of real data points is read in as half as
+// many complex numbers, transformed, and then unpacked using the
+// symmetries of the DFT of a real sequence. Unpacking bin k needs bin
+// N/2-k, which generally belongs to another process, so the processes
+// swap those first.
+
+// The FFTW2 versions of these live in realfft.cpp.
+#ifdef HAVE_FFTW3
+
+// System includes.
+#include <cmath>
+#include <cerrno>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+
+// Local includes.
+#include "realfft.h"
+#include "stl_ext.h"
+#include "phase_timer.h"
+#include "wisdom_cache.h"
+#include "thread_pool.h"
+
+// Not worth a thread of its own for less than this many bins.
+#define MIN_BINS_PER_THREAD 16384
+
+// Appends, in increasing order, the bins k in [needed_start, needed_end)
+// whose mirror bin (length - k) % length lies within
+// [owned_start, owned_end), for a complex DFT of the given length. Bin
+// length (the Nyquist bin of the unpacked DFT) mirrors bin 0.
+static void
+mirror_bins (ptrdiff_t needed_start, ptrdiff_t needed_end,
+	     ptrdiff_t owned_start, ptrdiff_t owned_end,
+	     ptrdiff_t length, std::vector < ptrdiff_t > &bins)
+{
+  bool owns_dc = (owned_start == 0) && (owned_end > 0);
+
+  // Bin 0 is its own mirror.
+  if ((needed_start == 0) && (needed_end > 0) && owns_dc)
+    bins.push_back (0);
+
+  // Bins 1 to length - 1 mirror bins length - 1 to 1.
+  ptrdiff_t from = std::max (std::max (needed_start, (ptrdiff_t) 1),
+			     length - owned_end + 1);
+  ptrdiff_t to = std::min (std::min (needed_end, length),
+			   length - owned_start + 1);
+  for (ptrdiff_t k = from; k < to; k++)
+    bins.push_back (k);
+
+  // Bin length mirrors bin 0.
+  if ((needed_end == length + 1) && owns_dc)
+    bins.push_back (length);
+}
+
+template < typename T > RealFFT < T >::RealFFT (bool optimal_plan, MPIRFFTWInput < T > &input, const char *import_wisdom_file_name, bool in_place_transform, const Padding & padding):
+output_data_array (NULL),
+first_output_bin (0),
+output_bins_count (0), friendly_input (&input),
+local (input.local), comm (input.local ? MPI_COMM_SELF : MPI_COMM_WORLD),
+in_place (in_place_transform),
+transform_length (padding.get_length (input.total_data_points_count)),
+chirp (padding.get_policy () == Padding::EXACT), chirp_length (0),
+chirp_spectrum_count (0), chirp_output_start (0), chirp_output_count (0),
+chirp_spectrum (NULL), transformed_data_array (NULL)
+{
+
+  // Time the planning.
+  PhaseTimer timer (PhaseTimer::PLAN);
+
+  // Flags for plan creation.
+  unsigned
+    fftw_mpi_plan_flags = 0;
+
+  // Check if we need to import wisdom. The primary process reads it
+  // for everybody.
+  if ((import_wisdom_file_name != NULL) &&
+      !WisdomCache < T >::import_file (import_wisdom_file_name, comm))
+    throw RealFFTException (RealFFTException::EFIO,
+				std::string ("couldn't open input wisdom file '") +
+				import_wisdom_file_name +
+				std::string ("' for import"));
+
+  // If we are creating an optimal (slow creation, fastest transform) plan.
+  if (optimal_plan)
+    fftw_mpi_plan_flags = FFTW_MEASURE;
+  else
+    fftw_mpi_plan_flags = FFTW_ESTIMATE;
+
+  // Bluestein's algorithm takes a forward and a backward complex MPI
+  // plan, even for a local transform. The forward DFT leaves its output
+  // scrambled, and the backward DFT takes it that way, which saves
+  // both putting it in order. Each data point is read in as a complex
+  // number, and both DFTs are done in place.
+  typedef typename FFTWPrecision < T >::complex fftw_complex_t;
+  if (chirp)
+    {
+      packed = false;
+      chirp_length =
+	Padding::next_smooth (2 * (*friendly_input).total_data_points_count -
+			      1);
+      complex_length = chirp_length;
+      ptrdiff_t
+	backward_ni,
+	backward_i_start,
+	backward_no,
+	backward_o_start;
+      ptrdiff_t
+	alloc_local =
+	std::max (FFTWPrecision < T >::mpi_local_size_1d (complex_length, comm,
+							  FFTW_FORWARD,
+							  fftw_mpi_plan_flags |
+							  FFTW_MPI_SCRAMBLED_OUT,
+							  &local_ni,
+							  &local_i_start,
+							  &local_no,
+							  &local_o_start),
+		  FFTWPrecision < T >::mpi_local_size_1d (complex_length, comm,
+							  FFTW_BACKWARD,
+							  fftw_mpi_plan_flags |
+							  FFTW_MPI_SCRAMBLED_IN,
+							  &backward_ni,
+							  &backward_i_start,
+							  &backward_no,
+							  &backward_o_start));
+      if ((backward_ni != local_no) || (backward_i_start != local_o_start))
+	throw
+	  RealFFTException (RealFFTException::EPLAN,
+			    std::
+			    string
+			    ("forward and backward plans don't line up"));
+      how_many_to_be_read = local_ni;
+      how_many_to_be_skipped = local_i_start;
+      input_stride = 2;
+      local_data_array_length = 2 * alloc_local;
+      chirp_spectrum_count = local_no;
+      chirp_output_start = backward_o_start;
+      chirp_output_count = backward_no;
+      if ((posix_memalign ((void **) (&(*friendly_input).input_data_array),
+			   sysconf (_SC_PAGESIZE),
+			   sizeof (complex) * alloc_local) == ENOMEM) ||
+	  (posix_memalign ((void **) (&chirp_spectrum),
+			   sysconf (_SC_PAGESIZE),
+			   sizeof (complex) * alloc_local) == ENOMEM))
+	throw
+	  RealFFTException (RealFFTException::EMEM,
+			    std::string ("couldn't allocate arrays of ") +
+			    to_string (alloc_local) +
+			    std::
+			    string
+			    (" complex numbers. Maybe data too big to fit in memory? Increase number of MPI nodes"));
+      fftw_complex_t *data =
+	(fftw_complex_t *) (*friendly_input).input_data_array;
+      myplan =
+	FFTWPrecision < T >::mpi_plan_dft_1d (complex_length, data, data, comm,
+					       FFTW_FORWARD,
+					       fftw_mpi_plan_flags |
+					       FFTW_MPI_SCRAMBLED_OUT);
+      backward_plan =
+	FFTWPrecision < T >::mpi_plan_dft_1d (complex_length, data, data, comm,
+					       FFTW_BACKWARD,
+					       fftw_mpi_plan_flags |
+					       FFTW_MPI_SCRAMBLED_IN);
+      if ((myplan == NULL) || (backward_plan == NULL))
+	throw
+	  RealFFTException (RealFFTException::EPLAN,
+			    std::string ("plan creation failed :-(("));
+      return;
+    }
+
+  // A local transform reads the whole input contiguously, and
+  // transforms it with a plain (possibly threaded) real to complex
+  // plan, straight into the N/2+1 output bins. The input is padded with
+  // zeros up to transform_length.
+  if (local)
+    {
+      packed = false;
+      how_many_to_be_read = transform_length;
+      how_many_to_be_skipped = 0;
+      input_stride = 1;
+      local_data_array_length = how_many_to_be_read;
+      output_bins_count = how_many_to_be_read / 2 + 1;
+      if (posix_memalign ((void **) (&transformed_data_array),
+			  sysconf (_SC_PAGESIZE),
+			  sizeof (complex) * output_bins_count) == ENOMEM)
+	throw
+	  RealFFTException (RealFFTException::EMEM,
+			    std::string ("couldn't allocate output array of ")
+			    + to_string (output_bins_count) +
+			    std::
+			    string
+			    (" complex numbers. Maybe data too big to fit in memory? Increase number of MPI nodes"));
+
+      // The input isn't there yet, and may turn out to be a mapping of
+      // the file, which FFTW_MEASURE mustn't scribble over. So the plan
+      // is created on a scratch array, page aligned just like the
+      // input will be, and applied to the input later on.
+      T *scratch = NULL;
+      if (posix_memalign ((void **) (&scratch), sysconf (_SC_PAGESIZE),
+			  sizeof (T) * local_data_array_length) == ENOMEM)
+	throw
+	  RealFFTException (RealFFTException::EMEM,
+			    std::
+			    string ("couldn't allocate scratch array of ") +
+			    to_string (local_data_array_length) +
+			    std::string (" data points"));
+      myplan =
+	FFTWPrecision < T >::plan_dft_r2c_1d (local_data_array_length,
+					       scratch,
+					       (fftw_complex_t *)
+					       transformed_data_array,
+					       fftw_mpi_plan_flags);
+      free (scratch);
+      if (myplan == NULL)
+	throw
+	  RealFFTException (RealFFTException::EPLAN,
+			    std::string ("plan creation failed :-(("));
+      return;
+    }
+
+  // Pack the input if we can.
+  packed = (transform_length % 2 == 0);
+  complex_length = transform_length;
+  if (packed)
+    complex_length /= 2;
+
+  // Compute how much data (and what data) we need to load in this MPI
+  // process, and how much of the output we'll end up with.
+  ptrdiff_t
+    alloc_local =
+    FFTWPrecision < T >::mpi_local_size_1d (complex_length,
+					     comm,
+					     FFTW_FORWARD,
+					     fftw_mpi_plan_flags,
+					     &local_ni, &local_i_start,
+					     &local_no, &local_o_start);
+
+  // Packed data points are read in contiguously, others are padded
+  // with a zero imaginary part.
+  if (packed)
+    {
+      how_many_to_be_read = 2 * local_ni;
+      how_many_to_be_skipped = 2 * local_i_start;
+      input_stride = 1;
+    }
+  else
+    {
+      how_many_to_be_read = local_ni;
+      how_many_to_be_skipped = local_i_start;
+      input_stride = 2;
+    }
+  local_data_array_length = 2 * alloc_local;
+
+  // The plan has to be created on the very arrays it will transform,
+  // so we allocate the input data array here, rather than have
+  // MPIRFFTWInput::read_data do it. The transformed data array has
+  // room for one more bin, as the unpacked output has N/2+1 bins
+  // to the N/2 of the packed transform. In place, the input data
+  // array is the transformed data array, and has that room instead.
+  if (posix_memalign ((void **) (&(*friendly_input).input_data_array),
+		      sysconf (_SC_PAGESIZE),
+		      in_place ? sizeof (complex) * (alloc_local + 1) :
+		      sizeof (T) * local_data_array_length) == ENOMEM)
+    throw
+      RealFFTException (RealFFTException::EMEM,
+			std::string ("couldn't allocate input array of ") +
+			to_string (local_data_array_length) +
+			std::
+			string
+			(" data points. Maybe data too big to fit in memory? Increase number of MPI nodes"));
+  if (in_place)
+    transformed_data_array = (complex *) (*friendly_input).input_data_array;
+  else if (posix_memalign ((void **) (&transformed_data_array),
+		      sysconf (_SC_PAGESIZE),
+		      sizeof (complex) * (alloc_local + 1)) == ENOMEM)
+    throw
+      RealFFTException (RealFFTException::EMEM,
+			std::string ("couldn't allocate output array of ") +
+			to_string (alloc_local + 1) +
+			std::
+			string
+			(" complex numbers. Maybe data too big to fit in memory? Increase number of MPI nodes"));
+
+  // Create a forward one-dimensional complex FFTW3 MPI plan. Planning
+  // with FFTW_MEASURE scribbles over both arrays, which is fine, as
+  // nothing has been read in yet.
+  myplan =
+    FFTWPrecision < T >::mpi_plan_dft_1d (complex_length,
+					   (fftw_complex_t *) (*friendly_input).
+					   input_data_array,
+					   (fftw_complex_t *)
+					   transformed_data_array,
+					   comm, FFTW_FORWARD,
+					   fftw_mpi_plan_flags);
+
+  // Check if we actually created the plan.
+  if (myplan == NULL)
+    throw
+      RealFFTException (RealFFTException::EPLAN,
+			std::string ("plan creation failed :-(("));
+}
+
+template < typename T > RealFFT < T >::~RealFFT ()
+{
+
+  // In place MPI transforms write to the input data array, which
+  // isn't ours. Neither is Bluestein's algorithm's output.
+  if (local || !in_place)
+    free (transformed_data_array);
+  free (chirp_spectrum);
+}
+
+template < typename T > void
+RealFFT < T >::do_transform ()
+{
+
+  // Time the transform.
+  PhaseTimer timer (PhaseTimer::TRANSFORM);
+  typedef typename FFTWPrecision < T >::complex fftw_complex_t;
+
+  // Bluestein's algorithm. The DFT of the second chirp is found first,
+  // with the same plan, so that it's scrambled the same way.
+  if (chirp)
+    {
+      fill_chirp_filter ();
+      FFTWPrecision < T >::mpi_execute_dft (myplan,
+					     (fftw_complex_t *) chirp_spectrum,
+					     (fftw_complex_t *) chirp_spectrum);
+      modulate_input ();
+      FFTWPrecision < T >::execute (myplan);
+      apply_chirp_filter ();
+      FFTWPrecision < T >::execute (backward_plan);
+      FFTWPrecision < T >::destroy_plan (myplan);
+      FFTWPrecision < T >::destroy_plan (backward_plan);
+      demodulate_output ();
+      return;
+    }
+
+  // Local transforms go straight from the input, which may be a
+  // mapping of the file, to the output bins.
+  if (local)
+    {
+      FFTWPrecision < T >::execute_dft_r2c (myplan,
+					     (*friendly_input).
+					     input_data_array,
+					     (fftw_complex_t *)
+					     transformed_data_array);
+      FFTWPrecision < T >::destroy_plan (myplan);
+      output_data_array = transformed_data_array;
+      return;
+    }
+
+  // The padding of unpacked data points must be zero.
+  if (!packed)
+    for (ptrdiff_t ix = 0; ix < local_ni; ix++)
+      (*friendly_input).input_data_array[2 * ix + 1] = 0;
+
+  // Do transform.
+  FFTWPrecision < T >::execute (myplan);
+
+  // Destroy the plan. Not needed anymore.
+  FFTWPrecision < T >::destroy_plan (myplan);
+
+  // Unpacked inputs are done here.
+  output_data_array = transformed_data_array;
+  if (packed)
+    unpack ();
+  else
+    {
+      first_output_bin = local_o_start;
+      output_bins_count = local_no;
+    }
+}
+
+template < typename T > void
+RealFFT < T >::unpack ()
+{
+  int
+    size,
+    rank;
+  MPI_Comm_size (comm, &size);
+  MPI_Comm_rank (comm, &rank);
+
+  // Find out which bins everybody owns.
+  long long
+    my_range[2] = { local_o_start, local_o_start + local_no };
+  std::vector < long long >
+  ranges (2 * size);
+  MPI_Allgather (my_range, 2, MPI_LONG_LONG, &ranges[0], 2, MPI_LONG_LONG,
+		 comm);
+
+  // Every process needs the mirror of each of its bins. Whoever holds
+  // bin N/2-1 also unpacks the Nyquist bin, N/2.
+  std::vector < ptrdiff_t > needed_end (size);
+  for (int r = 0; r < size; r++)
+    needed_end[r] = ((ranges[2 * r + 1] == complex_length) &&
+		     (ranges[2 * r + 1] > ranges[2 * r])) ?
+      complex_length + 1 : ranges[2 * r + 1];
+  ptrdiff_t my_start = local_o_start, my_end = needed_end[rank];
+
+  // Gather the mirror bins we own for everybody who needs them,
+  // in the order they need them.
+  std::vector < complex > send_bins;
+  std::vector < int >
+  send_counts (size),
+  send_displs (size),
+  recv_counts (size),
+  recv_displs (size);
+  std::vector < ptrdiff_t > bins;
+  for (int r = 0; r < size; r++)
+    {
+      bins.clear ();
+      mirror_bins (ranges[2 * r], needed_end[r], my_start,
+		   local_o_start + local_no, complex_length, bins);
+      send_displs[r] = 2 * send_bins.size ();
+      send_counts[r] = 2 * bins.size ();
+      for (size_t ix = 0; ix < bins.size (); ix++)
+	send_bins.push_back (transformed_data_array
+			     [(complex_length - bins[ix]) % complex_length -
+			      my_start]);
+    }
+
+  // Work out what we'll be getting from everybody.
+  size_t received = 0;
+  for (int r = 0; r < size; r++)
+    {
+      bins.clear ();
+      mirror_bins (my_start, my_end, ranges[2 * r], ranges[2 * r + 1],
+		   complex_length, bins);
+      recv_displs[r] = 2 * received;
+      recv_counts[r] = 2 * bins.size ();
+      received += bins.size ();
+    }
+
+  // Swap.
+  std::vector < complex > recv_bins (received + 1);
+  MPI_Alltoallv (send_bins.empty ()? NULL : &send_bins[0],
+		 &send_counts[0], &send_displs[0],
+		 FFTWPrecision < T >::mpi_type (),
+		 &recv_bins[0], &recv_counts[0], &recv_displs[0],
+		 FFTWPrecision < T >::mpi_type (), comm);
+
+  // Put the mirror bins in order.
+  std::vector < complex > mirror (my_end - my_start + 1);
+  received = 0;
+  for (int r = 0; r < size; r++)
+    {
+      bins.clear ();
+      mirror_bins (my_start, my_end, ranges[2 * r], ranges[2 * r + 1],
+		   complex_length, bins);
+      for (size_t ix = 0; ix < bins.size (); ix++)
+	mirror[bins[ix] - my_start] = recv_bins[received++];
+    }
+
+  // With Z the packed DFT, the DFT of the input is
+  // X[k] = (Z[k] + Z*[N/2-k]) / 2 - i * w^k * (Z[k] - Z*[N/2-k]) / 2,
+  // where w = exp(-2 * pi * i / N). Each bin only depends on itself
+  // and its mirror, so we can unpack in place.
+  // The bins are shared out between the threads.
+  double
+    data_points_count = (double) transform_length;
+  ThreadPool::parallel_for (my_end - my_start, MIN_BINS_PER_THREAD,
+			    [&] (size_t first, size_t last)
+    {
+      for (ptrdiff_t k = my_start + first; k < my_start + (ptrdiff_t) last;
+	   k++)
+	{
+
+	  // Bin N/2 is bin 0 all over again.
+	  complex z =
+	    (k == complex_length) ? mirror[k - my_start] :
+	    transformed_data_array[k - my_start];
+	  complex m = mirror[k - my_start];
+	  double
+	    even_re = (z.re + m.re) / 2,
+	    even_im = (z.im - m.im) / 2,
+	    odd_re = (z.im + m.im) / 2,
+	    odd_im = -(z.re - m.re) / 2,
+	    w_re = std::cos (2 * M_PI * (double) k / data_points_count),
+	    w_im = -std::sin (2 * M_PI * (double) k / data_points_count);
+	  transformed_data_array[k - my_start].re =
+	    even_re + w_re * odd_re - w_im * odd_im;
+	  transformed_data_array[k - my_start].im =
+	    even_im + w_re * odd_im + w_im * odd_re;
+	}
+    });
+  first_output_bin = my_start;
+  output_bins_count = my_end - my_start;
+}
+
+// The precisions supported.
+template RealFFT < double >::RealFFT (bool, MPIRFFTWInput < double >&,
+				      const char *, bool, const Padding &);
+template RealFFT < double >::~RealFFT ();
+template void RealFFT < double >::do_transform ();
+template RealFFT < float >::RealFFT (bool, MPIRFFTWInput < float >&,
+				     const char *, bool, const Padding &);
+template RealFFT < float >::~RealFFT ();
+template void RealFFT < float >::do_transform ();
+#endif
@@ -0,0 +1,268 @@
+// Time-stamp: <2026-10-17 12:40:12 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// System includes.
+#include <cerrno>
+#include <algorithm>
+#include <unistd.h>
+
+// Local includes.
+#include "stl_ext.h"
+#include "phase_timer.h"
+#include "wisdom_cache.h"
+#include "segmented_fft.h"
+
+// Plans of this many segment lengths are kept at most, unless more are
+// in use at once. The least recently used plan nobody uses is
+// destroyed to make room for a new one.
+#define MAX_CACHED_PLANS 4
+
+template < typename T > std::map < std::pair < int, int >, typename SegmentedFFT < T >::cached_plan > SegmentedFFT < T >::plan_cache;
+template < typename T > unsigned long long SegmentedFFT < T >::plan_uses = 0;
+
+template < typename T > SegmentedFFT < T >::SegmentedFFT (bool optimal_plan, MPIRFFTWInput < T > &input, const char *import_wisdom_file_name, int length, int overlap, MPI_Comm communicator):
+comm (communicator),
+segment_length (length),
+segment_hop (length - overlap),
+segments_done (0),
+friendly_input (&input), input_data_array (NULL),
+next_input_data_array (NULL), next_segment_pending (false),
+output_data_array (NULL)
+{
+
+  // Time the planning.
+  PhaseTimer timer (PhaseTimer::PLAN);
+
+  // Segments are dealt out round-robin, starting with our rank.
+  int
+    rank;
+  MPI_Comm_rank (comm, &rank);
+  next_segment = rank;
+
+  // Flags for plan creation.
+  int
+    rfftw_plan_flags = 0;
+
+  // Sanity check the segment layout.
+  if ((length < 2) || (overlap < 0) || (overlap >= length))
+    throw
+      SegmentedFFTException (SegmentedFFTException::ESEGMENT,
+			     std::string ("invalid segment length ") +
+			     to_string (length) +
+			     std::string (" with overlap ") +
+			     to_string (overlap));
+  if ((size_t) length > (*friendly_input).total_data_points_count)
+    throw
+      SegmentedFFTException (SegmentedFFTException::ESEGMENT,
+			     std::string ("segment length ") +
+			     to_string (length) +
+			     std::string (" exceeds the ") +
+			     to_string ((*friendly_input).
+					total_data_points_count) +
+			     std::string (" data points available"));
+
+  // Segments that would run past the end of the input are dropped.
+  segments_count =
+    ((*friendly_input).total_data_points_count -
+     segment_length) / segment_hop + 1;
+
+  // Check if we need to import wisdom. The primary process reads it
+  // for everybody.
+  if ((import_wisdom_file_name != NULL) &&
+      !WisdomCache < T >::import_file (import_wisdom_file_name, comm))
+    throw SegmentedFFTException (SegmentedFFTException::EFIO,
+				     std::string ("couldn't open input wisdom file '") +
+				     import_wisdom_file_name +
+				     std::string ("' for import"));
+
+  // If we are creating an optimal (slow creation, fastest transform) plan.
+  if (optimal_plan)
+    rfftw_plan_flags = FFTW_MEASURE;
+  else
+    rfftw_plan_flags = FFTW_ESTIMATE;
+
+  // All arrays hold exactly one segment. Page align them.
+  // They have to exist before the plan is created, as FFTW3 plans
+  // for specific arrays.
+  if ((posix_memalign ((void **) (&input_data_array),
+		       sysconf (_SC_PAGESIZE),
+		       sizeof (T) * segment_length) == ENOMEM) ||
+      (posix_memalign ((void **) (&next_input_data_array),
+		       sysconf (_SC_PAGESIZE),
+		       sizeof (T) * segment_length) == ENOMEM) ||
+      (posix_memalign ((void **) (&output_data_array),
+		       sysconf (_SC_PAGESIZE),
+		       sizeof (T) * segment_length) == ENOMEM))
+    throw
+      SegmentedFFTException (SegmentedFFTException::EMEM,
+			     std::string ("couldn't allocate segment arrays of ")
+			     + to_string (segment_length) +
+			     std::string (" data points. Use a shorter segment"));
+
+  // Reuse a plan of the same length if we have one already.
+  plan_key = std::make_pair (segment_length, rfftw_plan_flags);
+  if (plan_cache.count (plan_key) != 0)
+    myplan = plan_cache[plan_key].plan;
+  else
+    {
+
+      // Make room by destroying the least recently used plan nobody
+      // uses, if there is one.
+      if (plan_cache.size () >= MAX_CACHED_PLANS)
+	{
+	  typename std::map < std::pair < int, int >,
+	    cached_plan >::iterator ix, oldest = plan_cache.end ();
+	  for (ix = plan_cache.begin (); ix != plan_cache.end (); ix++)
+	    if ((ix->second.users == 0) &&
+		((oldest == plan_cache.end ()) ||
+		 (ix->second.last_use < oldest->second.last_use)))
+	      oldest = ix;
+	  if (oldest != plan_cache.end ())
+	    {
+#ifdef HAVE_FFTW3
+	      FFTWPrecision < T >::destroy_plan (oldest->second.plan);
+#else
+	      rfftw_destroy_plan (oldest->second.plan);
+#endif
+	      plan_cache.erase (oldest);
+	    }
+	}
+
+      // Create a forward one-dimensional local real-to-halfcomplex plan.
+      // The very same plan is reused for every segment.
+#ifdef HAVE_FFTW3
+      myplan = FFTWPrecision < T >::plan_r2r_1d (segment_length,
+						 input_data_array,
+						 output_data_array,
+						 FFTW_R2HC, rfftw_plan_flags);
+#else
+      myplan = rfftw_create_plan (segment_length,
+				  FFTW_REAL_TO_COMPLEX,
+				  rfftw_plan_flags | FFTW_USE_WISDOM);
+#endif
+
+      // Check if we actually created the plan.
+      if (myplan == NULL)
+	throw
+	  SegmentedFFTException (SegmentedFFTException::EPLAN,
+				 std::string ("plan creation failed :-(("));
+      plan_cache[plan_key].plan = myplan;
+      plan_cache[plan_key].users = 0;
+    }
+  plan_cache[plan_key].users++;
+  plan_cache[plan_key].last_use = ++plan_uses;
+}
+
+template < typename T > SegmentedFFT < T >::~SegmentedFFT ()
+{
+
+  // The plan stays in plan_cache, but may be destroyed once nobody
+  // uses it. The next segment may still be on its way in if we were
+  // given up on.
+  plan_cache[plan_key].users--;
+  if (next_segment_pending)
+    (*friendly_input).cancel_read ();
+  free (input_data_array);
+  free (next_input_data_array);
+  free (output_data_array);
+}
+
+template < typename T > void
+SegmentedFFT < T >::forget_plans ()
+{
+  typename std::map < std::pair < int, int >, cached_plan >::iterator ix;
+  for (ix = plan_cache.begin (); ix != plan_cache.end ();)
+    if (ix->second.users == 0)
+      {
+#ifdef HAVE_FFTW3
+	FFTWPrecision < T >::destroy_plan (ix->second.plan);
+#else
+	rfftw_destroy_plan (ix->second.plan);
+#endif
+	plan_cache.erase (ix++);
+      }
+    else
+      ix++;
+}
+
+template < typename T > void
+SegmentedFFT < T >::export_wisdom (const char *export_wisdom_file_name)
+{
+
+  // Time the export.
+  PhaseTimer timer (PhaseTimer::EXPORT);
+
+  // Only export if we are given a file name.
+  if (export_wisdom_file_name != NULL)
+    {
+
+      // Write the wisdom out.
+      if (!WisdomCache < T >::export_file (export_wisdom_file_name))
+	throw SegmentedFFTException (SegmentedFFTException::EFIO,
+				     std::string ("couldn't open output wisdom file '") +
+				     std::string (export_wisdom_file_name) +
+				     std::string ("' for export"));
+    }
+}
+
+template < typename T > bool
+SegmentedFFT < T >::do_transform ()
+{
+
+  // Time the transform.
+  PhaseTimer timer (PhaseTimer::TRANSFORM);
+
+  // Are we out of segments?
+  if (next_segment >= segments_count)
+    return false;
+
+  // Read in the segment, unless it was read while the last one was
+  // transformed...
+  if (!next_segment_pending)
+    (*friendly_input).start_segment ((size_t) next_segment * segment_hop,
+				     segment_length, input_data_array);
+  (*friendly_input).finish_segment ();
+
+  // ...start reading the next one, segments being dealt out
+  // round-robin...
+  int
+    size;
+  MPI_Comm_size (comm, &size);
+  next_segment += size;
+  segments_done++;
+  next_segment_pending = (next_segment < segments_count);
+  if (next_segment_pending)
+    (*friendly_input).start_segment ((size_t) next_segment * segment_hop,
+				     segment_length, next_input_data_array);
+
+  // ...and transform this one. A cached FFTW3 plan may have been
+  // created for other arrays, but those are page aligned just the same.
+#ifdef HAVE_FFTW3
+  FFTWPrecision < T >::execute_r2r (myplan, input_data_array,
+				     output_data_array);
+#else
+  rfftw_one (myplan, input_data_array, output_data_array);
+#endif
+  std::swap (input_data_array, next_input_data_array);
+  return true;
+}
+
+// The precisions supported.
+template class SegmentedFFT < double >;
+#ifdef HAVE_SINGLE_PRECISION
+template class SegmentedFFT < float >;
+#endif
@@ -0,0 +1,176 @@
+// Time-stamp: <2026-10-17 12:40:12 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef SEGMENTED_FFT_H
+#define SEGMENTED_FFT_H
+
+// System includes.
+#include <mpi.h>
+#include <cstdio>
+#include <string>
+#include <cstddef>
+#include <map>
+#include <utility>
+
+// Local includes.
+#include "fft_backend.h"
+#include "ps_generator.h"
+#include "mpirfftw_input.h"
+#include "generic_exception.h"
+
+// Forward declaration.
+template < typename T > class PSGenerator;
+template < typename T > class MPIRFFTWInput;
+
+class SegmentedFFTException:public GenericException
+{
+public:
+
+  // Error types thrown.
+  typedef enum
+  {
+
+    // File I/O error.
+    EFIO,
+
+    // Plan creation error.
+    EPLAN,
+
+    // Bad segment length or overlap.
+    ESEGMENT,
+
+    // Failure in memory allocation.
+    EMEM
+  } error_t;
+private:
+
+  // Error code associated with the exception.
+    error_t error_code;
+public:
+
+  // Constructor used for creation of object.
+    SegmentedFFTException (error_t err,
+			   const std::
+			   string & aux_err):GenericException (aux_err),
+    error_code (err)
+  {
+  }
+
+  // Returns the error code association with the exception.
+  error_t get_error_code () const
+  {
+    return error_code;
+  }
+};
+
+// Transforms the input as a series of overlapping segments of fixed
+// length (Welch's method), instead of as one transform spanning the
+// whole file. Segments are dealt out round-robin to the processes in the
+// communicator, and each process runs every one of its segments through
+// the same local (non-MPI) plan. Memory use is thus bounded by the
+// segment length rather than the input length. Data points are of
+// type T, float or double.
+template < typename T > class SegmentedFFT
+{
+private:
+
+  // We're friends with PSGenerator.
+  friend class PSGenerator < T >;
+
+  // A local real-to-halfcomplex plan.
+  typedef typename FFTWPrecision < T >::plan local_plan;
+
+  // A cached plan, how many objects are using it, and when it was
+  // last handed out, counting plans handed out.
+  typedef struct
+  {
+    local_plan plan;
+    int users;
+    unsigned long long last_use;
+  } cached_plan;
+
+  // Plans created so far, keyed by segment length and plan flags, and
+  // the number of plans handed out. Plans outlive the objects that
+  // created them, so that processing many inputs of the same length
+  // only plans once. Only a few plans nobody uses are kept, so that
+  // inputs of many lengths don't pile up plans.
+  static std::map < std::pair < int, int >, cached_plan > plan_cache;
+  static unsigned long long plan_uses;
+
+  // Plan. Created once, used for every segment.
+  local_plan myplan;
+
+  // Key of the plan in plan_cache.
+  std::pair < int, int > plan_key;
+
+  // Communicator the segments are dealt out over.
+  MPI_Comm comm;
+
+  // Length of each segment in Ts.
+  int segment_length;
+
+  // Distance between the starts of consecutive segments in Ts.
+  int segment_hop;
+
+  // Total number of segments in the input, across all processes.
+  size_t segments_count;
+
+  // Index of the next segment this process will transform.
+  size_t next_segment;
+
+  // Number of segments this process has transformed so far.
+  size_t segments_done;
+
+  // Pointer to the class friend object.
+  MPIRFFTWInput < T > *friendly_input;
+
+  // Array to hold the current segment, and the next one, which is
+  // read into it while the current one is transformed.
+  T *input_data_array;
+  T *next_input_data_array;
+
+  // Is the next segment being read already?
+  bool next_segment_pending;
+
+  // Array to hold the transformed segment, in RFFTW halfcomplex order.
+  T *output_data_array;
+public:
+
+  // Constructor. Arguments as for RealFFT, plus the length of each
+  // segment and the number of points shared by consecutive segments.
+  // Pass MPI_COMM_SELF as comm to have this process transform all
+  // segments on its own.
+    SegmentedFFT (bool optimal_plan,
+		  MPIRFFTWInput < T > &input,
+		  const char *import_wisdom_file_name,
+		  int length, int overlap, MPI_Comm comm = MPI_COMM_WORLD);
+
+  // Destructor.
+   ~SegmentedFFT ();
+
+  // Destroys all cached plans no object is using.
+  static void forget_plans ();
+
+  // Exports wisdom to file, as long as the file name isn't a NULL pointer.
+  void export_wisdom (const char *export_wisdom_file_name);
+
+  // Reads and transforms the next segment belonging to this process,
+  // and starts reading the one after it. Returns false once there are
+  // no more segments left.
+  bool do_transform ();
+};
+#endif
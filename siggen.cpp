@@ -0,0 +1,256 @@
+// Time-stamp: <2026-10-17 15:02:19 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// Writes synthetic captures for pstool to chew on: tones plus Gaussian
+// noise. The noise comes from a fixed generator seeded on the command
+// line, and is turned into a normal distribution here rather than by
+// the C++ library, so that the same command line writes the same file
+// anywhere.
+
+// System includes.
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <iostream>
+#include <getopt.h>
+
+// Number of data points written at a time.
+#define CHUNK_POINTS 65536
+
+// Long options without a short equivalent.
+enum
+{
+  OPT_TYPE = 256
+};
+
+static struct option long_options[] = {
+  {"type", required_argument, NULL, OPT_TYPE},
+  {NULL, 0, NULL, 0}
+};
+
+// A tone, of frequency (in Hz) and amplitude.
+typedef struct
+{
+  double frequency;
+  double amplitude;
+} tone;
+
+// Parses a count, optionally followed by K, M or G (powers of 1024),
+// into count. Returns false if spec isn't one.
+static bool
+parse_count (const char *spec, unsigned long long &count)
+{
+  char *strtol_end;
+  count = std::strtoull (spec, &strtol_end, 10);
+  int shift = 0;
+  if ((*strtol_end != '\0') && (strtol_end[1] == '\0'))
+    {
+      std::string units ("KMG");
+      size_t unit = units.find (*strtol_end);
+      if (unit != std::string::npos)
+	{
+	  shift = 10 * (int) (unit + 1);
+	  strtol_end++;
+	}
+    }
+  if ((*spec == '\0') || (*spec == '-') || (*strtol_end != '\0') ||
+      (count == 0) || (count > (ULLONG_MAX >> shift)))
+    return false;
+  count <<= shift;
+  return true;
+}
+
+// Returns the next of a sequence of normally distributed numbers with
+// zero mean and unit variance, by the Box-Muller transform.
+static double
+next_normal (std::mt19937_64 & generator)
+{
+  static bool have_spare = false;
+  static double spare;
+  if (have_spare)
+    {
+      have_spare = false;
+      return spare;
+    }
+
+  // Two uniformly distributed numbers in (0, 1].
+  double u1 = ((generator () >> 11) + 1) * (1.0 / 9007199254740992.0);
+  double u2 = ((generator () >> 11) + 1) * (1.0 / 9007199254740992.0);
+  double radius = std::sqrt (-2 * std::log (u1));
+  spare = radius * std::sin (2 * M_PI * u2);
+  have_spare = true;
+  return radius * std::cos (2 * M_PI * u2);
+}
+
+int
+main (int argc, char **argv)
+{
+  int c;
+  char *strtol_end;
+  opterr = 0;
+  unsigned long long count = 0;	// Number of data points to write.
+  unsigned long long seed = 1;	// Seed of the noise.
+  double sample_rate = 1,	// Sample rate (in Hz).
+    noise = 1;			// RMS of the noise.
+  bool help_flag = false,	// Show help information?
+    single_precision = false;	// Write floats rather than doubles?
+  const char *output_file_name = NULL;	// Output data file name.
+  std::vector < tone > tones;	// Tones to add up.
+
+  // Get command line parameters.
+  while ((c = getopt_long (argc, argv, "hn:N:o:s:S:t:", long_options,
+			   NULL)) != -1)
+    switch (c)
+      {
+      case 'h':
+	help_flag = true;
+	break;
+      case 'n':
+	if (!parse_count (optarg, count))
+	  help_flag = true;
+	break;
+      case 'N':
+	noise = std::strtod (optarg, &strtol_end);
+	if ((*optarg == '\0') || (*strtol_end != '\0') || !(noise >= 0))
+	  help_flag = true;
+	break;
+      case 'o':
+	output_file_name = optarg;
+	break;
+      case 's':
+	sample_rate = std::strtod (optarg, &strtol_end);
+	if ((*optarg == '\0') || (*strtol_end != '\0') || !(sample_rate > 0))
+	  help_flag = true;
+	break;
+      case 'S':
+	seed = std::strtoull (optarg, &strtol_end, 10);
+	if ((*optarg == '\0') || (*strtol_end != '\0'))
+	  help_flag = true;
+	break;
+      case 't':
+	{
+
+	  // A tone is given as <frequency>:<amplitude>.
+	  tone new_tone;
+	  new_tone.frequency = std::strtod (optarg, &strtol_end);
+	  if ((strtol_end == optarg) || (*strtol_end != ':'))
+	    {
+	      help_flag = true;
+	      break;
+	    }
+	  const char *amplitude_start = strtol_end + 1;
+	  new_tone.amplitude = std::strtod (amplitude_start, &strtol_end);
+	  if ((*amplitude_start == '\0') || (*strtol_end != '\0'))
+	    help_flag = true;
+	  tones.push_back (new_tone);
+	}
+	break;
+      case OPT_TYPE:
+	if (strcmp (optarg, "f32") == 0)
+	  single_precision = true;
+	else if (strcmp (optarg, "f64") == 0)
+	  single_precision = false;
+	else
+	  help_flag = true;
+	break;
+      default:
+	help_flag = true;
+	break;
+      }
+  if ((count == 0) || (output_file_name == NULL))
+    help_flag = true;
+  if (help_flag)
+    {
+      std::cerr << "Usage: " << argv[0]
+	<< " -n <count> -o <file> [-h] [-N <noise>] [-s <sample rate>] [-S <seed>] [-t <frequency>:<amplitude>]... [--type=<type>]"
+	<< std::endl
+	<< "\t-n\t- Write <count> (suffixed K, M or G) data points." << std::endl
+	<< "\t-o\t- Set output data file name to <file>." << std::endl
+	<< "\t-h\t- Show this helpful information." << std::endl
+	<< "\t-N\t- Add Gaussian noise of RMS <noise>. 1 by default." <<
+	std::endl << "\t-s\t- Set sample rate to <sample rate> Hz. 1 by default."
+	<< std::endl << "\t-S\t- Seed the noise with <seed>. 1 by default." <<
+	std::endl <<
+	"\t-t\t- Add a sine of <frequency> Hz and <amplitude>. May be repeated."
+	<< std::endl <<
+	"\t--type\t- Write f64 (default) or f32 floating point numbers." <<
+	std::endl;
+      return EXIT_FAILURE;
+    }
+
+  // Open the output file.
+  FILE *output_file = fopen (output_file_name, "wb");
+  if (output_file == NULL)
+    {
+      std::cerr << "ERROR: couldn't open output data file '" <<
+	output_file_name << "' for writing." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+  // Write out a chunk at a time. The phase of each tone is worked out
+  // from the index of the data point, modulo a period, so that it
+  // doesn't drift over billions of data points.
+  std::mt19937_64 generator (seed);
+  std::vector < double >chunk (CHUNK_POINTS);
+  std::vector < float >float_chunk (CHUNK_POINTS);
+  for (unsigned long long first = 0; first < count; first += CHUNK_POINTS)
+    {
+      size_t points = (size_t) std::min ((unsigned long long) CHUNK_POINTS,
+					 count - first);
+      for (size_t ix = 0; ix < points; ix++)
+	{
+	  double value = noise * next_normal (generator);
+	  for (size_t tone_ix = 0; tone_ix < tones.size (); tone_ix++)
+	    value += tones[tone_ix].amplitude *
+	      std::sin (2 * M_PI *
+			std::fmod (tones[tone_ix].frequency *
+				   (double) (first + ix), sample_rate) /
+			sample_rate);
+	  chunk[ix] = value;
+	}
+      size_t written;
+      if (single_precision)
+	{
+	  for (size_t ix = 0; ix < points; ix++)
+	    float_chunk[ix] = (float) chunk[ix];
+	  written = fwrite (&float_chunk[0], sizeof (float), points,
+			    output_file);
+	}
+      else
+	written = fwrite (&chunk[0], sizeof (double), points, output_file);
+      if (written != points)
+	{
+	  std::cerr << "ERROR: couldn't write to output data file '" <<
+	    output_file_name << "'." << std::endl;
+	  fclose (output_file);
+	  return EXIT_FAILURE;
+	}
+    }
+  if (fclose (output_file) != 0)
+    {
+      std::cerr << "ERROR: couldn't write to output data file '" <<
+	output_file_name << "'." << std::endl;
+      return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,306 @@
+// Time-stamp: <2026-10-17 16:52:40 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// System includes.
+#include <cerrno>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+
+// Local includes.
+#include "stl_ext.h"
+#include "phase_timer.h"
+#include "thread_pool.h"
+#include "mpi_output.h"
+#include "power_kernel.h"
+#include "wisdom_cache.h"
+#include "spectrogram.h"
+
+// Frames are transformed in batches of about this many data points.
+#define BATCH_POINTS (1 << 20)
+
+// Not worth a thread of its own for less than this many data points.
+#define MIN_POINTS_PER_THREAD 65536
+
+template < typename T > Spectrogram < T >::Spectrogram (bool optimal_plan, MPIRFFTWInput < T > &input, const char *import_wisdom_file_name, int length, int hop, MPI_Comm communicator):
+batch_plan (NULL), comm (communicator),
+frame_length (length), frame_hop (hop),
+window_mean_square (input.window.mean_square (length)),
+friendly_input (&input), input_data_array (NULL),
+next_input_data_array (NULL), output_data_array (NULL)
+{
+
+  // Time the planning.
+  PhaseTimer timer (PhaseTimer::PLAN);
+
+  // Sanity check the frame layout.
+  if ((length < 2) || (hop < 1))
+    throw SpectrogramException (SpectrogramException::EFRAME,
+				std::string ("invalid frame length ") +
+				to_string (length) +
+				std::string (" with hop ") + to_string (hop));
+  size_t data_points_count = (*friendly_input).total_data_points_count;
+  if ((size_t) length > data_points_count)
+    throw SpectrogramException (SpectrogramException::EFRAME,
+				std::string ("frame length ") +
+				to_string (length) +
+				std::string (" exceeds the ") +
+				to_string (data_points_count) +
+				std::string (" data points available"));
+
+  // Frames that would run past the end of the input are dropped. The
+  // rest are dealt out in contiguous ranges, as evenly as can be.
+  int
+    rank,
+    size;
+  MPI_Comm_rank (comm, &rank);
+  MPI_Comm_size (comm, &size);
+  frames_count = (data_points_count - length) / hop + 1;
+  first_frame = frames_count * rank / size;
+  own_frames_count = frames_count * (rank + 1) / size - first_frame;
+  size_t most_frames = (frames_count + size - 1) / size;
+  batch_frames = (int) std::max ((size_t) 1,
+				 std::min ((size_t) (BATCH_POINTS / length),
+					   most_frames));
+  batches_count = (most_frames + batch_frames - 1) / batch_frames;
+
+  // Check if we need to import wisdom. The primary process reads it
+  // for everybody.
+  if ((import_wisdom_file_name != NULL) &&
+      !WisdomCache < T >::import_file (import_wisdom_file_name, comm))
+    throw SpectrogramException (SpectrogramException::EFIO,
+				std::string ("couldn't open input wisdom file '") +
+				import_wisdom_file_name +
+				std::string ("' for import"));
+
+  // All arrays hold a batch of frames. Page align them. They have to
+  // exist before the plan is created, as FFTW3 plans for specific
+  // arrays, and the input arrays take turns.
+#ifdef HAVE_FFTW3
+  size_t output_length = (size_t) batch_frames * (length / 2 + 1) * 2;
+#else
+  size_t output_length = (size_t) batch_frames * length;
+#endif
+  if ((posix_memalign ((void **) (&input_data_array),
+		       sysconf (_SC_PAGESIZE),
+		       sizeof (T) * batch_frames * length) == ENOMEM) ||
+      (posix_memalign ((void **) (&next_input_data_array),
+		       sysconf (_SC_PAGESIZE),
+		       sizeof (T) * batch_frames * length) == ENOMEM) ||
+      (posix_memalign ((void **) (&output_data_array),
+		       sysconf (_SC_PAGESIZE),
+		       sizeof (T) * output_length) == ENOMEM))
+    throw SpectrogramException (SpectrogramException::EMEM,
+				std::string ("couldn't allocate arrays of ") +
+				to_string (batch_frames) +
+				std::string (" frames. Use a shorter frame"));
+
+  // Create a forward one-dimensional local plan, which transforms a
+  // whole batch at once with FFTW3. FFTW2 plans for a single frame,
+  // and is told how many there are as it transforms.
+  unsigned
+    plan_flags = optimal_plan ? FFTW_MEASURE : FFTW_ESTIMATE;
+#ifdef HAVE_FFTW3
+  batch_plan = FFTWPrecision < T >::plan_many_dft_r2c (length, batch_frames,
+						       input_data_array,
+						       (typename
+							FFTWPrecision < T >::
+							complex *)
+						       output_data_array,
+						       plan_flags);
+#else
+  batch_plan = rfftw_create_plan (length, FFTW_REAL_TO_COMPLEX,
+				  plan_flags | FFTW_USE_WISDOM);
+#endif
+
+  // Check if we actually created the plan.
+  if (batch_plan == NULL)
+    throw SpectrogramException (SpectrogramException::EPLAN,
+				std::string ("plan creation failed :-(("));
+}
+
+template < typename T > Spectrogram < T >::~Spectrogram ()
+{
+  if (batch_plan != NULL)
+#ifdef HAVE_FFTW3
+    FFTWPrecision < T >::destroy_plan (batch_plan);
+#else
+    rfftw_destroy_plan (batch_plan);
+#endif
+  free (input_data_array);
+  free (next_input_data_array);
+  free (output_data_array);
+}
+
+template < typename T > void
+Spectrogram < T >::export_wisdom (const char *export_wisdom_file_name)
+{
+
+  // Time the export.
+  PhaseTimer timer (PhaseTimer::EXPORT);
+
+  // Only export if we are given a file name.
+  if (export_wisdom_file_name != NULL)
+    {
+
+      // Write the wisdom out.
+      if (!WisdomCache < T >::export_file (export_wisdom_file_name))
+	throw SpectrogramException (SpectrogramException::EFIO,
+				    std::string ("couldn't open output wisdom file '") +
+				    std::string (export_wisdom_file_name) +
+				    std::string ("' for export"));
+    }
+}
+
+template < typename T > void
+Spectrogram < T >::find_powers (int frames, double *rows)
+{
+
+  // Time the power spectrum.
+  PhaseTimer timer (PhaseTimer::POWER_SPECTRUM);
+
+  // Normalized as a single segment is by PSGenerator, according to
+  // Parseval's theorem, and for the equivalent noise bandwidth of the
+  // window. The DC component and the Nyquist frequency count once, all
+  // other bins twice.
+  size_t length = frame_length, bins = length / 2 + 1;
+  double scale = 2.0 / ((double) length * window_mean_square);
+  ThreadPool::parallel_for (frames, MIN_POINTS_PER_THREAD / length + 1,
+			    [&] (size_t first, size_t last)
+    {
+      for (size_t frame = first; frame < last; frame++)
+	{
+	  double *row = rows + frame * bins;
+#ifdef HAVE_FFTW3
+	  PowerKernel::magnitudes_squared ((const fft_complex_of < T > *)
+					   output_data_array + frame * bins,
+					   bins, scale, row);
+#else
+
+	  // Halfcomplex order: real parts of bins 0 to length / 2, then
+	  // imaginary parts of bins (length - 1) / 2 down to 1.
+	  const T *out = output_data_array + frame * length;
+	  row[0] = scale * ((double) out[0] * out[0]);
+	  for (size_t ix = 1; ix < bins; ix++)
+	    row[ix] = scale * (((double) out[ix] * out[ix]) +
+			       ((2 * ix < length) ?
+				(double) out[length - ix] * out[length - ix] :
+				0));
+#endif
+	  row[0] /= 2;
+	  if (length % 2 == 0)
+	    row[length / 2] /= 2;
+	}
+    });
+}
+
+template < typename T > void
+Spectrogram < T >::export_spectrogram (const char *export_file_name,
+				       OutputFormat::format_t format,
+				       double sample_rate)
+{
+
+  // Time the export.
+  PhaseTimer timer (PhaseTimer::EXPORT);
+  int
+    rank;
+  MPI_Comm_rank (comm, &rank);
+  size_t bins = frame_length / 2 + 1;
+  size_t row_bytes = bins * sizeof (double);
+
+  // The primary process writes the header.
+  MPIOutput output (export_file_name, comm);
+  output.write ((rank == 0) ?
+		OutputFormat::header (format, "f8", (unsigned) bins,
+				      frame_length, frames_count,
+				      sample_rate,
+				      sample_rate / frame_length) :
+		std::string ());
+
+  // Then everybody reads, transforms and writes out a batch of frames
+  // at a time, straight to where its rows go. Everybody goes through as
+  // many batches, as reading and writing are collective. Each batch is
+  // read while the last one is transformed, and its rows are written
+  // while the next one is, so there are two sets of rows, taking turns.
+  std::vector < double >rows[2];
+  rows[0].resize ((size_t) batch_frames * bins);
+  rows[1].resize ((size_t) batch_frames * bins);
+  size_t frames_done = 0;
+  int frames = (int) std::min ((size_t) batch_frames, own_frames_count);
+  (*friendly_input).start_frames ((frames > 0) ? first_frame * frame_hop :
+				  0, frames, frame_length, frame_hop,
+				  input_data_array);
+  for (size_t batch = 0; batch < batches_count; batch++)
+    {
+      size_t frame = first_frame + frames_done;
+      (*friendly_input).finish_frames ();
+      frames_done += frames;
+      int next_frames = (int) std::min ((size_t) batch_frames,
+					own_frames_count - frames_done);
+      if (batch + 1 < batches_count)
+	(*friendly_input).start_frames ((next_frames > 0) ?
+					(first_frame + frames_done) *
+					frame_hop : 0, next_frames,
+					frame_length, frame_hop,
+					next_input_data_array);
+      std::vector < double >&batch_rows = rows[batch % 2];
+      if (frames > 0)
+	{
+	  {
+
+	    // Time the transform.
+	    PhaseTimer timer (PhaseTimer::TRANSFORM);
+#ifdef HAVE_FFTW3
+	    FFTWPrecision < T >::execute_dft_r2c (batch_plan, input_data_array,
+						  (typename
+						   FFTWPrecision < T >::
+						   complex *)
+						  output_data_array);
+#else
+
+	    // FFTW2 plans may be used by several threads at once.
+	    ThreadPool::parallel_for (frames,
+				      MIN_POINTS_PER_THREAD / frame_length + 1,
+				      [&] (size_t first, size_t last)
+	      {
+		rfftw (batch_plan, (int) (last - first),
+		       input_data_array + first * frame_length, 1,
+		       frame_length,
+		       output_data_array + first * frame_length, 1,
+		       frame_length);
+	      });
+#endif
+	  }
+
+	  // The rows of the batch before last were written by the time
+	  // the last batch started being written.
+	  find_powers (frames, &batch_rows[0]);
+	}
+      output.start_write_at (frame * row_bytes, (const char *) &batch_rows[0],
+			     (size_t) frames * row_bytes);
+      std::swap (input_data_array, next_input_data_array);
+      frames = next_frames;
+    }
+  output.finish_write ();
+  output.skip (frames_count * row_bytes);
+}
+
+// The precisions supported.
+template class Spectrogram < double >;
+#ifdef HAVE_SINGLE_PRECISION
+template class Spectrogram < float >;
+#endif
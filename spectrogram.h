@@ -0,0 +1,157 @@
+// Time-stamp: <2026-10-17 16:31:05 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef SPECTROGRAM_H
+#define SPECTROGRAM_H
+
+// System includes.
+#include <mpi.h>
+#include <string>
+#include <cstddef>
+
+// Local includes.
+#include "fft_backend.h"
+#include "output_format.h"
+#include "mpirfftw_input.h"
+#include "generic_exception.h"
+
+// Forward declaration.
+template < typename T > class MPIRFFTWInput;
+
+// Thrown at Spectrogram errors.
+class SpectrogramException:public GenericException
+{
+public:
+
+  // Error types thrown.
+  typedef enum
+  {
+
+    // File I/O error.
+    EFIO,
+
+    // Plan creation error.
+    EPLAN,
+
+    // Bad frame length or hop.
+    EFRAME,
+
+    // Failure in memory allocation.
+    EMEM
+  } error_t;
+private:
+
+  // Error code associated with the exception.
+    error_t error_code;
+public:
+
+  // Constructor used for creation of object.
+    SpectrogramException (error_t err,
+			  const std::
+			  string & aux_err):GenericException (aux_err),
+    error_code (err)
+  {
+  }
+
+  // Returns the error code association with the exception.
+  error_t get_error_code () const
+  {
+    return error_code;
+  }
+};
+
+// Finds the power spectrum of each of a series of frames of fixed
+// length, hop data points apart, of the input (a short-time Fourier
+// transform, or spectrogram). Each process in the communicator takes a
+// contiguous range of frames, and transforms them a batch at a time
+// through a single local plan, so no data is exchanged between
+// processes but what is written out. Data points are of type T, float
+// or double.
+template < typename T > class Spectrogram
+{
+private:
+
+  // FFTW3 transforms a batch real-to-complex, and FFTW2
+  // real-to-halfcomplex.
+  typedef typename FFTWPrecision < T >::plan local_plan;
+
+  // Plan. Created once, used for every batch.
+  local_plan batch_plan;
+
+  // Communicator the frames are dealt out over.
+  MPI_Comm comm;
+
+  // Length of each frame in Ts, and distance between the starts of
+  // consecutive frames.
+  int frame_length;
+  int frame_hop;
+
+  // Total number of frames in the input, across all processes, and
+  // the first of this process' frames and how many there are.
+  size_t frames_count;
+  size_t first_frame;
+  size_t own_frames_count;
+
+  // Number of frames transformed at once, and number of batches every
+  // process goes through, whether it has frames left or not.
+  int batch_frames;
+  size_t batches_count;
+
+  // Mean square of the window the frames are multiplied by.
+  double window_mean_square;
+
+  // Pointer to the class friend object.
+  MPIRFFTWInput < T > *friendly_input;
+
+  // Arrays to hold a batch of frames, and the next batch, which is
+  // read into it while this one is transformed.
+  T *input_data_array;
+  T *next_input_data_array;
+
+  // Array to hold a batch of transformed frames. Complex numbers with
+  // FFTW3, halfcomplex with FFTW2.
+  T *output_data_array;
+
+  // Sets rows to the power spectrum of each transformed frame of the
+  // batch, frame_length / 2 + 1 bins a frame.
+  void find_powers (int frames, double *rows);
+public:
+
+  // Constructor. Arguments as for RealFFT, plus the length of each
+  // frame and the number of data points from the start of one frame to
+  // the start of the next.
+    Spectrogram (bool optimal_plan, MPIRFFTWInput < T > &input,
+		 const char *import_wisdom_file_name, int length, int hop,
+		 MPI_Comm comm = MPI_COMM_WORLD);
+
+  // Destructor.
+   ~Spectrogram ();
+
+  // Exports wisdom to file, as long as the file name isn't a NULL pointer.
+  void export_wisdom (const char *export_wisdom_file_name);
+
+  // Transforms all frames, and writes their power spectra out to
+  // export_file_name, in a binary format, as a matrix of a row per
+  // frame and a column per bin, with the input sampled at sample_rate
+  // Hz. Each process writes its own rows, at once with the others.
+  // Each batch is read while the one before it is transformed, and
+  // its rows written while the one after it is.
+  void export_spectrogram (const char *export_file_name,
+			   OutputFormat::format_t format,
+			   double sample_rate);
+};
+#endif
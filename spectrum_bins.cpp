@@ -0,0 +1,109 @@
+// Time-stamp: <2026-10-17 15:52:40 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// System includes.
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+
+// Local includes.
+#include "spectrum_bins.h"
+
+bool
+SpectrumBins::parse (const char *spec, SpectrumBins & bins)
+{
+  const char *count_start;
+  if (strncmp (spec, "linear:", 7) == 0)
+    {
+      bins.spacing = LINEAR;
+      count_start = spec + 7;
+    }
+  else if (strncmp (spec, "log:", 4) == 0)
+    {
+      bins.spacing = LOG;
+      count_start = spec + 4;
+    }
+  else
+    return false;
+
+  // Convert from base-10.
+  char *strtol_end;
+  long count = std::strtol (count_start, &strtol_end, 10);
+  if ((*count_start == '\0') || (*strtol_end != '\0') ||
+      (count < 2) || (count > INT_MAX))
+    return false;
+  bins.count = count;
+  return true;
+}
+
+size_t
+SpectrumBins::get_count (size_t data_points_count) const
+{
+  if (spacing == FULL)
+    return data_points_count / 2 + 1;
+  return count;
+}
+
+size_t
+SpectrumBins::first_dft_bin (size_t bin, size_t data_points_count) const
+{
+
+  // Highest DFT bin.
+  size_t highest = data_points_count / 2;
+  size_t first;
+  if (spacing == FULL)
+    return (bin > highest + 1) ? highest + 1 : bin;
+  if (bin >= count)
+    return highest + 1;
+  if (spacing == LINEAR)
+    {
+
+      // The DFT bins at or above the lower edge of bin,
+      // (bin - 1/2) * highest / (count - 1). Done in integers, so
+      // that bins line up exactly when they should.
+      if (bin == 0)
+	return 0;
+      unsigned long long numerator =
+	(unsigned long long) (2 * bin - 1) * highest;
+      unsigned long long denominator = 2ULL * (count - 1);
+      first = (numerator + denominator - 1) / denominator;
+    }
+  else
+    {
+
+      // Same thing, with a lower edge of highest^((bin - 1/2) / (count - 1)).
+      if (bin == 0)
+	return 1;
+      first = (size_t) std::ceil (std::pow ((double) highest,
+					    (bin - 0.5) / (count - 1)));
+      if (first < 1)
+	first = 1;
+    }
+  return (first > highest + 1) ? highest + 1 : first;
+}
+
+double
+SpectrumBins::centre (size_t bin, size_t data_points_count) const
+{
+  size_t highest = data_points_count / 2;
+  if (spacing == FULL)
+    return bin;
+  if (spacing == LINEAR)
+    return bin * (double) highest / (double) (count - 1);
+  return std::pow ((double) highest, (double) bin / (double) (count - 1));
+}
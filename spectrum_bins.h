@@ -0,0 +1,85 @@
+// Time-stamp: <2026-10-17 15:52:40 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef SPECTRUM_BINS_H
+#define SPECTRUM_BINS_H
+
+// System includes.
+#include <cstddef>
+
+// How the bins of a one-sided power spectrum are laid out. Either one
+// bin for each of the bins 0 to H of the DFT, H being the highest
+// frequency bin below or at the Nyquist frequency (the full spectrum),
+// or a fixed number of bins, each integrating the power of a
+// contiguous range of DFT bins.
+//
+// With linear spacing, bin k is centred at k * H / (count - 1) DFT bins
+// and is as wide as that. The first and last bins are half as wide, so
+// that a count of H + 1 gives back the full spectrum.
+//
+// With logarithmic spacing, bin k is centred at H^(k / (count - 1)) DFT
+// bins, and reaches halfway (on a logarithmic scale) to its neighbours.
+// The DC bin has no place on a logarithmic scale, and is left out.
+//
+// Bins narrower than a DFT bin may end up empty.
+class SpectrumBins
+{
+public:
+  typedef enum
+  {
+    FULL,
+    LINEAR,
+    LOG
+  } spacing_t;
+private:
+
+  // Spacing of the bins.
+  spacing_t spacing;
+
+  // Number of bins, unless spacing is FULL.
+  size_t count;
+public:
+
+  // The full spectrum.
+  SpectrumBins ():spacing (FULL), count (0)
+  {
+  }
+
+  // Parses "linear:<count>" or "log:<count>". Returns false if
+  // spec isn't either, or count is less than 2.
+  static bool parse (const char *spec, SpectrumBins & bins);
+
+  // Returns the spacing of the bins.
+  spacing_t get_spacing () const
+  {
+    return spacing;
+  }
+
+  // Returns the number of bins of the spectrum of a transform of
+  // data_points_count data points.
+  size_t get_count (size_t data_points_count) const;
+
+  // Returns the first DFT bin that belongs to bin or any of the bins
+  // after it, for a transform of data_points_count data points. Bin
+  // get_count () is one past the highest DFT bin, so bin k integrates DFT
+  // bins first_dft_bin (k) up to first_dft_bin (k + 1).
+  size_t first_dft_bin (size_t bin, size_t data_points_count) const;
+
+  // Returns the centre of bin, in DFT bins.
+  double centre (size_t bin, size_t data_points_count) const;
+};
+#endif
@@ -0,0 +1,451 @@
+// Time-stamp: <2026-10-17 17:48:31 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// System includes.
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Local includes.
+#include "stl_ext.h"
+#include "phase_timer.h"
+#include "power_kernel.h"
+#include "csv_formatter.h"
+#include "wisdom_cache.h"
+#include "streaming_psd.h"
+
+// The stream is read this many bytes at a time, at most.
+#define READ_CHUNK_SIZE (1 << 16)
+
+template < typename T > StreamingPSD < T >::StreamingPSD (bool optimal_plan, const char *stream_name, const InputType & type, const Window & window, const char *import_wisdom_file_name, int length, int hop, int average_frames, int publish_every, MPI_Comm communicator):
+frame_plan (NULL), comm (communicator), stream_fd (-1),
+standard_input (false), input_type (type), frame_length (length),
+frame_hop (hop), skip_count (0), stream_ended (false),
+input_data_array (NULL), output_data_array (NULL), weights_sum (0),
+frames_count (0), published_frames_count (0)
+{
+
+  // Sanity check the frame layout and averaging.
+  if ((length < 2) || (hop < 1) || (average_frames < 1) ||
+      (publish_every < 1))
+    throw StreamingPSDException (StreamingPSDException::EFRAME,
+				 std::string ("invalid frame length ") +
+				 to_string (length) +
+				 std::string (" with hop ") + to_string (hop) +
+				 std::string (", averaging ") +
+				 to_string (average_frames) +
+				 std::string (" and publishing every ") +
+				 to_string (publish_every));
+  smoothing = 1.0 / average_frames;
+  publish_interval = (size_t) publish_every;
+  taper_table.resize ((size_t) length);
+  for (size_t ix = 0; ix < taper_table.size (); ix++)
+    taper_table[ix] = window.weight (ix, (size_t) length);
+  window_mean_square = window.mean_square ((size_t) length);
+  int
+    rank;
+  MPI_Comm_rank (comm, &rank);
+
+  // The primary process opens the stream, and keeps the spectrum.
+  if (rank == 0)
+    {
+
+      // Time the opening.
+      PhaseTimer timer (PhaseTimer::OPEN);
+      std::string name (stream_name);
+      if (name == "-")
+	{
+	  stream_fd = STDIN_FILENO;
+	  standard_input = true;
+	}
+      else if (name.compare (0, 5, "unix:") == 0)
+	{
+	  struct sockaddr_un address;
+	  memset (&address, 0, sizeof (address));
+	  address.sun_family = AF_UNIX;
+	  if ((name.size () - 5 < sizeof (address.sun_path)) &&
+	      ((stream_fd = socket (AF_UNIX, SOCK_STREAM, 0)) != -1))
+	    {
+	      strcpy (address.sun_path, name.c_str () + 5);
+	      if (connect (stream_fd, (struct sockaddr *) &address,
+			   sizeof (address)) != 0)
+		{
+		  close (stream_fd);
+		  stream_fd = -1;
+		}
+	    }
+	}
+      else
+	stream_fd = open (stream_name, O_RDONLY);
+      if (stream_fd == -1)
+	throw StreamingPSDException (StreamingPSDException::EFIO,
+				     std::string ("couldn't open input stream '")
+				     + name + std::string ("'"));
+      weighted_powers.resize ((size_t) length / 2 + 1);
+    }
+
+  // Time the planning.
+  PhaseTimer timer (PhaseTimer::PLAN);
+
+  // Check if we need to import wisdom. The primary process reads it
+  // for everybody.
+  if ((import_wisdom_file_name != NULL) &&
+      !WisdomCache < T >::import_file (import_wisdom_file_name, comm))
+    throw StreamingPSDException (StreamingPSDException::EFIO,
+				 std::string
+				 ("couldn't open input wisdom file '") +
+				 import_wisdom_file_name +
+				 std::string ("' for import"));
+
+  // Both arrays hold a frame. Page align them. They have to exist
+  // before the plan is created, as FFTW3 plans for specific arrays.
+#ifdef HAVE_FFTW3
+  size_t output_length = ((size_t) length / 2 + 1) * 2;
+#else
+  size_t output_length = (size_t) length;
+#endif
+  if ((posix_memalign ((void **) (&input_data_array),
+		       sysconf (_SC_PAGESIZE),
+		       sizeof (T) * length) == ENOMEM) ||
+      (posix_memalign ((void **) (&output_data_array),
+		       sysconf (_SC_PAGESIZE),
+		       sizeof (T) * output_length) == ENOMEM))
+    throw StreamingPSDException (StreamingPSDException::EMEM,
+				 std::string ("couldn't allocate a frame of ") +
+				 to_string (length) +
+				 std::string (" data points"));
+
+  // Create a forward one-dimensional local plan.
+  unsigned
+    plan_flags = optimal_plan ? FFTW_MEASURE : FFTW_ESTIMATE;
+#ifdef HAVE_FFTW3
+  frame_plan = FFTWPrecision < T >::plan_dft_r2c_1d (length, input_data_array,
+						     (typename
+						      FFTWPrecision < T >::
+						      complex *)
+						     output_data_array,
+						     plan_flags);
+#else
+  frame_plan = rfftw_create_plan (length, FFTW_REAL_TO_COMPLEX,
+				  plan_flags | FFTW_USE_WISDOM);
+#endif
+
+  // Check if we actually created the plan.
+  if (frame_plan == NULL)
+    throw StreamingPSDException (StreamingPSDException::EPLAN,
+				 std::string ("plan creation failed :-(("));
+}
+
+template < typename T > StreamingPSD < T >::~StreamingPSD ()
+{
+  if ((stream_fd != -1) && !standard_input)
+    close (stream_fd);
+  if (frame_plan != NULL)
+#ifdef HAVE_FFTW3
+    FFTWPrecision < T >::destroy_plan (frame_plan);
+#else
+    rfftw_destroy_plan (frame_plan);
+#endif
+  free (input_data_array);
+  free (output_data_array);
+}
+
+template < typename T > void
+StreamingPSD < T >::export_wisdom (const char *export_wisdom_file_name)
+{
+
+  // Time the export.
+  PhaseTimer timer (PhaseTimer::EXPORT);
+
+  // Only export if we are given a file name.
+  if (export_wisdom_file_name != NULL)
+    {
+
+      // Write the wisdom out.
+      if (!WisdomCache < T >::export_file (export_wisdom_file_name))
+	throw StreamingPSDException (StreamingPSDException::EFIO,
+				     std::string ("couldn't open output wisdom file '") +
+				     std::string (export_wisdom_file_name) +
+				     std::string ("' for export"));
+    }
+}
+
+template < typename T > void
+StreamingPSD < T >::fill (size_t count)
+{
+  size_t point_size = input_type.get_size ();
+  std::vector < unsigned char >buffer (READ_CHUNK_SIZE);
+  while (!stream_ended && (stream_data.size () < count))
+    {
+
+      // Carry on from whatever part of a data point the last read
+      // ended with. Reads return as soon as there is anything to read,
+      // so frames are transformed as soon as they're complete.
+      size_t carried = partial_data_point.size ();
+      std::copy (partial_data_point.begin (), partial_data_point.end (),
+		 buffer.begin ());
+      ssize_t got = read (stream_fd, &buffer[carried],
+			  buffer.size () - carried);
+      if (got < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  throw StreamingPSDException (StreamingPSDException::EFIO,
+				       std::string
+				       ("couldn't read input stream"));
+	}
+      if (got == 0)
+	{
+	  stream_ended = true;
+	  break;
+	}
+
+      // Convert the whole data points, but those to be skipped.
+      size_t bytes = carried + (size_t) got;
+      size_t points = bytes / point_size;
+      size_t skipped = std::min (points, skip_count);
+      size_t old_size = stream_data.size ();
+      skip_count -= skipped;
+      stream_data.resize (old_size + points - skipped);
+      input_type.decode < T > (&buffer[skipped * point_size],
+			       points - skipped, &stream_data[old_size], 1);
+      partial_data_point.assign (buffer.begin () + points * point_size,
+				 buffer.begin () + bytes);
+    }
+}
+
+template < typename T > void
+StreamingPSD < T >::find_powers (double weight, double *row)
+{
+
+  // Time the power spectrum.
+  PhaseTimer timer (PhaseTimer::POWER_SPECTRUM);
+
+  // Normalized as a single segment is by PSGenerator, according to
+  // Parseval's theorem, and for the equivalent noise bandwidth of the
+  // window. The DC component and the Nyquist frequency count once, all
+  // other bins twice.
+  size_t length = frame_length, bins = length / 2 + 1;
+  double scale = 2.0 * weight / ((double) length * window_mean_square);
+#ifdef HAVE_FFTW3
+  PowerKernel::magnitudes_squared ((const fft_complex_of < T > *)
+				   output_data_array, bins, scale, row);
+#else
+
+  // Halfcomplex order: real parts of bins 0 to length / 2, then
+  // imaginary parts of bins (length - 1) / 2 down to 1.
+  const T *out = output_data_array;
+  row[0] = scale * ((double) out[0] * out[0]);
+  for (size_t ix = 1; ix < bins; ix++)
+    row[ix] = scale * (((double) out[ix] * out[ix]) +
+		       ((2 * ix < length) ?
+			(double) out[length - ix] * out[length - ix] : 0));
+#endif
+  row[0] /= 2;
+  if (length % 2 == 0)
+    row[length / 2] /= 2;
+}
+
+template < typename T > void
+StreamingPSD < T >::publish (const char *export_file_name,
+			     OutputFormat::format_t format,
+			     double sample_rate)
+{
+
+  // Time the export.
+  PhaseTimer timer (PhaseTimer::EXPORT);
+  size_t bins = weighted_powers.size ();
+  double bin_width = sample_rate / frame_length;
+  std::string out;
+  if (format == OutputFormat::CSV)
+    {
+      std::vector < double >pairs (2 * bins);
+      for (size_t ix = 0; ix < bins; ix++)
+	{
+	  pairs[2 * ix] = ix * bin_width;
+	  pairs[2 * ix + 1] = weighted_powers[ix] / weights_sum;
+	}
+      out = "# Hz, J\n";
+      CSVFormatter::append_rows (&pairs[0], bins, out);
+    }
+  else
+    {
+      std::vector < double >powers (bins);
+      for (size_t ix = 0; ix < bins; ix++)
+	powers[ix] = weighted_powers[ix] / weights_sum;
+      out = OutputFormat::header (format, "f8", 1, frame_length, bins,
+				  sample_rate, bin_width);
+      out.append ((const char *) &powers[0], sizeof (double) * bins);
+    }
+
+  // Whoever reads the spectrum sees either the last one or this one in
+  // full, never half of it. Nothing is synced, as a spectrum lost to a
+  // crash is soon replaced.
+  std::string file_name (export_file_name);
+  std::vector < char >temporary_name (file_name.begin (), file_name.end ());
+  const char *suffix = ".XXXXXX";
+  temporary_name.insert (temporary_name.end (), suffix, suffix + 8);
+  int
+    fd = mkstemp (&temporary_name[0]);
+  if (fd == -1)
+    throw StreamingPSDException (StreamingPSDException::EFIO,
+				 std::string ("couldn't create a file next to '")
+				 + file_name + std::string ("'"));
+  bool written = (fchmod (fd, 0644) == 0);
+  for (size_t done = 0; written && (done < out.size ());)
+    {
+      ssize_t wrote = write (fd, out.data () + done, out.size () - done);
+      if (wrote > 0)
+	done += (size_t) wrote;
+      else if ((wrote < 0) && (errno != EINTR))
+	written = false;
+    }
+  if ((close (fd) != 0) || !written ||
+      (rename (&temporary_name[0], file_name.c_str ()) != 0))
+    {
+      unlink (&temporary_name[0]);
+      throw StreamingPSDException (StreamingPSDException::EFIO,
+				   std::string ("couldn't write output file '") +
+				   file_name + std::string ("'"));
+    }
+  published_frames_count = frames_count;
+}
+
+template < typename T > size_t
+StreamingPSD < T >::run (const char *export_file_name,
+			 OutputFormat::format_t format, double sample_rate)
+{
+  int
+    rank,
+    size;
+  MPI_Comm_rank (comm, &rank);
+  MPI_Comm_size (comm, &size);
+  size_t length = frame_length, bins = length / 2 + 1;
+  std::vector < T > round_data ((rank == 0) ? (size_t) size * length : 0);
+  std::vector < double >powers (bins);
+  std::vector < double >round_powers ((rank == 0) ? bins : 0);
+  for (;;)
+    {
+
+      // The primary process waits for the frames of a round, one for
+      // each process, but rounds end where the spectrum is due to be
+      // published. A round is cut short when the stream ends.
+      int
+	round_frames = 0;
+      if (rank == 0)
+	{
+
+	  // Time the reading.
+	  PhaseTimer timer (PhaseTimer::READ);
+	  size_t due = publish_interval - frames_count % publish_interval;
+	  size_t wanted = std::min ((size_t) size, due);
+	  fill ((wanted - 1) * frame_hop + length);
+	  if (stream_data.size () >= length)
+	    round_frames = (int) std::min (wanted,
+					   (stream_data.size () - length) /
+					   frame_hop + 1);
+
+	  // Window the frames as they are handed out.
+	  for (int frame = 0; frame < round_frames; frame++)
+	    {
+	      const T *src = &stream_data[(size_t) frame * frame_hop];
+	      T *dest = &round_data[(size_t) frame * length];
+	      for (size_t ix = 0; ix < length; ix++)
+		dest[ix] = (T) (src[ix] * taper_table[ix]);
+	    }
+
+	  // Keep only what the next frame starts with.
+	  size_t consumed = (size_t) round_frames * frame_hop;
+	  if (consumed >= stream_data.size ())
+	    {
+	      skip_count += consumed - stream_data.size ();
+	      stream_data.clear ();
+	    }
+	  else
+	    stream_data.erase (stream_data.begin (),
+			       stream_data.begin () + consumed);
+	}
+      MPI_Bcast (&round_frames, 1, MPI_INT, 0, comm);
+      if (round_frames == 0)
+	break;
+      MPI_Scatter ((rank == 0) ? &round_data[0] : NULL, frame_length,
+		   FFTWPrecision < T >::mpi_type (), input_data_array,
+		   frame_length, FFTWPrecision < T >::mpi_type (), 0, comm);
+
+      // Frame ix of the n in the round is weighed by
+      // smoothing * (1 - smoothing)^(n - 1 - ix), as if the frames had
+      // been averaged in one at a time.
+      if (rank < round_frames)
+	{
+	  {
+
+	    // Time the transform.
+	    PhaseTimer timer (PhaseTimer::TRANSFORM);
+#ifdef HAVE_FFTW3
+	    FFTWPrecision < T >::execute (frame_plan);
+#else
+	    rfftw_one (frame_plan, input_data_array, output_data_array);
+#endif
+	  }
+	  find_powers (smoothing *
+		       std::pow (1 - smoothing, round_frames - 1 - rank),
+		       &powers[0]);
+	}
+      else
+	std::fill (powers.begin (), powers.end (), 0.0);
+      MPI_Reduce (&powers[0], (rank == 0) ? &round_powers[0] : NULL,
+		  (int) bins, MPI_DOUBLE, MPI_SUM, 0, comm);
+      frames_count += round_frames;
+
+      // Decay the average by the weight of the round, and add it in.
+      if (rank == 0)
+	{
+	  double decay = std::pow (1 - smoothing, round_frames);
+	  for (size_t ix = 0; ix < bins; ix++)
+	    weighted_powers[ix] = decay * weighted_powers[ix] +
+	      round_powers[ix];
+	  weights_sum = decay * weights_sum + (1 - decay);
+	  if (frames_count % publish_interval == 0)
+	    publish (export_file_name, format, sample_rate);
+	}
+    }
+
+  // A stream too short for a single frame has no spectrum.
+  if (frames_count == 0)
+    throw StreamingPSDException (StreamingPSDException::EFRAME,
+				 std::string
+				 ("input stream ended before its first frame of ")
+				 + to_string (frame_length) +
+				 std::string (" data points"));
+
+  // Publish whatever frames came after the last publication.
+  if ((rank == 0) && (published_frames_count != frames_count))
+    publish (export_file_name, format, sample_rate);
+  return frames_count;
+}
+
+// The precisions supported.
+template class StreamingPSD < double >;
+#ifdef HAVE_SINGLE_PRECISION
+template class StreamingPSD < float >;
+#endif
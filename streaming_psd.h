@@ -0,0 +1,197 @@
+// Time-stamp: <2026-10-17 17:20:12 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef STREAMING_PSD_H
+#define STREAMING_PSD_H
+
+// System includes.
+#include <mpi.h>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Local includes.
+#include "fft_backend.h"
+#include "input_type.h"
+#include "window.h"
+#include "output_format.h"
+#include "generic_exception.h"
+
+// Thrown at StreamingPSD errors.
+class StreamingPSDException:public GenericException
+{
+public:
+
+  // Error types thrown.
+  typedef enum
+  {
+
+    // File I/O error.
+    EFIO,
+
+    // Plan creation error.
+    EPLAN,
+
+    // Bad frame length, hop, averaging or publishing interval.
+    EFRAME,
+
+    // Failure in memory allocation.
+    EMEM
+  } error_t;
+private:
+
+  // Error code associated with the exception.
+    error_t error_code;
+public:
+
+  // Constructor used for creation of object.
+    StreamingPSDException (error_t err,
+			   const std::
+			   string & aux_err):GenericException (aux_err),
+    error_code (err)
+  {
+  }
+
+  // Returns the error code association with the exception.
+  error_t get_error_code () const
+  {
+    return error_code;
+  }
+};
+
+// Keeps a running power spectrum of data points of type T, float or
+// double, read as they arrive from a stream: standard input, a FIFO or
+// a UNIX domain socket. The stream is cut into frames of fixed length,
+// hop data points apart, and the power spectra of the frames are
+// averaged with exponentially decaying weights, so that the spectrum
+// follows the stream. Only the primary process reads the stream. It
+// hands out a round of consecutive frames, one to each process, and
+// the weighted spectra of the round are summed back onto it.
+template < typename T > class StreamingPSD
+{
+private:
+
+  // FFTW3 transforms a frame real-to-complex, and FFTW2
+  // real-to-halfcomplex.
+  typedef typename FFTWPrecision < T >::plan local_plan;
+
+  // Plan. Created once, used for every frame.
+  local_plan frame_plan;
+
+  // Communicator the frames are dealt out over.
+  MPI_Comm comm;
+
+  // File descriptor of the stream on the primary process, -1 elsewhere
+  // or once it's closed.
+  int stream_fd;
+
+  // Is the stream standard input, which we didn't open and don't close?
+  bool standard_input;
+
+  // How the data points are stored in the stream.
+  InputType input_type;
+
+  // Length of each frame in Ts, and distance between the starts of
+  // consecutive frames.
+  int frame_length;
+  int frame_hop;
+
+  // Weight of each new frame in the average, and number of frames
+  // between publications of the spectrum.
+  double smoothing;
+  size_t publish_interval;
+
+  // Weights of the window each frame is multiplied by, and their mean
+  // square.
+  std::vector < double >taper_table;
+  double window_mean_square;
+
+  // Bytes read from the stream that don't make up a whole data point
+  // yet. Primary process only.
+  std::vector < unsigned char >partial_data_point;
+
+  // Data points read from the stream, starting with the first of the
+  // next frame, and the number of data points still to be skipped
+  // before it, when frames are further apart than they are long.
+  // Primary process only.
+  std::vector < T > stream_data;
+  size_t skip_count;
+
+  // Set once the stream has ended.
+  bool stream_ended;
+
+  // Array to hold this process' frame.
+  T *input_data_array;
+
+  // Array to hold the transformed frame. Complex numbers with FFTW3,
+  // halfcomplex with FFTW2.
+  T *output_data_array;
+
+  // The sum of the weighted power spectra of all frames so far, and the
+  // sum of their weights, which it's divided by, so that the first
+  // frames aren't drowned out by the spectrum starting out at zero.
+  // Primary process only.
+  std::vector < double >weighted_powers;
+  double weights_sum;
+
+  // Number of frames averaged so far, and when the spectrum was last
+  // published.
+  size_t frames_count;
+  size_t published_frames_count;
+
+  // Reads the stream until at least count data points are waiting in
+  // stream_data, or it ends. Primary process only.
+  void fill (size_t count);
+
+  // Sets row to the power spectrum of the transformed frame, multiplied
+  // by weight, frame_length / 2 + 1 bins.
+  void find_powers (double weight, double *row);
+
+  // Writes the averaged spectrum to export_file_name, by writing a
+  // file of its own next to it and renaming that over it. Primary
+  // process only.
+  void publish (const char *export_file_name, OutputFormat::format_t format,
+		double sample_rate);
+public:
+
+  // Constructor. Opens the stream stream_name on the primary process:
+  // "-" for standard input, "unix:<path>" for a UNIX domain socket to
+  // connect to, or the name of anything else that can be read, such as
+  // a FIFO. Frames are length data points long and hop apart, are
+  // multiplied by window, and each new one is given 1 / average_frames
+  // of the weight of the average. The averaged spectrum is published
+  // every publish_every frames. Must be called by every process in comm.
+    StreamingPSD (bool optimal_plan, const char *stream_name,
+		  const InputType & type, const Window & window,
+		  const char *import_wisdom_file_name, int length, int hop,
+		  int average_frames, int publish_every,
+		  MPI_Comm comm = MPI_COMM_WORLD);
+
+  // Destructor.
+   ~StreamingPSD ();
+
+  // Exports wisdom to file, as long as the file name isn't a NULL pointer.
+  void export_wisdom (const char *export_wisdom_file_name);
+
+  // Averages frames until the stream ends, replacing export_file_name
+  // with the averaged spectrum of the input, sampled at sample_rate Hz,
+  // every publish_every frames, and once more at the end. Returns the
+  // number of frames averaged. Must be called by every process in comm.
+  size_t run (const char *export_file_name, OutputFormat::format_t format,
+	      double sample_rate);
+};
+#endif
@@ -0,0 +1,161 @@
+// Time-stamp: <2026-10-17 09:14:27 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// System includes.
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+// Local includes.
+#include "thread_pool.h"
+
+int
+  ThreadPool::threads = 1;
+
+// State shared with the threads. Kept on the heap, and never freed, so
+// that threads still around at exit don't outlive it.
+namespace
+{
+  struct pool_state
+  {
+    std::vector < std::thread > workers;
+    std::mutex lock;
+
+    // Signalled when there's work, or the threads should stop.
+    std::condition_variable work_ready;
+
+    // Signalled when the last chunk of the work is done.
+    std::condition_variable work_done;
+    bool stopping;
+    bool busy;
+
+    // The current work: chunks ranges of per_chunk out of count,
+    // the next one to be handed out, and how many are still being done.
+    const std::function < void (size_t, size_t) > *body;
+    size_t count;
+    size_t per_chunk;
+    size_t chunks;
+    size_t next_chunk;
+    size_t chunks_left;
+
+      pool_state ():stopping (false), busy (false), body (NULL), count (0),
+      per_chunk (0), chunks (0), next_chunk (0), chunks_left (0)
+    {
+    }
+  };
+
+  pool_state *state = new pool_state;
+
+  // Does chunks of the current work until there are none left. Called,
+  // and returns, with the lock held.
+  void do_chunks (std::unique_lock < std::mutex > &held)
+  {
+    while (state->next_chunk < state->chunks)
+      {
+	size_t begin = state->next_chunk * state->per_chunk;
+	size_t end = begin + state->per_chunk;
+	if (end > state->count)
+	  end = state->count;
+	state->next_chunk++;
+	held.unlock ();
+	(*state->body) (begin, end);
+	held.lock ();
+	if (--state->chunks_left == 0)
+	  state->work_done.notify_all ();
+      }
+  }
+
+  // Waits for work and does it, until told to stop.
+  void work ()
+  {
+    std::unique_lock < std::mutex > held (state->lock);
+    for (;;)
+      {
+	while (!state->stopping && (state->next_chunk >= state->chunks))
+	  state->work_ready.wait (held);
+	if (state->stopping)
+	  return;
+	do_chunks (held);
+      }
+  }
+}
+
+void
+ThreadPool::set_threads (int count)
+{
+  if (count < 1)
+    count = 1;
+
+  // Stop the threads there are, if any...
+  {
+    std::lock_guard < std::mutex > held (state->lock);
+    state->stopping = true;
+  }
+  state->work_ready.notify_all ();
+  for (size_t ix = 0; ix < state->workers.size (); ix++)
+    state->workers[ix].join ();
+  state->workers.clear ();
+  state->stopping = false;
+
+  // ...and start as many as asked for.
+  threads = count;
+  for (int ix = 1; ix < threads; ix++)
+    state->workers.push_back (std::thread (work));
+}
+
+void
+ThreadPool::parallel_for (size_t count, size_t min_per_thread,
+			  const std::function < void (size_t,
+						      size_t) > &body)
+{
+
+  // Split the work between as many threads as are worth it.
+  size_t chunks = (min_per_thread > 0) ? count / min_per_thread : count;
+  if (chunks > (size_t) threads)
+    chunks = threads;
+  if (chunks <= 1)
+    {
+      body (0, count);
+      return;
+    }
+
+  // Work handed out by a busy pool's own work is done right away.
+  std::unique_lock < std::mutex > held (state->lock);
+  if (state->busy)
+    {
+      held.unlock ();
+      body (0, count);
+      return;
+    }
+  state->busy = true;
+  state->body = &body;
+  state->count = count;
+  state->per_chunk = (count + chunks - 1) / chunks;
+  state->chunks = (count + state->per_chunk - 1) / state->per_chunk;
+  state->next_chunk = 0;
+  state->chunks_left = state->chunks;
+  state->work_ready.notify_all ();
+
+  // Lend a hand, then wait for the others to finish.
+  do_chunks (held);
+  while (state->chunks_left != 0)
+    state->work_done.wait (held);
+  state->chunks = state->next_chunk = 0;
+  state->body = NULL;
+  state->busy = false;
+}
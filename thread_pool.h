@@ -0,0 +1,57 @@
+// Time-stamp: <2026-10-17 09:14:27 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+// System includes.
+#include <cstddef>
+#include <functional>
+
+// A pool of threads shared by everything a process does in parallel
+// besides the FFTW3 transforms, which come with threads of their own.
+// Only the main thread hands out work, so MPI only needs to be
+// initialized with MPI_THREAD_FUNNELED. Work handed out while the pool
+// is busy is done by the caller alone.
+class ThreadPool
+{
+private:
+
+  // Number of threads, counting the caller.
+  static int threads;
+public:
+
+  // Sets the number of threads to count, counting the caller, starting
+  // or stopping threads as needed. Defaults to one, which has the
+  // caller do all the work. Set back to one to stop all threads before
+  // exiting.
+  static void set_threads (int count);
+
+  // Returns the number of threads, counting the caller.
+  static int get_threads ()
+  {
+    return threads;
+  }
+
+  // Splits [0, count) into consecutive ranges of at least
+  // min_per_thread, one per thread at most, and calls body (begin, end)
+  // for each range in parallel. Returns once all are done.
+  static void parallel_for (size_t count, size_t min_per_thread,
+			    const std::function < void (size_t,
+							size_t) > &body);
+};
+#endif
@@ -0,0 +1,319 @@
+// Time-stamp: <2026-10-17 20:41:08 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// System includes.
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+// Local includes.
+#include "stl_ext.h"
+#include "phase_timer.h"
+#include "thread_pool.h"
+#include "mpi_output.h"
+#include "csv_formatter.h"
+#include "tone_monitor.h"
+
+// Data points read at a time.
+#define BATCH_POINTS (1 << 20)
+
+// Data points the Goertzel recurrence runs over before its sums are
+// added to the DFT. Its rounding errors grow with the square of the
+// number of data points, so it's restarted every block.
+#define GOERTZEL_BLOCK 4096
+
+// Tones run through the recurrence together, which the compiler turns
+// into vector instructions.
+#define TONE_LANES 8
+
+// Returns the fractional part of x, which isn't negative.
+static double
+fraction (double x)
+{
+  return x - std::floor (x);
+}
+
+template < typename T > ToneMonitor < T >::ToneMonitor (MPIRFFTWInput < T > &input, const char *tones_file_name, double rate, MPI_Comm communicator):
+comm (communicator), sample_rate (rate), friendly_input (&input)
+{
+  int
+    rank,
+    size;
+  MPI_Comm_rank (comm, &rank);
+  MPI_Comm_size (comm, &size);
+
+  // The primary process reads the tones for everybody.
+  unsigned long long tones_count = 0;
+  if (rank == 0)
+    {
+      read_tones (tones_file_name);
+      tones_count = frequencies.size ();
+    }
+  MPI_Bcast (&tones_count, 1, MPI_UNSIGNED_LONG_LONG, 0, comm);
+  frequencies.resize (tones_count);
+  MPI_Bcast (&frequencies[0], (int) tones_count, MPI_DOUBLE, 0, comm);
+
+  // Work out the coefficient of each tone.
+  size_t lanes_count = (tones_count + TONE_LANES - 1) / TONE_LANES;
+  cycles.resize (tones_count);
+  coefficients.assign (lanes_count * TONE_LANES, 0);
+  for (size_t tone = 0; tone < tones_count; tone++)
+    {
+      cycles[tone] = frequencies[tone] / sample_rate;
+      coefficients[tone] = 2 * std::cos (2 * M_PI * cycles[tone]);
+    }
+  sums.assign (2 * tones_count, 0);
+
+  // Each process takes a contiguous slice of the input, the first
+  // few one data point more than the rest.
+  size_t data_points_count = (*friendly_input).total_data_points_count;
+  size_t share = data_points_count / size, extra = data_points_count % size;
+  first_data_point = rank * share + std::min ((size_t) rank, extra);
+  local_data_points_count = share + (((size_t) rank < extra) ? 1 : 0);
+}
+
+template < typename T > void
+ToneMonitor < T >::read_tones (const char *tones_file_name)
+{
+  std::ifstream fin (tones_file_name);
+  if (!fin.is_open ())
+    throw ToneMonitorException (ToneMonitorException::EFIO,
+				std::string ("couldn't open tone file '") +
+				std::string (tones_file_name) +
+				std::string ("' for reading"));
+
+  // Parse the tones, line by line.
+  std::string line;
+  size_t line_number = 0;
+  while (std::getline (fin, line))
+    {
+      line_number++;
+      std::istringstream fields (line);
+      std::string first;
+      double frequency;
+      std::string extra;
+
+      // Skip blank lines and comments.
+      if (!(fields >> first) || (first[0] == '#'))
+	continue;
+
+      // Need exactly one frequency, from DC to the Nyquist frequency.
+      std::istringstream number (first);
+      if (!(number >> frequency) || !number.eof () || (fields >> extra) ||
+	  !(frequency >= 0) || (frequency > sample_rate / 2))
+	throw ToneMonitorException (ToneMonitorException::ETONES,
+				    std::string ("tone file '") +
+				    std::string (tones_file_name) +
+				    std::string ("' line ") +
+				    to_string (line_number) +
+				    std::
+				    string
+				    (" isn't a frequency from 0 Hz to the Nyquist frequency"));
+      frequencies.push_back (frequency);
+    }
+  if (frequencies.empty ())
+    throw ToneMonitorException (ToneMonitorException::ETONES,
+				std::string ("tone file '") +
+				std::string (tones_file_name) +
+				std::string ("' lists no tones"));
+}
+
+template < typename T > void
+ToneMonitor < T >::accumulate (const T * src, size_t count, size_t first)
+{
+  size_t tones_count = frequencies.size ();
+  size_t lanes_count = coefficients.size () / TONE_LANES;
+
+  // Each thread takes some lanes of tones, and runs them over a block
+  // of data points at a time, so that the block stays in the cache.
+  ThreadPool::parallel_for (lanes_count, 1,
+			    [&] (size_t first_lane, size_t last_lane)
+    {
+      for (size_t start = 0; start < count; start += GOERTZEL_BLOCK)
+	{
+	  size_t block = std::min ((size_t) GOERTZEL_BLOCK, count - start);
+	  const T *
+	    x = src + start;
+	  for (size_t lane = first_lane; lane < last_lane; lane++)
+	    {
+
+	      // s1 and s2 are the last two values of the recurrence
+	      // s[n] = x[n] + 2 cos (w) s[n - 1] - s[n - 2].
+	      const double *
+		c = &coefficients[lane * TONE_LANES];
+	      double s1[TONE_LANES] = { 0 }, s2[TONE_LANES] = { 0 };
+	      for (size_t ix = 0; ix < block; ix++)
+		{
+		  double point = x[ix];
+		  for (int k = 0; k < TONE_LANES; k++)
+		    {
+		      double s0 = point + c[k] * s1[k] - s2[k];
+		      s2[k] = s1[k];
+		      s1[k] = s0;
+		    }
+		}
+
+	      // s1 - exp (-i w) s2 is the DFT of the block relative to
+	      // its last data point, so it's turned back by the phase of
+	      // that data point before it's added.
+	      for (int k = 0; k < TONE_LANES; k++)
+		{
+		  size_t tone = lane * TONE_LANES + k;
+		  if (tone >= tones_count)
+		    break;
+		  double w = 2 * M_PI * cycles[tone];
+		  double y_re = s1[k] - std::cos (w) * s2[k];
+		  double y_im = std::sin (w) * s2[k];
+		  double phase = -2 * M_PI *
+		    fraction (cycles[tone] *
+			      (double) (first + start + block - 1));
+		  double turn_re = std::cos (phase), turn_im = std::sin (phase);
+		  sums[2 * tone] += y_re * turn_re - y_im * turn_im;
+		  sums[2 * tone + 1] += y_re * turn_im + y_im * turn_re;
+		}
+	    }
+	}
+    });
+}
+
+template < typename T > void
+ToneMonitor < T >::do_monitor ()
+{
+
+  // Everybody goes through as many batches, as reading is collective.
+  unsigned long long
+    batches_count = (local_data_points_count + BATCH_POINTS - 1) /
+    BATCH_POINTS,
+    most_batches;
+  MPI_Allreduce (&batches_count, &most_batches, 1, MPI_UNSIGNED_LONG_LONG,
+		 MPI_MAX, comm);
+  std::vector < T > batches[2];
+  batches[0].resize (BATCH_POINTS);
+  batches[1].resize (BATCH_POINTS);
+
+  // Each batch is read while the last one is summed up.
+  size_t done = 0;
+  int count = (int) std::min ((size_t) BATCH_POINTS, local_data_points_count);
+  if (most_batches > 0)
+    (*friendly_input).start_strided (first_data_point, (count > 0) ? 1 : 0,
+				     count, count, &batches[0][0]);
+  for (size_t batch = 0; batch < most_batches; batch++)
+    {
+      (*friendly_input).finish_strided ();
+      size_t batch_first = first_data_point + done;
+      done += count;
+      int next_count = (int) std::min ((size_t) BATCH_POINTS,
+				       local_data_points_count - done);
+      if (batch + 1 < most_batches)
+	(*friendly_input).start_strided (first_data_point + done,
+					 (next_count > 0) ? 1 : 0,
+					 next_count, next_count,
+					 &batches[(batch + 1) % 2][0]);
+      if (count > 0)
+	{
+
+	  // Time the sums.
+	  PhaseTimer timer (PhaseTimer::TRANSFORM);
+	  accumulate (&batches[batch % 2][0], count, batch_first);
+	}
+      count = next_count;
+    }
+
+  // Time the power.
+  PhaseTimer timer (PhaseTimer::POWER_SPECTRUM);
+
+  // Add up everybody's sums on the primary process.
+  int
+    rank;
+  MPI_Comm_rank (comm, &rank);
+  size_t tones_count = frequencies.size ();
+  std::vector < double >totals (2 * tones_count);
+  MPI_Reduce (&sums[0], &totals[0], (int) (2 * tones_count), MPI_DOUBLE,
+	      MPI_SUM, 0, comm);
+  if (rank != 0)
+    return;
+
+  // Normalized as a bin of the power spectrum of a whole transform at
+  // the same frequency. DC and the Nyquist frequency count once, all
+  // other frequencies twice.
+  size_t data_points_count = (*friendly_input).total_data_points_count;
+  double scale = 2.0 /
+    ((double) data_points_count *
+     (*friendly_input).window.mean_square (data_points_count));
+  powers.resize (tones_count);
+  for (size_t tone = 0; tone < tones_count; tone++)
+    {
+      powers[tone] = scale * (totals[2 * tone] * totals[2 * tone] +
+			      totals[2 * tone + 1] * totals[2 * tone + 1]);
+      if ((frequencies[tone] == 0) ||
+	  (2 * frequencies[tone] == sample_rate))
+	powers[tone] /= 2;
+    }
+}
+
+template < typename T > void
+ToneMonitor < T >::export_powers (const char *export_file_name,
+				  OutputFormat::format_t format)
+{
+
+  // Time the export.
+  PhaseTimer timer (PhaseTimer::EXPORT);
+
+  // Only export if we are given a file name.
+  if (export_file_name == NULL)
+    return;
+
+  // The primary process writes the whole table, as frequency and
+  // power pairs. Tones have no single bin width.
+  int
+    rank;
+  MPI_Comm_rank (comm, &rank);
+  std::string out;
+  if (rank == 0)
+    {
+      size_t tones_count = frequencies.size ();
+      std::vector < double >pairs (2 * tones_count);
+      for (size_t tone = 0; tone < tones_count; tone++)
+	{
+	  pairs[2 * tone] = frequencies[tone];
+	  pairs[2 * tone + 1] = powers[tone];
+	}
+      if (format == OutputFormat::CSV)
+	{
+	  out = "# Hz, J\n";
+	  CSVFormatter::append_rows (&pairs[0], tones_count, out);
+	}
+      else
+	{
+	  out = OutputFormat::header (format, "f8", 2,
+				      (*friendly_input).
+				      total_data_points_count, tones_count,
+				      sample_rate, 0);
+	  out.append ((const char *) &pairs[0],
+		      sizeof (double) * 2 * tones_count);
+	}
+    }
+  MPIOutput output (export_file_name, comm);
+  output.write (out);
+}
+
+// The precisions supported.
+template class ToneMonitor < double >;
+#ifdef HAVE_SINGLE_PRECISION
+template class ToneMonitor < float >;
+#endif
@@ -0,0 +1,146 @@
+// Time-stamp: <2026-10-17 20:14:51 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef TONE_MONITOR_H
+#define TONE_MONITOR_H
+
+// System includes.
+#include <mpi.h>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Local includes.
+#include "output_format.h"
+#include "mpirfftw_input.h"
+#include "generic_exception.h"
+
+// Forward declaration.
+template < typename T > class MPIRFFTWInput;
+
+// Thrown at ToneMonitor errors.
+class ToneMonitorException:public GenericException
+{
+public:
+
+  // Error types thrown.
+  typedef enum
+  {
+
+    // File I/O error.
+    EFIO,
+
+    // Bad tone file.
+    ETONES
+  } error_t;
+private:
+
+  // Error code associated with the exception.
+    error_t error_code;
+public:
+
+  // Constructor used for creation of object.
+    ToneMonitorException (error_t err,
+			  const std::
+			  string & aux_err):GenericException (aux_err),
+    error_code (err)
+  {
+  }
+
+  // Returns the error code association with the exception.
+  error_t get_error_code () const
+  {
+    return error_code;
+  }
+};
+
+// Finds the power of the input at a list of frequencies (tones) alone,
+// with the Goertzel algorithm, rather than transforming it all. Each
+// process reads a contiguous slice of the input, a batch at a time, and
+// sums up the DFT of its slice at every tone, a block of data points
+// and a handful of tones at a time. The sums of all processes are then
+// added up on the primary process, which is all the communication
+// there is. Data points are of type T, float or double.
+template < typename T > class ToneMonitor
+{
+private:
+
+  // Communicator the input is split over.
+  MPI_Comm comm;
+
+  // Sample rate of the input, in Hz.
+  double sample_rate;
+
+  // Frequencies of the tones, in Hz, in the order they were listed.
+  std::vector < double >frequencies;
+
+  // Frequency of each tone in cycles per data point, and the Goertzel
+  // coefficient 2 cos (2 pi f / sample_rate) of each. There are as many
+  // coefficients as tones, rounded up to a whole number of lanes, the
+  // extra ones being 0.
+  std::vector < double >cycles;
+  std::vector < double >coefficients;
+
+  // First data point of this process' slice of the input, and how
+  // many data points there are to it.
+  size_t first_data_point;
+  size_t local_data_points_count;
+
+  // The DFT of this process' slice at each tone, as re, im pairs, and,
+  // on the primary process, the power of the whole input at each tone,
+  // once do_monitor is done.
+  std::vector < double >sums;
+  std::vector < double >powers;
+
+  // Pointer to the class friend object.
+  MPIRFFTWInput < T > *friendly_input;
+
+  // Reads the tones, one frequency (in Hz) per line, from
+  // tones_file_name. Only called by the primary process.
+  void read_tones (const char *tones_file_name);
+
+  // Adds the DFT of count data points of src, the first of which is
+  // data point first of the input, at every tone to sums.
+  void accumulate (const T * src, size_t count, size_t first);
+public:
+
+  // Constructor. The primary process reads the tones from
+  // tones_file_name, and hands them to everybody else. Must be called
+  // by every process in comm.
+    ToneMonitor (MPIRFFTWInput < T > &input, const char *tones_file_name,
+		 double rate, MPI_Comm comm = MPI_COMM_WORLD);
+
+  // Reads this process' slice of the input, a batch at a time, reading
+  // each batch while the one before it is summed up, and finds the
+  // power at each tone on the primary process. Must be called by every
+  // process.
+  void do_monitor ();
+
+  // Writes the frequency and power of each tone out to
+  // export_file_name, as long as the file name isn't a NULL pointer,
+  // normalized as the power spectrum of a whole transform. Must be
+  // called by every process.
+  void export_powers (const char *export_file_name,
+		      OutputFormat::format_t format);
+
+  // Returns the number of tones.
+  size_t get_tones_count () const
+  {
+    return frequencies.size ();
+  }
+};
+#endif
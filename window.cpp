@@ -0,0 +1,204 @@
+// Time-stamp: <2026-10-17 14:11:02 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// System includes.
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+// Local includes.
+#include "window.h"
+
+// Longer windows have their mean square found from this many weights.
+#define MEAN_SQUARE_SAMPLES (1 << 20)
+
+// Cosine sum weights worked out by rotating a phasor start from an
+// exact cosine every this many weights, so rounding errors stay tiny.
+#define ROTATION_BLOCK 1024
+
+namespace
+{
+
+  // Coefficients of the cosine sum windows, padded with zeroes.
+  const double hann_coefficients[] = { 0.5, 0.5, 0, 0, 0 };
+  const double hamming_coefficients[] = { 0.54, 0.46, 0, 0, 0 };
+  const double blackman_harris_coefficients[] =
+    { 0.35875, 0.48829, 0.14128, 0.01168, 0 };
+  const double flattop_coefficients[] =
+    { 0.21557895, 0.41663158, 0.277263158, 0.083578947, 0.006947368 };
+
+  // Returns the modified Bessel function of the first kind of order 0
+  // of x, summing its power series until the terms no longer count.
+  double bessel_i0 (double x)
+  {
+    double sum = 1, term = 1, half_x = x / 2;
+    for (int k = 1; term > 1e-17 * sum; k++)
+      {
+	term *= (half_x / k) * (half_x / k);
+	sum += term;
+      }
+    return sum;
+  }
+}
+
+bool
+Window::parse (const char *spec, Window & window)
+{
+  static const struct
+  {
+    const char *name;
+    shape_t shape;
+  } shapes[] =
+  {
+    {"rectangular", RECTANGULAR},
+    {"hann", HANN},
+    {"hamming", HAMMING},
+    {"blackman-harris", BLACKMAN_HARRIS},
+    {"flattop", FLATTOP}
+  };
+  for (size_t ix = 0; ix < sizeof (shapes) / sizeof (shapes[0]); ix++)
+    if (strcmp (spec, shapes[ix].name) == 0)
+      {
+	window.shape = shapes[ix].shape;
+	return true;
+      }
+
+  // The Kaiser window takes a parameter.
+  if (strncmp (spec, "kaiser:", 7) != 0)
+    return false;
+  char *strtod_end;
+  double beta = std::strtod (spec + 7, &strtod_end);
+  if ((spec[7] == '\0') || (*strtod_end != '\0') || !(beta >= 0) ||
+      (beta > 700))
+    return false;
+  window = kaiser (beta);
+  return true;
+}
+
+Window
+Window::kaiser (double beta)
+{
+  Window window;
+  window.shape = KAISER;
+  window.beta = beta;
+  window.bessel_i0_beta = bessel_i0 (beta);
+  return window;
+}
+
+double
+Window::weight (size_t n, size_t length) const
+{
+  double x = (double) n / (double) length;
+  const double *a;
+  switch (shape)
+    {
+    case RECTANGULAR:
+      return 1;
+    case KAISER:
+      {
+	double y = 2 * x - 1;
+	return bessel_i0 (beta * std::sqrt (1 - y * y)) / bessel_i0_beta;
+      }
+    case HANN:
+      a = hann_coefficients;
+      break;
+    case HAMMING:
+      a = hamming_coefficients;
+      break;
+    case BLACKMAN_HARRIS:
+      a = blackman_harris_coefficients;
+      break;
+    default:
+      a = flattop_coefficients;
+      break;
+    }
+
+  // Sum the cosines, alternating in sign.
+  double angle = 2 * M_PI * x;
+  return a[0] - a[1] * std::cos (angle) + a[2] * std::cos (2 * angle) -
+    a[3] * std::cos (3 * angle) + a[4] * std::cos (4 * angle);
+}
+
+void
+Window::weights (size_t first, size_t count, size_t length,
+		 double *out) const
+{
+  if (shape == RECTANGULAR)
+    {
+      for (size_t ix = 0; ix < count; ix++)
+	out[ix] = 1;
+      return;
+    }
+
+  // Kaiser windows have no cheaper way round the Bessel function.
+  if (shape == KAISER)
+    {
+      for (size_t ix = 0; ix < count; ix++)
+	out[ix] = weight (first + ix, length);
+      return;
+    }
+  const double *a = (shape == HANN) ? hann_coefficients :
+    (shape == HAMMING) ? hamming_coefficients :
+    (shape == BLACKMAN_HARRIS) ? blackman_harris_coefficients :
+    flattop_coefficients;
+
+  // cos (k angle) follows from cos (angle) by the Chebyshev recurrence
+  // cos (k x) = 2 cos (x) cos ((k - 1) x) - cos ((k - 2) x), and the
+  // phasor (cos (angle), sin (angle)) is rotated on by a step a weight.
+  double step = 2 * M_PI / (double) length;
+  double step_re = std::cos (step), step_im = std::sin (step);
+  for (size_t start = 0; start < count; start += ROTATION_BLOCK)
+    {
+      size_t block = count - start;
+      if (block > ROTATION_BLOCK)
+	block = ROTATION_BLOCK;
+      double angle = 2 * M_PI * (double) (first + start) / (double) length;
+      double re = std::cos (angle), im = std::sin (angle);
+      for (size_t ix = 0; ix < block; ix++)
+	{
+	  double cos2 = 2 * re * re - 1;
+	  double cos3 = 2 * re * cos2 - re;
+	  double cos4 = 2 * re * cos3 - cos2;
+	  out[start + ix] = a[0] - a[1] * re + a[2] * cos2 - a[3] * cos3 +
+	    a[4] * cos4;
+	  double next_re = re * step_re - im * step_im;
+	  im = im * step_re + re * step_im;
+	  re = next_re;
+	}
+    }
+}
+
+double
+Window::mean_square (size_t length) const
+{
+  if ((shape == RECTANGULAR) || (length == 0))
+    return 1;
+
+  // The weights of a long window are those of the continuous window
+  // at evenly spaced points, whose mean square hardly changes with
+  // their number past a point, so only so many of them are summed up.
+  size_t samples = length;
+  if (samples > MEAN_SQUARE_SAMPLES)
+    samples = MEAN_SQUARE_SAMPLES;
+  double sum = 0;
+  for (size_t n = 0; n < samples; n++)
+    {
+      double w = weight (n, samples);
+      sum += w * w;
+    }
+  return sum / (double) samples;
+}
@@ -0,0 +1,98 @@
+// Time-stamp: <2026-10-17 14:05:31 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef WINDOW_H
+#define WINDOW_H
+
+// System includes.
+#include <cstddef>
+
+// The window (taper) data points are multiplied by before they are
+// transformed, trading frequency resolution for less leakage of power
+// into far away bins. The windows are periodic, as suits a DFT: data
+// point n of N is multiplied by w (n / N), w being one of
+//
+//   rectangular      1 (no window at all),
+//   hann             a cosine sum, a = 0.5, 0.5,
+//   hamming          a cosine sum, a = 0.54, 0.46,
+//   blackman-harris  a cosine sum, a = 0.35875, 0.48829, 0.14128, 0.01168,
+//   flattop          a cosine sum, a = 0.21557895, 0.41663158,
+//                    0.277263158, 0.083578947, 0.006947368,
+//   kaiser           I0 (beta * sqrt (1 - (2x - 1)^2)) / I0 (beta),
+//
+// where a cosine sum is a0 - a1 cos (2 pi x) + a2 cos (4 pi x) - ...
+class Window
+{
+public:
+  typedef enum
+  {
+    RECTANGULAR,
+    HANN,
+    HAMMING,
+    BLACKMAN_HARRIS,
+    FLATTOP,
+    KAISER
+  } shape_t;
+private:
+
+  // Shape of the window.
+  shape_t shape;
+
+  // Shape parameter of the Kaiser window, and I0 (beta), which its
+  // weights are divided by.
+  double beta;
+  double bessel_i0_beta;
+public:
+
+  // Constructor. No window at all.
+  Window ():shape (RECTANGULAR), beta (0), bessel_i0_beta (1)
+  {
+  }
+
+  // Parses "rectangular", "hann", "hamming", "blackman-harris",
+  // "flattop" or "kaiser:<beta>". Returns false if spec isn't any of
+  // those, or beta is negative or too big for its weights to be worked
+  // out.
+  static bool parse (const char *spec, Window & window);
+
+  // Returns a Kaiser window with shape parameter beta, which mustn't be
+  // negative or too big for its weights to be worked out.
+  static Window kaiser (double beta);
+
+  // Returns the shape of the window.
+  shape_t get_shape () const
+  {
+    return shape;
+  }
+
+  // Returns the weight of data point n of length data points.
+  double weight (size_t n, size_t length) const;
+
+  // Sets out[ix] to the weight of data point first + ix of length data
+  // points, for ix from 0 to count - 1. Cosine sum windows take a few
+  // multiplications a weight, rather than cosines. Kaiser windows still
+  // take a Bessel function series a weight.
+  void weights (size_t first, size_t count, size_t length,
+		double *out) const;
+
+  // Returns the mean of the squared weights of length data points, by
+  // which the power of broadband noise is reduced. Dividing the power
+  // spectrum by it corrects for the equivalent noise bandwidth of the
+  // window.
+  double mean_square (size_t length) const;
+};
+#endif
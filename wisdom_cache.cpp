@@ -0,0 +1,276 @@
+// Time-stamp: <2026-10-17 15:58:03 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// System includes.
+#include <cerrno>
+#include <cstdio>
+#include <climits>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+
+// Local includes.
+#include "stl_ext.h"
+#include "phase_timer.h"
+#include "thread_pool.h"
+#include "wisdom_cache.h"
+
+namespace
+{
+
+  // Hashes text into hash, FNV-1a style.
+  unsigned long long hash_text (const std::string & text,
+				unsigned long long hash)
+  {
+    for (size_t ix = 0; ix < text.size (); ix++)
+      {
+	hash ^= (unsigned char) text[ix];
+	hash *= 1099511628211ULL;
+      }
+    return hash;
+  }
+
+  // Describes the CPUs of this host: the machine type, the model and
+  // features of the first CPU in /proc/cpuinfo, which the others are
+  // taken to share, and how many there are. Hosts without a
+  // /proc/cpuinfo are told apart by name instead.
+  std::string describe_cpus ()
+  {
+    struct utsname host;
+    std::string description;
+    if (uname (&host) == 0)
+      description = std::string (host.machine) + std::string ("\n");
+    std::ifstream cpuinfo ("/proc/cpuinfo");
+    std::string line;
+    bool described = false;
+    while (std::getline (cpuinfo, line) && !line.empty ())
+      {
+	static const char *keys[] = {
+	  "vendor_id", "cpu family", "model", "flags", "CPU implementer",
+	  "CPU architecture", "CPU variant", "CPU part", "Features", "cpu\t"
+	};
+	for (size_t ix = 0; ix < sizeof (keys) / sizeof (keys[0]); ix++)
+	  if (line.compare (0, std::string (keys[ix]).size (), keys[ix]) == 0)
+	    {
+	      description += line + std::string ("\n");
+	      described = true;
+	      break;
+	    }
+      }
+    if (!described)
+      description += std::string (host.nodename) + std::string ("\n");
+    return description + to_string (sysconf (_SC_NPROCESSORS_ONLN));
+  }
+}
+
+template < typename T > bool
+WisdomCache < T >::read_wisdom (const std::string & file_name,
+				MPI_Comm comm, std::string & wisdom)
+{
+  int
+    rank;
+  MPI_Comm_rank (comm, &rank);
+
+  // The primary process reads the file, and tells the others how long
+  // it is, or -1 if it couldn't.
+  long long
+    length = -1;
+  if (rank == 0)
+    {
+      std::ifstream wisdom_file (file_name.c_str ());
+      std::ostringstream contents;
+      if (wisdom_file && (contents << wisdom_file.rdbuf ()))
+	{
+	  wisdom = contents.str ();
+	  length = (wisdom.size () < INT_MAX) ? (long long) wisdom.size () : -1;
+	}
+    }
+  MPI_Bcast (&length, 1, MPI_LONG_LONG, 0, comm);
+  if (length < 0)
+    return false;
+
+  // Then hands the wisdom out.
+  wisdom.resize ((size_t) length);
+  if (length > 0)
+    MPI_Bcast (&wisdom[0], (int) length, MPI_CHAR, 0, comm);
+  return true;
+}
+
+template < typename T > bool
+WisdomCache < T >::import_file (const char *file_name, MPI_Comm comm)
+{
+  std::string wisdom;
+  if (!read_wisdom (file_name, comm, wisdom))
+    return false;
+  FFTWPrecision < T >::import_wisdom_from_string (wisdom.c_str ());
+  return true;
+}
+
+template < typename T > bool
+WisdomCache < T >::export_file (const char *file_name)
+{
+  FILE *wisdom_file = fopen (file_name, "w");
+  if (wisdom_file == NULL)
+    return false;
+  FFTWPrecision < T >::export_wisdom_to_file (wisdom_file);
+  fclose (wisdom_file);
+  return true;
+}
+
+template < typename T > WisdomCache < T >::WisdomCache (const char *directory, const char *kind, size_t points, double limit, MPI_Comm communicator):
+comm (directory != NULL ? communicator : MPI_COMM_NULL), time_limit (limit)
+{
+  if (comm == MPI_COMM_NULL)
+    return;
+
+  // Time the planning.
+  PhaseTimer timer (PhaseTimer::PLAN);
+  int
+    rank,
+    size;
+  MPI_Comm_rank (comm, &rank);
+  MPI_Comm_size (comm, &size);
+
+  // The processes may run on different hosts, so the fingerprint is of
+  // the CPUs of all of them, and the FFTW version.
+  unsigned long long
+    own_fingerprint = hash_text (describe_cpus (), 14695981039346656037ULL);
+  std::vector < unsigned long long >
+  fingerprints ((rank == 0) ? (size_t) size : 1);
+  MPI_Gather (&own_fingerprint, 1, MPI_UNSIGNED_LONG_LONG, &fingerprints[0],
+	      1, MPI_UNSIGNED_LONG_LONG, 0, comm);
+  if (rank != 0)
+    return;
+  std::sort (fingerprints.begin (), fingerprints.end ());
+  fingerprints.erase (std::unique (fingerprints.begin (),
+				   fingerprints.end ()), fingerprints.end ());
+  unsigned long long
+    fingerprint = hash_text (FFTWPrecision < T >::version (),
+			     14695981039346656037ULL);
+  for (size_t ix = 0; ix < fingerprints.size (); ix++)
+    fingerprint = hash_text (to_string (fingerprints[ix]), fingerprint);
+
+  // The rest of the key goes into the file name as it is.
+  std::ostringstream name;
+  name << directory << "/pstool-" << FFTWPrecision < T >::name () << "-"
+    << kind << "-" << points << "-" << size << "x" <<
+    ThreadPool::get_threads () << "-" << std::hex << std::setw (16) <<
+    std::setfill ('0') << fingerprint << ".wisdom";
+  file_name = name.str ();
+}
+
+template < typename T > bool
+WisdomCache < T >::import ()
+{
+  if (comm == MPI_COMM_NULL)
+    return false;
+
+  // Time the planning.
+  PhaseTimer timer (PhaseTimer::PLAN);
+
+  // Plans the wisdom lacks are measured, but only for so long.
+  FFTWPrecision < T >::set_time_limit (time_limit);
+  if (!read_wisdom (file_name, comm, cached_wisdom))
+    return false;
+
+  // Wisdom that doesn't import, say from a file cut short by something
+  // other than us, is as good as none.
+  if (!FFTWPrecision < T >::import_wisdom_from_string (cached_wisdom.c_str ()))
+    {
+      cached_wisdom.clear ();
+      return false;
+    }
+  return true;
+}
+
+template < typename T > void
+WisdomCache < T >::store ()
+{
+  if (comm == MPI_COMM_NULL)
+    return;
+
+  // Time the export.
+  PhaseTimer timer (PhaseTimer::EXPORT);
+  FFTWPrecision < T >::set_time_limit (-1);
+  FFTWPrecision < T >::gather_wisdom (comm);
+  int
+    rank;
+  MPI_Comm_rank (comm, &rank);
+  if (rank != 0)
+    return;
+  std::string wisdom = FFTWPrecision < T >::export_wisdom_to_string ();
+  if (wisdom == cached_wisdom)
+    return;
+
+  // Write the wisdom out to a file of its own next to the cache file,
+  // creating the directory and any it's in if need be, and rename it
+  // over the cache file once it's complete.
+  std::string directory = file_name.substr (0, file_name.rfind ('/'));
+  for (size_t end = directory.find ('/', 1);;
+       end = directory.find ('/', end + 1))
+    {
+      std::string parent = directory.substr (0, end);
+      if ((mkdir (parent.c_str (), 0777) != 0) && (errno != EEXIST))
+	throw WisdomCacheException (WisdomCacheException::EFIO,
+				    std::
+				    string ("couldn't create wisdom directory '")
+				    + parent + std::string ("'"));
+      if (end == std::string::npos)
+	break;
+    }
+  std::vector < char >temporary_name (file_name.begin (), file_name.end ());
+  const char *suffix = ".XXXXXX";
+  temporary_name.insert (temporary_name.end (), suffix, suffix + 8);
+  int
+    fd = mkstemp (&temporary_name[0]);
+  FILE *
+    wisdom_file = (fd != -1) ? fdopen (fd, "w") : NULL;
+  if (wisdom_file == NULL)
+    {
+      if (fd != -1)
+	{
+	  close (fd);
+	  unlink (&temporary_name[0]);
+	}
+      throw WisdomCacheException (WisdomCacheException::EFIO,
+				  std::string ("couldn't create wisdom file in '")
+				  + directory + std::string ("'"));
+    }
+  bool written = (fchmod (fd, 0644) == 0) &&
+    (fputs (wisdom.c_str (), wisdom_file) != EOF) &&
+    (fflush (wisdom_file) == 0) && (fsync (fd) == 0);
+  if ((fclose (wisdom_file) != 0) || !written ||
+      (rename (&temporary_name[0], file_name.c_str ()) != 0))
+    {
+      unlink (&temporary_name[0]);
+      throw WisdomCacheException (WisdomCacheException::EFIO,
+				  std::string ("couldn't write wisdom file '") +
+				  file_name + std::string ("'"));
+    }
+  cached_wisdom = wisdom;
+}
+
+// The precisions supported.
+template class WisdomCache < double >;
+#ifdef HAVE_SINGLE_PRECISION
+template class WisdomCache < float >;
+#endif
@@ -0,0 +1,123 @@
+// Time-stamp: <2026-10-17 15:44:27 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef WISDOM_CACHE_H
+#define WISDOM_CACHE_H
+
+// System includes.
+#include <mpi.h>
+#include <string>
+#include <cstddef>
+
+// Local includes.
+#include "fft_backend.h"
+#include "generic_exception.h"
+
+// Thrown at WisdomCache errors.
+class WisdomCacheException:public GenericException
+{
+public:
+
+  // Error types thrown.
+  typedef enum
+  {
+
+    // File I/O error.
+    EFIO
+  } error_t;
+private:
+
+  // Error code associated with the exception.
+    error_t error_code;
+public:
+
+  // Constructor used for creation of object.
+    WisdomCacheException (error_t err,
+			  const std::
+			  string & aux_err):GenericException (aux_err),
+    error_code (err)
+  {
+  }
+
+  // Returns the error code association with the exception.
+  error_t get_error_code () const
+  {
+    return error_code;
+  }
+};
+
+// Keeps the wisdom of transforms of data points of type T in a
+// directory, a file for each way of transforming, input length,
+// number of processes and threads, FFTW version and set of CPUs the
+// processes run on, so that a transform is only ever measured once.
+// Only the primary process of the communicator reads and writes the
+// files, and hands the wisdom out to the others.
+template < typename T > class WisdomCache
+{
+private:
+
+  // Communicator of the processes planning the transform.
+  MPI_Comm comm;
+
+  // The cache file, empty if there's no cache. Only the primary
+  // process knows it.
+  std::string file_name;
+
+  // Seconds FFTW may spend measuring each plan.
+  double time_limit;
+
+  // The wisdom found in the cache file, to tell whether planning
+  // added any.
+  std::string cached_wisdom;
+
+  // Reads file_name into wisdom on the primary process of comm, and
+  // hands it to the others. Returns false on every process if the file
+  // couldn't be read. Must be called by every process in comm.
+  static bool read_wisdom (const std::string & file_name, MPI_Comm comm,
+			   std::string & wisdom);
+public:
+
+  // Imports the wisdom in file_name on every process in comm, having the
+  // primary process read it. Returns false on every process if the file
+  // couldn't be read. Must be called by every process in comm.
+  static bool import_file (const char *file_name, MPI_Comm comm);
+
+  // Writes the wisdom of this process out to file_name. Returns false
+  // if the file couldn't be opened.
+  static bool export_file (const char *file_name);
+
+  // Constructor. Keeps the wisdom of transforms of kind (a short name
+  // for the way of transforming) of points data points, planned by the
+  // processes in comm, in directory, measuring each plan for at most
+  // time_limit seconds. Does nothing, here or later, if directory is a
+  // NULL pointer. Must be called by every process in comm.
+    WisdomCache (const char *directory, const char *kind, size_t points,
+		 double time_limit, MPI_Comm comm = MPI_COMM_WORLD);
+
+  // Imports the cached wisdom on every process, and limits the time
+  // spent measuring plans. Returns false on every process if there was
+  // none. Must be called by every process in comm.
+  bool import ();
+
+  // Lifts the time limit, and stores the wisdom of every process in the
+  // cache, unless planning added nothing to it. The cache file is
+  // replaced by renaming a complete new one over it, so that runs
+  // sharing the cache never see half of it. Must be called by every
+  // process in comm.
+  void store ();
+};
+#endif
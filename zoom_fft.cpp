@@ -0,0 +1,486 @@
+// Time-stamp: <2026-10-17 19:37:05 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+// System includes.
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
+
+// Local includes.
+#include "stl_ext.h"
+#include "phase_timer.h"
+#include "thread_pool.h"
+#include "wisdom_cache.h"
+#include "padding.h"
+#include "window.h"
+#include "zoom_fft.h"
+
+// The decimated data points are sampled at least this many times as
+// often as the band is wide, which leaves the low-pass filter room to
+// roll off between the band and its nearest alias.
+#define OVERSAMPLING 1.25
+
+// How far the low-pass filter attenuates the aliases of the band, in dB.
+#define ATTENUATION 100.0
+
+// The input is never decimated to fewer data points than this.
+#define MIN_DECIMATED_POINTS 1024
+
+// Data points read, mixed and decimated at a time.
+#define BATCH_POINTS (1 << 20)
+
+// Data points mixed relative to the phase of the first of them.
+#define MIX_BLOCK 4096
+
+// Not worth a thread of its own for less than this many multiplications.
+#define MIN_POINTS_PER_THREAD 65536
+
+// Returns a * b modulo modulus, which is below 2^63, doubling and adding
+// rather than multiplying, so that nothing overflows.
+static size_t
+multiply_mod (size_t a, size_t b, size_t modulus)
+{
+  size_t product = 0;
+  for (a %= modulus; b != 0; b >>= 1)
+    {
+      if (b & 1)
+	{
+	  product += a;
+	  if (product >= modulus)
+	    product -= modulus;
+	}
+      a += a;
+      if (a >= modulus)
+	a -= modulus;
+    }
+  return product;
+}
+
+template < typename T > ZoomFFT < T >::ZoomFFT (bool optimal_plan, MPIRFFTWInput < T > &input, const char *import_wisdom_file_name, double rate, const Band & band, MPI_Comm communicator):
+myplan (NULL), comm (communicator), sample_rate (rate),
+friendly_input (&input), data_array (NULL), work_data_array (NULL),
+output_data_array (NULL), first_output_bin (0), output_bins_count (0)
+{
+
+  // Time the planning.
+  PhaseTimer timer (PhaseTimer::PLAN);
+
+  // Sanity check the band.
+  size_t data_points_count = (*friendly_input).total_data_points_count;
+  if (band.get_high () > rate / 2)
+    throw ZoomFFTException (ZoomFFTException::EBAND,
+			    std::string ("band ") +
+			    to_string (band.get_low ()) +
+			    std::string (" to ") +
+			    to_string (band.get_high ()) +
+			    std::string (" Hz runs past the Nyquist frequency of ")
+			    + to_string (rate / 2) + std::string (" Hz"));
+
+  // Decimate as far as the band allows, but no further than leaves
+  // MIN_DECIMATED_POINTS data points.
+  double width = band.get_high () - band.get_low ();
+  size_t most_decimation = std::max ((size_t) 1,
+				     data_points_count /
+				     MIN_DECIMATED_POINTS);
+  decimation = (size_t) std::max (1.0,
+				  std::min (std::floor (rate /
+							(OVERSAMPLING *
+							 width)),
+					    (double) most_decimation));
+  double decimated_rate = rate / decimation;
+
+  // The low-pass filter passes the band, give or take the half a bin
+  // it's moved by to centre it on a bin, and stops everything that
+  // would alias into it. It takes the more weights the narrower the
+  // transition in between. There's nothing to filter out if the input
+  // isn't decimated.
+  size_t taps = 1;
+  if (decimation > 1)
+    {
+      double transition = decimated_rate * (1 - 1.0 / MIN_DECIMATED_POINTS)
+	- width;
+      taps = (size_t) std::ceil ((ATTENUATION - 8) /
+				 (2.285 * 2 * M_PI * transition / rate)) + 1;
+      taps |= 1;
+    }
+
+  // The decimated data points are taken every decimation data points,
+  // from the first of the input to the last the filter reaches.
+  decimated_count = (data_points_count + taps - 2) / decimation + 1;
+
+  // The bins are as narrow as asked for, or as the input allows if
+  // that's narrower. The transform is of an even length with no prime
+  // factor above 7.
+  double resolution = (band.get_resolution () > 0) ?
+    band.get_resolution () : rate / data_points_count;
+  double wanted_length = std::ceil (decimated_rate / resolution);
+  if (!(wanted_length < 1e15))
+    throw ZoomFFTException (ZoomFFTException::EBAND,
+			    std::string ("bins of ") +
+			    to_string (resolution) +
+			    std::string (" Hz are too narrow"));
+  transform_length = std::max (decimated_count, (size_t) wanted_length);
+  transform_length = 2 * Padding::next_smooth ((transform_length + 1) / 2);
+  bin_size = decimated_rate / transform_length;
+
+  // Bins of the transform fall on bins of a DFT of the whole input
+  // with bins as wide, by moving the band by a whole number of them.
+  mixing_bin = (size_t) std::floor ((band.get_low () + band.get_high ()) /
+				    (2 * bin_size) + 0.5);
+  first_band_bin = (size_t) std::ceil (band.get_low () / bin_size - 1e-9);
+  last_band_bin = (size_t) std::floor (band.get_high () / bin_size + 1e-9);
+
+  // A Kaiser windowed sinc, cut off halfway between the band and its
+  // nearest alias, for a gain of 1 at 0 Hz.
+  filter.resize (taps);
+  Window kaiser = Window::kaiser (0.1102 * (ATTENUATION - 8.7));
+  double cutoff = 0.5 / decimation, sum = 0;
+  for (size_t ix = 0; ix < taps; ix++)
+    {
+      double x = (double) ix - (double) (taps - 1) / 2;
+      filter[ix] = (x == 0) ? 2 * cutoff :
+	std::sin (2 * M_PI * cutoff * x) / (M_PI * x);
+      if (taps > 1)
+	filter[ix] *= kaiser.weight (ix, taps - 1);
+      sum += filter[ix];
+    }
+  for (size_t ix = 0; ix < taps; ix++)
+    filter[ix] /= sum;
+
+  // Phases of the mixing are found exactly, modulo a whole number of
+  // turns, first for the data points of a block relative to its first.
+  size_t period = transform_length * decimation;
+  block_phases_re.resize (MIX_BLOCK);
+  block_phases_im.resize (MIX_BLOCK);
+  for (size_t ix = 0; ix < MIX_BLOCK; ix++)
+    {
+      double phase = -2 * M_PI * multiply_mod (mixing_bin, ix, period) /
+	period;
+      block_phases_re[ix] = std::cos (phase);
+      block_phases_im[ix] = std::sin (phase);
+    }
+
+  // Check if we need to import wisdom. The primary process reads it
+  // for everybody.
+  if ((import_wisdom_file_name != NULL) &&
+      !WisdomCache < T >::import_file (import_wisdom_file_name, comm))
+    throw ZoomFFTException (ZoomFFTException::EFIO,
+			    std::string ("couldn't open input wisdom file '") +
+			    import_wisdom_file_name +
+			    std::string ("' for import"));
+
+  // Create a forward one-dimensional complex MPI plan, in natural order,
+  // in place. Each process finds the decimated data points of the input
+  // it holds.
+  unsigned
+    plan_flags = optimal_plan ? FFTW_MEASURE : FFTW_ESTIMATE;
+  size_t alloc_local;
+#ifdef HAVE_FFTW3
+  typedef typename FFTWPrecision < T >::complex fftw_complex_t;
+  ptrdiff_t
+    local_ni,
+    local_i_start,
+    local_no,
+    local_o_start;
+  alloc_local =
+    FFTWPrecision < T >::mpi_local_size_1d (transform_length, comm,
+					    FFTW_FORWARD, plan_flags,
+					    &local_ni, &local_i_start,
+					    &local_no, &local_o_start);
+#else
+  myplan = fftw_mpi_create_plan (comm, (int) transform_length, FFTW_FORWARD,
+				 plan_flags | FFTW_USE_WISDOM);
+  if (myplan == NULL)
+    throw ZoomFFTException (ZoomFFTException::EPLAN,
+			    std::string ("plan creation failed :-(("));
+  int
+    local_ni,
+    local_i_start,
+    local_no,
+    local_o_start,
+    total_local_size;
+  fftw_mpi_local_sizes (myplan, &local_ni, &local_i_start, &local_no,
+			&local_o_start, &total_local_size);
+  alloc_local = total_local_size;
+#endif
+  local_input_start = local_i_start;
+  local_input_count = local_ni;
+  local_output_start = local_o_start;
+  local_output_count = local_no;
+
+  // Page align the arrays. FFTW3 plans for them, so they have to exist
+  // before the plan is created.
+  alloc_local = std::max (alloc_local, (size_t) 1);
+  if ((posix_memalign ((void **) (&data_array), sysconf (_SC_PAGESIZE),
+		       sizeof (complex) * alloc_local) == ENOMEM)
+#ifndef HAVE_FFTW3
+      || (posix_memalign ((void **) (&work_data_array),
+			  sysconf (_SC_PAGESIZE),
+			  sizeof (complex) * alloc_local) == ENOMEM)
+#endif
+    )
+    throw ZoomFFTException (ZoomFFTException::EMEM,
+			    std::string ("couldn't allocate arrays of ") +
+			    to_string (alloc_local) +
+			    std::string (" complex numbers"));
+#ifdef HAVE_FFTW3
+  myplan = FFTWPrecision < T >::mpi_plan_dft_1d (transform_length,
+						 (fftw_complex_t *) data_array,
+						 (fftw_complex_t *) data_array,
+						 comm, FFTW_FORWARD,
+						 plan_flags);
+  if (myplan == NULL)
+    throw ZoomFFTException (ZoomFFTException::EPLAN,
+			    std::string ("plan creation failed :-(("));
+#endif
+}
+
+template < typename T > ZoomFFT < T >::~ZoomFFT ()
+{
+  if (myplan != NULL)
+#ifdef HAVE_FFTW3
+    FFTWPrecision < T >::destroy_plan (myplan);
+#else
+    fftw_mpi_destroy_plan (myplan);
+#endif
+  free (data_array);
+  free (work_data_array);
+}
+
+template < typename T > void
+ZoomFFT < T >::export_wisdom (const char *export_wisdom_file_name)
+{
+
+  // Time the export.
+  PhaseTimer timer (PhaseTimer::EXPORT);
+
+  // Only export if we are given a file name.
+  if (export_wisdom_file_name != NULL)
+    {
+
+      // Write the wisdom out.
+      if (!WisdomCache < T >::export_file (export_wisdom_file_name))
+	throw ZoomFFTException (ZoomFFTException::EFIO,
+				std::string ("couldn't open output wisdom file '") +
+				std::string (export_wisdom_file_name) +
+				std::string ("' for export"));
+    }
+}
+
+template < typename T > void
+ZoomFFT < T >::mix (const T * src, size_t count, size_t first_data_point,
+		    double *re, double *im)
+{
+  size_t period = transform_length * decimation;
+  ThreadPool::parallel_for (count, MIN_POINTS_PER_THREAD,
+			    [&] (size_t first, size_t last)
+    {
+      for (size_t start = first; start < last; start += MIX_BLOCK)
+	{
+	  size_t block = std::min ((size_t) MIX_BLOCK, last - start);
+	  double phase = -2 * M_PI *
+	    multiply_mod (mixing_bin, first_data_point + start, period) /
+	    period;
+	  double start_re = std::cos (phase), start_im = std::sin (phase);
+	  for (size_t ix = 0; ix < block; ix++)
+	    {
+	      double x = src[start + ix];
+	      re[start + ix] = x * (start_re * block_phases_re[ix] -
+				    start_im * block_phases_im[ix]);
+	      im[start + ix] = x * (start_re * block_phases_im[ix] +
+				    start_im * block_phases_re[ix]);
+	    }
+	}
+    });
+}
+
+template < typename T > void
+ZoomFFT < T >::decimate (const double *re, const double *im, size_t count,
+			 size_t first_decimated, complex * dest)
+{
+  size_t taps = filter.size ();
+  const double *weights = &filter[0];
+  ThreadPool::parallel_for (count, MIN_POINTS_PER_THREAD / taps + 1,
+			    [&] (size_t first, size_t last)
+    {
+      for (size_t ix = first; ix < last; ix++)
+	{
+	  const double *window_re = re + ix * decimation;
+	  const double *window_im = im + ix * decimation;
+	  double sum_re = 0, sum_im = 0;
+	  for (size_t tap = 0; tap < taps; tap++)
+	    {
+	      sum_re += weights[tap] * window_re[tap];
+	      sum_im += weights[tap] * window_im[tap];
+	    }
+	  double sign = ((first_decimated + ix) % 2 == 0) ? 1 : -1;
+	  dest[ix].re = (T) (sign * sum_re);
+	  dest[ix].im = (T) (sign * sum_im);
+	}
+    });
+}
+
+template < typename T > void
+ZoomFFT < T >::do_transform ()
+{
+
+  // The decimated data points this process finds. Those past
+  // decimated_count are zeros.
+  size_t data_points_count = (*friendly_input).total_data_points_count;
+  size_t taps = filter.size ();
+  size_t first_decimated = std::min (local_input_start, decimated_count);
+  size_t end_decimated = std::min (local_input_start + local_input_count,
+				   decimated_count);
+
+  // Decimated data point m is found from mixed data points
+  // m * decimation - taps + 1 up to m * decimation, those outside the
+  // input being zeros. Mixed data points are kept from the first that
+  // the next decimated data point needs on, counting from taps - 1
+  // data points before the input, so that none are negative. Those of
+  // this process are read a batch at a time. Decimated data points the
+  // filter only reaches past the end of the input with are zeros.
+  size_t read_first = 0, read_end = 0;
+  if (first_decimated < end_decimated)
+    {
+      read_first = (first_decimated * decimation > taps - 1) ?
+	first_decimated * decimation - (taps - 1) : 0;
+      read_end = std::min (data_points_count,
+			   (end_decimated - 1) * decimation + 1);
+      if (read_first >= read_end)
+	{
+	  read_first = read_end = 0;
+	  end_decimated = first_decimated;
+	}
+    }
+  unsigned long long
+    batches_count = (read_end - read_first + BATCH_POINTS - 1) / BATCH_POINTS,
+    most_batches;
+  MPI_Allreduce (&batches_count, &most_batches, 1, MPI_UNSIGNED_LONG_LONG,
+		 MPI_MAX, comm);
+  std::vector < T > batches[2];
+  batches[0].resize (BATCH_POINTS);
+  batches[1].resize (BATCH_POINTS);
+  std::vector < double >re (2 * taps + decimation + BATCH_POINTS);
+  std::vector < double >im (re.size ());
+
+  // The mixed data points start out as the zeros before the first
+  // data point read, if any. Processes holding nothing but zeros
+  // don't keep any.
+  size_t kept_first = first_decimated * decimation;
+  size_t kept_count = (first_decimated < end_decimated) ?
+    read_first + taps - 1 - kept_first : 0;
+  std::fill (re.begin (), re.begin () + kept_count, 0);
+  std::fill (im.begin (), im.begin () + kept_count, 0);
+
+  // Everybody goes through as many batches, as reading is collective.
+  // Each batch is read while the last one is mixed and decimated.
+  size_t next_decimated = first_decimated, next_read = read_first;
+  int count = (int) std::min ((size_t) BATCH_POINTS, read_end - next_read);
+  if (most_batches > 0)
+    (*friendly_input).start_strided (next_read, (count > 0) ? 1 : 0, count,
+				     count, &batches[0][0]);
+  for (size_t batch = 0; batch < most_batches; batch++)
+    {
+      (*friendly_input).finish_strided ();
+      size_t batch_first = next_read;
+      next_read += count;
+      int next_count = (int) std::min ((size_t) BATCH_POINTS,
+				       read_end - next_read);
+      if (batch + 1 < most_batches)
+	(*friendly_input).start_strided (next_read, (next_count > 0) ? 1 : 0,
+					 next_count, next_count,
+					 &batches[(batch + 1) % 2][0]);
+      if (count > 0)
+	{
+
+	  // Time the mixing and decimation.
+	  PhaseTimer timer (PhaseTimer::TRANSFORM);
+	  mix (&batches[batch % 2][0], count, batch_first,
+	       &re[kept_count], &im[kept_count]);
+	  kept_count += count;
+
+	  // Once the last data point is in, so are the zeros after it.
+	  if (next_read == read_end)
+	    {
+	      size_t zeros = (end_decimated - 1) * decimation + 1 - read_end;
+	      std::fill (re.begin () + kept_count,
+			 re.begin () + kept_count + zeros, 0);
+	      std::fill (im.begin () + kept_count,
+			 im.begin () + kept_count + zeros, 0);
+	      kept_count += zeros;
+	    }
+
+	  // Decimate whatever has all its mixed data points in, and keep
+	  // the mixed data points the rest need.
+	  size_t ready = next_decimated;
+	  if (kept_first + kept_count >= taps)
+	    ready = std::min (end_decimated,
+			      (kept_first + kept_count - taps) / decimation +
+			      1);
+	  if (ready > next_decimated)
+	    {
+	      decimate (&re[next_decimated * decimation - kept_first],
+			&im[next_decimated * decimation - kept_first],
+			ready - next_decimated, next_decimated,
+			data_array + (next_decimated - local_input_start));
+	      next_decimated = ready;
+	      size_t dropped = std::min (next_decimated * decimation -
+					 kept_first, kept_count);
+	      std::copy (re.begin () + dropped, re.begin () + kept_count,
+			 re.begin ());
+	      std::copy (im.begin () + dropped, im.begin () + kept_count,
+			 im.begin ());
+	      kept_first += dropped;
+	      kept_count -= dropped;
+	    }
+	}
+      count = next_count;
+    }
+
+  // Time the transform.
+  PhaseTimer timer (PhaseTimer::TRANSFORM);
+
+  // The rest of the transform input is zeros.
+  std::fill (data_array + (end_decimated - first_decimated),
+	     data_array + local_input_count, complex ());
+#ifdef HAVE_FFTW3
+  FFTWPrecision < T >::execute (myplan);
+#else
+  fftw_mpi (myplan, 1, (fftw_complex *) data_array,
+	    (fftw_complex *) work_data_array);
+#endif
+
+  // Bin j of the transform output is bin j - transform_length / 2
+  // relative to the mixing bin. Find which of the band bins we hold.
+  size_t band_start = first_band_bin + transform_length / 2 - mixing_bin;
+  size_t band_end = last_band_bin + 1 + transform_length / 2 - mixing_bin;
+  size_t start = std::max (band_start, local_output_start);
+  size_t end = std::min (band_end, local_output_start + local_output_count);
+  if (end < start)
+    end = start;
+  output_data_array = data_array + (start - local_output_start);
+  first_output_bin = start - band_start;
+  output_bins_count = end - start;
+}
+
+// The precisions supported.
+template class ZoomFFT < double >;
+#ifdef HAVE_SINGLE_PRECISION
+template class ZoomFFT < float >;
+#endif
@@ -0,0 +1,214 @@
+// Time-stamp: <2026-10-17 18:52:20 awarkentin>
+// Copyright (C) 2004 Andrey Warkentin
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef ZOOM_FFT_H
+#define ZOOM_FFT_H
+
+// System includes.
+#include <mpi.h>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Local includes.
+#include "fft_backend.h"
+#include "band.h"
+#include "ps_generator.h"
+#include "mpirfftw_input.h"
+#include "generic_exception.h"
+
+// Forward declaration.
+template < typename T > class PSGenerator;
+template < typename T > class MPIRFFTWInput;
+
+// Thrown at ZoomFFT errors.
+class ZoomFFTException:public GenericException
+{
+public:
+
+  // Error types thrown.
+  typedef enum
+  {
+
+    // File I/O error.
+    EFIO,
+
+    // Plan creation error.
+    EPLAN,
+
+    // Band not within the input's frequencies.
+    EBAND,
+
+    // Failure in memory allocation.
+    EMEM
+  } error_t;
+private:
+
+  // Error code associated with the exception.
+    error_t error_code;
+public:
+
+  // Constructor used for creation of object.
+    ZoomFFTException (error_t err,
+		      const std::string & aux_err):GenericException (aux_err),
+    error_code (err)
+  {
+  }
+
+  // Returns the error code association with the exception.
+  error_t get_error_code () const
+  {
+    return error_code;
+  }
+};
+
+// Finds the DFT of the input over a band of frequencies alone (a zoom
+// FFT). The input is mixed down so that the band is centred on 0 Hz,
+// low-pass filtered to the band and decimated, which leaves a complex
+// signal of a fraction of the data points, whose DFT, a complex MPI
+// transform, has bins only in and around the band. Each process mixes
+// and decimates its own slice of the input as it reads it, a batch at
+// a time, the slices being those the transform wants its input in.
+// Data points are of type T, float or double.
+template < typename T > class ZoomFFT
+{
+private:
+
+  // We're friends with PSGenerator.
+  friend class PSGenerator < T >;
+
+  // A complex number of precision T, laid out as FFTW's.
+  typedef fft_complex_of < T > complex;
+
+  // Plan of the forward complex transform, done in place.
+#ifdef HAVE_FFTW3
+  typename FFTWPrecision < T >::plan myplan;
+#else
+  fftw_mpi_plan myplan;
+#endif
+
+  // Communicator the input and the transform are split over.
+  MPI_Comm comm;
+
+  // Sample rate of the input, in Hz.
+  double sample_rate;
+
+  // Number of data points the input is decimated by, and the number of
+  // decimated data points, which cover every data point the low-pass
+  // filter gives out, from the first data point of the input to the
+  // last it reaches past the end.
+  size_t decimation;
+  size_t decimated_count;
+
+  // Weights of the low-pass filter, a Kaiser windowed sinc. A
+  // decimated data point is their dot product with as many consecutive
+  // mixed data points, the last being the one it's taken at. The
+  // filter is symmetric, so it reads the same either way round.
+  std::vector < double >filter;
+
+  // Length of the transform, which is even and at least
+  // decimated_count, the rest being zeros, and the width of its bins
+  // in Hz.
+  size_t transform_length;
+  double bin_size;
+
+  // The band is centred on bin mixing_bin of a DFT of the whole input
+  // with bins of bin_size, which the mixing moves to 0 Hz, and spans
+  // bins first_band_bin to last_band_bin of it.
+  size_t mixing_bin;
+  size_t first_band_bin;
+  size_t last_band_bin;
+
+  // Decimated data points this process finds, which are the input of
+  // the transform it holds, and the transform outputs it holds, all
+  // in natural order.
+  size_t local_input_start;
+  size_t local_input_count;
+  size_t local_output_start;
+  size_t local_output_count;
+
+  // Pointer to the class friend object.
+  MPIRFFTWInput < T > *friendly_input;
+
+  // Array to hold this process' part of the transform, input and
+  // output, and with FFTW2 the work array the transform needs.
+  complex *data_array;
+  complex *work_data_array;
+
+  // Phases of the mixing of the data points of a block, relative to
+  // that of its first.
+  std::vector < double >block_phases_re;
+  std::vector < double >block_phases_im;
+
+  // Band bins this process holds, where the first of them is in
+  // data_array, and which band bin it is, 0 being first_band_bin.
+  // Set by do_transform.
+  complex *output_data_array;
+  size_t first_output_bin;
+  size_t output_bins_count;
+
+  // Multiplies count data points, starting with data point first_data_point
+  // of the input, by the phase of the mixing, into re and im.
+  void mix (const T * src, size_t count, size_t first_data_point,
+	    double *re, double *im);
+
+  // Sets count decimated data points of dest, the first being
+  // decimated data point first_decimated, to the dot products of the
+  // filter with the mixed data points in re and im, starting with the
+  // first and decimation apart. Decimated data point m is moreover
+  // multiplied by (-1)^m, which moves the band from the ends of the
+  // transform output to its middle.
+  void decimate (const double *re, const double *im, size_t count,
+		 size_t first_decimated, complex * dest);
+public:
+
+  // Constructor. Arguments as for RealFFT, plus the sample rate of the
+  // input and the band to zoom into.
+    ZoomFFT (bool optimal_plan, MPIRFFTWInput < T > &input,
+	     const char *import_wisdom_file_name, double rate,
+	     const Band & band, MPI_Comm comm = MPI_COMM_WORLD);
+
+  // Destructor.
+   ~ZoomFFT ();
+
+  // Exports wisdom to file, as long as the file name isn't a NULL pointer.
+  void export_wisdom (const char *export_wisdom_file_name);
+
+  // Reads, mixes and decimates this process' slice of the input, a
+  // batch at a time, reading each batch while the one before it is
+  // decimated, and transforms. Must be called by every process.
+  void do_transform ();
+
+  // Returns the number of data points the input is decimated by.
+  size_t get_decimation () const
+  {
+    return decimation;
+  }
+
+  // Returns the length of the transform.
+  size_t get_transform_length () const
+  {
+    return transform_length;
+  }
+
+  // Returns the width of the bins, in Hz.
+  double get_bin_size () const
+  {
+    return bin_size;
+  }
+};
+#endif